@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Compares a Google Benchmark JSON report against a stored baseline of the same
+benchmark executable and fails if any benchmark got slower than the tolerance.
+
+  compare_baseline.py baselines/ultralytics_ops_benchmark.json ultralytics_ops_benchmark.json [--tolerance 0.1]
+
+Baselines are machine specific, record them with the benchmark_baseline target.
+"""
+import argparse
+import json
+import sys
+
+
+def load_times(filepath):
+    with open(filepath) as f:
+        report = json.load(f)
+    times = {}
+    for bm in report.get('benchmarks', []):
+        if bm.get('error_occurred'):
+            continue
+        # prefer the median of repetitions when aggregates are reported
+        if bm.get('run_type') == 'aggregate':
+            if bm.get('aggregate_name') != 'median':
+                continue
+            name = bm['run_name']
+        elif bm['name'] in times:
+            continue
+        else:
+            name = bm.get('run_name', bm['name'])
+        times[name] = float(bm['real_time'])
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('baseline')
+    parser.add_argument('contender')
+    parser.add_argument('--tolerance', type=float, default=0.1,
+                        help='allowed relative slowdown, 0.1 fails benchmarks more than 10%% slower')
+    args = parser.parse_args()
+
+    try:
+        baseline = load_times(args.baseline)
+    except FileNotFoundError:
+        print(f'no baseline at {args.baseline}, record one with the benchmark_baseline target', file=sys.stderr)
+        return 1
+    contender = load_times(args.contender)
+
+    regressions = []
+    width = max((len(name) for name in contender), default=0)
+    for name, time in contender.items():
+        if name not in baseline:
+            print(f'{name:<{width}}  {time:12.3f}  (new)')
+            continue
+        change = time / baseline[name] - 1 if baseline[name] > 0 else 0.
+        flag = 'REGRESSION' if change > args.tolerance else ''
+        print(f'{name:<{width}}  {baseline[name]:12.3f} -> {time:12.3f}  {change:+8.1%}  {flag}')
+        if flag:
+            regressions.append(name)
+    for name in baseline.keys() - contender.keys():
+        print(f'{name:<{width}}  (missing)')
+
+    if regressions:
+        print(f'{len(regressions)} benchmark(s) regressed by more than {args.tolerance:.0%}', file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
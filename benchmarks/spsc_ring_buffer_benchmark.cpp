@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <thread>
+
+#include "std/threading/blocking_collection.h"
+#include "std/threading/spsc_ring_buffer.h"
+
+namespace {
+    constexpr std::size_t kCapacity = 64;
+    constexpr std::int64_t kItems = 1 << 16;
+
+    // each iteration hands kItems items from a producer thread to the benchmark thread
+    void BM_SpscRingBuffer(benchmark::State &state) {
+        for (auto _: state) {
+            std::spsc_ring_buffer<std::uintptr_t> buffer(kCapacity);
+            std::thread producer([&]() {
+                for (std::uintptr_t i = 1; i <= kItems; i++)
+                    while (!buffer.try_push(i))
+                        std::this_thread::yield();
+            });
+            std::uintptr_t sum = 0;
+            for (std::int64_t i = 0; i < kItems;) {
+                if (auto item = buffer.try_pop()) {
+                    sum += *item;
+                    i++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            producer.join();
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * kItems);
+    }
+
+    void BM_BlockingSpscRingBuffer(benchmark::State &state) {
+        for (auto _: state) {
+            std::blocking_spsc_ring_buffer<std::uintptr_t> buffer(kCapacity);
+            std::thread producer([&]() {
+                for (std::uintptr_t i = 1; i <= kItems; i++)
+                    while (!buffer.try_push(i))
+                        std::this_thread::yield();
+            });
+            std::uintptr_t sum = 0;
+            for (std::int64_t i = 0; i < kItems; i++)
+                sum += *buffer.pop();
+            producer.join();
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * kItems);
+    }
+
+    // camera-like handoff where the producer never waits and drops the oldest item instead
+    void BM_SpscRingBufferOverwrite(benchmark::State &state) {
+        for (auto _: state) {
+            std::blocking_spsc_ring_buffer<std::uintptr_t> buffer(kCapacity);
+            std::thread producer([&]() {
+                for (std::uintptr_t i = 1; i <= kItems; i++)
+                    buffer.push(i);
+                buffer.close();
+            });
+            std::uintptr_t sum = 0;
+            while (auto item = buffer.pop())
+                sum += *item;
+            producer.join();
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * kItems);
+    }
+
+    void BM_BlockingCollection(benchmark::State &state) {
+        for (auto _: state) {
+            std::BlockingCollection<std::uintptr_t> collection(kCapacity);
+            std::thread producer([&]() {
+                for (std::uintptr_t i = 1; i <= kItems; i++)
+                    collection.add(i);
+            });
+            std::uintptr_t sum = 0, item = 0;
+            for (std::int64_t i = 0; i < kItems; i++) {
+                collection.take(item);
+                sum += item;
+            }
+            producer.join();
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * kItems);
+    }
+}
+
+BENCHMARK(BM_SpscRingBuffer)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BlockingSpscRingBuffer)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SpscRingBufferOverwrite)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BlockingCollection)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
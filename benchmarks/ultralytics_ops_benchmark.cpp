@@ -0,0 +1,209 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <opencv2/core.hpp>
+
+#include "dnn/torchvision/transforms.h"
+#include "dnn/ultralytics/nms.h"
+#include "dnn/ultralytics/transforms.h"
+#include "gst/gst_detection_meta.h"
+#include "gst/utils/osd_rasterizer.h"
+
+namespace {
+    namespace tv = torchvision::transforms;
+
+    constexpr int kInputSize = 640;
+
+    inline at::ScalarType dtype_arg(int64_t arg) {
+        return arg ? at::kDouble : at::kFloat;
+    }
+
+    inline cv::Size resolution_arg(int64_t height) {
+        return {static_cast<int>(height * 16 / 9), static_cast<int>(height)};
+    }
+
+    inline GstVideoFormat video_format_arg(int64_t arg) {
+        return arg ? GST_VIDEO_FORMAT_RGBA : GST_VIDEO_FORMAT_NV12;
+    }
+
+    /// Random xyxy boxes inside the model input, with a lot of overlap like raw candidates.
+    at::Tensor random_boxes(int64_t n, at::ScalarType dtype) {
+        auto xy = at::rand({n, 2}, at::TensorOptions(dtype)).mul_(kInputSize * 0.9);
+        auto wh = at::rand({n, 2}, at::TensorOptions(dtype)).mul_(kInputSize * 0.2).add_(4);
+        return at::cat({xy, xy + wh}, 1);
+    }
+
+    /// Raw yolov8 output of shape (1, 4 + nc, n) with xywh boxes and per-class scores.
+    at::Tensor random_prediction(int64_t n, int64_t nc, at::ScalarType dtype) {
+        auto xyxy = random_boxes(n, dtype);
+        auto xywh = at::cat({(xyxy.slice(1, 0, 2) + xyxy.slice(1, 2, 4)) / 2,
+                             xyxy.slice(1, 2, 4) - xyxy.slice(1, 0, 2)}, 1);
+        auto scores = at::rand({n, nc}, at::TensorOptions(dtype)).pow_(4);  // mostly low scores
+        return at::cat({xywh, scores}, 1).t().unsqueeze(0).contiguous();
+    }
+
+    /// Post-NMS prediction of shape (n, 6) of [x1, y1, x2, y2, conf, cls].
+    at::Tensor random_detections(int64_t n, int64_t nc, at::ScalarType dtype) {
+        auto conf = at::rand({n, 1}, at::TensorOptions(dtype));
+        auto cls = at::randint(nc, {n, 1}, at::TensorOptions(dtype));
+        return at::cat({random_boxes(n, dtype), conf, cls}, 1);
+    }
+
+    // ---------------------
+    // NMS
+    // ---------------------
+    void BM_Nms(benchmark::State &state) {
+        auto boxes = random_boxes(state.range(0), dtype_arg(state.range(1)));
+        auto scores = at::rand({state.range(0)}, boxes.options());
+        for (auto _: state)
+            benchmark::DoNotOptimize(ultralytics::ops::nms(boxes, scores, 0.45));
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_NonMaxSuppression(benchmark::State &state) {
+        auto prediction = random_prediction(state.range(0), state.range(1), dtype_arg(state.range(2)));
+        for (auto _: state)
+            benchmark::DoNotOptimize(ultralytics::ops::non_max_suppression(prediction, 0.25, 0.45, 300));
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    // ---------------------
+    // Pre-processing
+    // ---------------------
+    void BM_Letterbox(benchmark::State &state) {
+        cv::Mat image(resolution_arg(state.range(0)), CV_8UC3);
+        cv::randu(image, 0, 255);
+        for (auto _: state)
+            benchmark::DoNotOptimize(ultralytics::transforms::functional::letterbox(
+                    image, {kInputSize, kInputSize}));
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(image.total() * image.elemSize()));
+    }
+
+    void BM_TensorResize(benchmark::State &state) {
+        auto size = resolution_arg(state.range(0));
+        auto image = at::rand({3, size.height, size.width}, at::TensorOptions(dtype_arg(state.range(1))));
+        for (auto _: state)
+            benchmark::DoNotOptimize(tv::functional::resize(image, {kInputSize, kInputSize}));
+        state.SetItemsProcessed(state.iterations() * image.numel());
+    }
+
+    void BM_MatResize(benchmark::State &state) {
+        cv::Mat image(resolution_arg(state.range(0)), CV_8UC3);
+        cv::randu(image, 0, 255);
+        for (auto _: state)
+            benchmark::DoNotOptimize(tv::functional::resize<tv::RESIZE_BACKEND_OpenCV>(
+                    image, {kInputSize, kInputSize}));
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(image.total()));
+    }
+
+    void BM_Normalize(benchmark::State &state) {
+        auto size = resolution_arg(state.range(0));
+        auto image = at::rand({3, size.height, size.width}, at::TensorOptions(dtype_arg(state.range(1))));
+        std::vector<double> mean{0.485, 0.456, 0.406}, std{0.229, 0.224, 0.225};
+        for (auto _: state)
+            benchmark::DoNotOptimize(tv::functional::normalize(image, mean, std));
+        state.SetItemsProcessed(state.iterations() * image.numel());
+    }
+
+    // ---------------------
+    // Post-processing
+    // ---------------------
+    void BM_RescaleBboxesTensor(benchmark::State &state) {
+        auto prediction = random_detections(state.range(0), 80, dtype_arg(state.range(1)));
+        // the input is restored every iteration so that repeated rescaling does not overflow
+        auto work = at::empty_like(prediction);
+        for (auto _: state) {
+            work.copy_(prediction);
+            benchmark::DoNotOptimize(ultralytics::transforms::functional::rescale_bboxes_(
+                    work, {1920, 1080}, {kInputSize, kInputSize}));
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_RescaleBboxesVector(benchmark::State &state) {
+        auto detections = ultralytics::transforms::functional::to_detection_list(
+                random_detections(state.range(0), 80, at::kDouble));
+        std::vector<Detection> work;
+        for (auto _: state) {
+            work = detections;
+            benchmark::DoNotOptimize(ultralytics::transforms::functional::rescale_bboxes_(
+                    work, {1920, 1080}, {kInputSize, kInputSize}));
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_ToDetectionList(benchmark::State &state) {
+        auto prediction = random_detections(state.range(0), 80, dtype_arg(state.range(1)));
+        for (auto _: state)
+            benchmark::DoNotOptimize(ultralytics::transforms::functional::to_detection_list(prediction));
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_ToDetectionListWithNames(benchmark::State &state) {
+        auto prediction = random_detections(state.range(0), 80, at::kFloat);
+        std::vector<std::string> class_names;
+        for (int c = 0; c < 80; c++)
+            class_names.push_back("class_" + std::to_string(c));
+        for (auto _: state)
+            benchmark::DoNotOptimize(ultralytics::transforms::functional::to_detection_list(
+                    prediction, class_names));
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    // ---------------------
+    // OSD
+    // ---------------------
+    void BM_OsdDraw(benchmark::State &state) {
+        gst_init(nullptr, nullptr);
+        auto size = resolution_arg(1080);
+        GstVideoInfo info;
+        gst_video_info_set_format(&info, video_format_arg(state.range(0)), size.width, size.height);
+        auto *buf = gst_buffer_new_allocate(nullptr, GST_VIDEO_INFO_SIZE(&info), nullptr);
+        auto *meta = GST_DETECTION_META_ADD(buf);
+        meta->frame_width = kInputSize;
+        meta->frame_height = kInputSize;
+        auto detections = ultralytics::transforms::functional::to_detection_list(
+                random_detections(state.range(1), 80, at::kDouble));
+        for (const auto &det: detections) {
+            GstDetectionMetaEntry entry{det.bbox.x, det.bbox.y, det.bbox.width, det.bbox.height, det.label_id,
+                                        g_quark_from_string(("class_" + std::to_string(det.label_id)).c_str()),
+                                        det.confidence, det.track_id};
+            g_array_append_val(meta->detections, entry);
+        }
+        GstVideoFrame frame;
+        gst_video_frame_map(&frame, &info, buf, GST_MAP_READWRITE);
+        OsdRasterizer rasterizer;
+        for (auto _: state) {
+            rasterizer.draw(&frame, meta);
+            benchmark::ClobberMemory();
+        }
+        gst_video_frame_unmap(&frame);
+        gst_buffer_unref(buf);
+        state.SetItemsProcessed(state.iterations() * state.range(1));
+    }
+}
+
+// candidates, dtype (0: float, 1: double)
+BENCHMARK(BM_Nms)->ArgsProduct({{100, 1000, 8400}, {0, 1}})->Unit(benchmark::kMicrosecond);
+// candidates, classes, dtype
+BENCHMARK(BM_NonMaxSuppression)->ArgsProduct({{2100, 8400, 33600}, {1, 80}, {0}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NonMaxSuppression)->Args({8400, 80, 1})->Unit(benchmark::kMicrosecond);
+// source height (16:9), dtype
+BENCHMARK(BM_Letterbox)->Arg(240)->Arg(720)->Arg(1080)->Arg(2160)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TensorResize)->ArgsProduct({{720, 1080}, {0, 1}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MatResize)->Arg(720)->Arg(1080)->Arg(2160)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Normalize)->ArgsProduct({{720, 1080}, {0, 1}})->Unit(benchmark::kMicrosecond);
+// detections, dtype
+BENCHMARK(BM_RescaleBboxesTensor)->ArgsProduct({{10, 100, 300}, {0, 1}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RescaleBboxesVector)->Arg(10)->Arg(100)->Arg(300)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ToDetectionList)->ArgsProduct({{10, 100, 300}, {0, 1}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ToDetectionListWithNames)->Arg(10)->Arg(100)->Arg(300)->Unit(benchmark::kMicrosecond);
+
+// format (0: NV12, 1: RGBA), detections, on a 1080p frame
+BENCHMARK(BM_OsdDraw)->ArgsProduct({{0, 1}, {10, 100}})->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -6,7 +6,6 @@
 #include "yaml-cpp/enum_composer.h"
 #include "yaml-cpp/opencv.h"
 #include "yaml-cpp/qt.h"
-#include "yaml-cpp/qt_custom.h"
 #include "yaml-cpp/torch.h"
 
 /**
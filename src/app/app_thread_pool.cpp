@@ -0,0 +1,40 @@
+#include "app_thread_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include <opencv2/core/utility.hpp>
+
+#include "std/threading/affinity.h"
+
+#undef slots
+
+#include <ATen/Parallel.h>
+
+#define slots Q_SLOTS
+
+std::shared_ptr<std::work_stealing_thread_pool> AppThreadPool::configure(const YAML::Node &config) {
+    auto aten_num_threads = config["aten_num_threads"].as<int>(0);
+    if (aten_num_threads > 0)
+        at::set_num_threads(aten_num_threads);
+    auto opencv_num_threads = config["opencv_num_threads"].as<int>(1);
+    if (opencv_num_threads >= 0)
+        cv::setNumThreads(opencv_num_threads);
+
+    auto num_threads = config["num_threads"].as<int>(0);
+    if (num_threads <= 0) {
+        auto num_cores = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+        num_threads = std::max(num_cores - at::get_num_threads(), 1);
+    }
+    AppThreadPool::pool_ = std::make_shared<std::work_stealing_thread_pool>(num_threads);
+
+    auto cpus = std::parse_cpu_list(config["cpu_affinity"].as<std::string>(""));
+    if (!cpus.empty()) {
+        AppThreadPool::pool_->for_each_thread([&cpus](std::thread &thread) {
+            if (!std::set_thread_affinity(thread.native_handle(), cpus))
+                std::cerr << "failed to set app thread pool affinity\n";
+        });
+    }
+    return AppThreadPool::pool_;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+
+#include <yaml-cpp/yaml.h>
+
+#include "std/threading/work_stealing_thread_pool.h"
+
+/**
+ * Singleton App Thread Pool, shared by CPU-side pre-processing, post-processing,
+ * tiling and tracking so that they do not oversubscribe the cores
+ * together with the ATen and OpenCV intra-op pools.
+ */
+class AppThreadPool {
+private:
+    static inline std::shared_ptr<std::work_stealing_thread_pool> pool_;
+
+public:
+    /**
+     * Sizes ATen, OpenCV and the app pool from the threading config node.
+     * num_threads: app pool size, 0 uses the cores left over by ATen.
+     * aten_num_threads: ATen intra-op threads, 0 keeps ATen's default.
+     * opencv_num_threads: OpenCV threads, 1 runs OpenCV sequentially inside pool tasks,
+     *                     negative keeps OpenCV's default.
+     * cpu_affinity: cpu list the app pool threads are pinned to, e.g. "0-3", empty leaves them unpinned.
+     */
+    static std::shared_ptr<std::work_stealing_thread_pool> configure(const YAML::Node &config);
+
+    /// Returns nullptr if configure() has not been called, in which case work runs serially.
+    static inline std::shared_ptr<std::work_stealing_thread_pool> instance() {
+        return AppThreadPool::pool_;
+    }
+};
@@ -0,0 +1,202 @@
+#include "detection_tracker.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+    constexpr int kStateSize = 8;  // cx, cy, w, h, vx, vy, vw, vh
+    constexpr int kMeasurementSize = 4;  // cx, cy, w, h
+
+    inline double seconds_between(GstClockTime from, GstClockTime to) {
+        return (static_cast<double>(to) - static_cast<double>(from)) / GST_SECOND;
+    }
+
+    inline cv::Mat to_measurement(const cv::Rect2d &bbox) {
+        return (cv::Mat_<double>(kMeasurementSize, 1) <<
+                bbox.x + bbox.width / 2, bbox.y + bbox.height / 2, bbox.width, bbox.height);
+    }
+
+    inline cv::Rect2d to_bbox(const cv::Mat &state) {
+        auto w = std::max(state.at<double>(2), 1.), h = std::max(state.at<double>(3), 1.);
+        return {state.at<double>(0) - w / 2, state.at<double>(1) - h / 2, w, h};
+    }
+
+    inline double iou(const cv::Rect2d &a, const cv::Rect2d &b) {
+        auto inter = (a & b).area();
+        auto uni = a.area() + b.area() - inter;
+        return uni > 0 ? inter / uni : 0.;
+    }
+
+    inline void set_transition(cv::KalmanFilter &kf, double dt, double h, const DetectionTrackerOptions &options) {
+        kf.transitionMatrix = cv::Mat::eye(kStateSize, kStateSize, CV_64F);
+        for (int i = 0; i < kMeasurementSize; i++)
+            kf.transitionMatrix.at<double>(i, i + kMeasurementSize) = dt;
+        auto pos_std = options.position_noise() * h, vel_std = options.velocity_noise() * h;
+        kf.processNoiseCov = cv::Mat::zeros(kStateSize, kStateSize, CV_64F);
+        for (int i = 0; i < kMeasurementSize; i++) {
+            kf.processNoiseCov.at<double>(i, i) = pos_std * pos_std * dt;
+            kf.processNoiseCov.at<double>(i + kMeasurementSize, i + kMeasurementSize) = vel_std * vel_std * dt;
+        }
+    }
+}
+
+DetectionTracker::Track::Track(int id,
+                               const Detection &detection,
+                               GstClockTime pts,
+                               const DetectionTrackerOptions &options)
+        : id(id),
+          detection(detection),
+          kf(kStateSize, kMeasurementSize, 0, CV_64F),
+          last_update_pts(pts),
+          state_pts(pts),
+          history(std::max(options.history_size(), 2)) {
+    this->detection.track_id = id;
+    kf.measurementMatrix = cv::Mat::eye(kMeasurementSize, kStateSize, CV_64F);
+    kf.statePost = cv::Mat::zeros(kStateSize, 1, CV_64F);
+    to_measurement(detection.bbox).copyTo(kf.statePost.rowRange(0, kMeasurementSize));
+    auto h = std::max(detection.bbox.height, 1.);
+    auto pos_std = 2 * options.measurement_noise() * h, vel_std = 10 * options.velocity_noise() * h;
+    kf.errorCovPost = cv::Mat::zeros(kStateSize, kStateSize, CV_64F);
+    for (int i = 0; i < kMeasurementSize; i++) {
+        kf.errorCovPost.at<double>(i, i) = pos_std * pos_std;
+        kf.errorCovPost.at<double>(i + kMeasurementSize, i + kMeasurementSize) = vel_std * vel_std;
+    }
+    history.insert(pts, detection.bbox);
+}
+
+DetectionTracker::DetectionTracker(DetectionTrackerOptions options)
+        : options_(options) {}
+
+DetectionTrackerOptions DetectionTracker::options() const noexcept {
+    return options_;
+}
+
+void DetectionTracker::set_options(DetectionTrackerOptions options) {
+    options_ = options;
+}
+
+void DetectionTracker::set_thread_pool(std::shared_ptr<std::work_stealing_thread_pool> thread_pool) {
+    thread_pool_ = std::move(thread_pool);
+}
+
+std::vector<Detection> DetectionTracker::update(GstClockTime pts, const std::vector<Detection> &detections) {
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return detections;
+
+    // predict all tracks to pts, a track is too cheap to be worth a task on its own
+    std::vector<cv::Rect2d> predicted_bboxes(tracks_.size());
+    std::parallel_for(thread_pool_.get(), 0, tracks_.size(), [&](std::size_t t) {
+        auto &track = tracks_[t];
+        auto dt = std::max(seconds_between(track->state_pts, pts), 0.);
+        set_transition(track->kf, dt, track->detection.bbox.height, options_);
+        predicted_bboxes[t] = to_bbox(track->kf.predict());
+        track->state_pts = std::max(track->state_pts, pts);
+    }, 32);
+
+    // greedy iou association
+    std::vector<std::tuple<double, std::size_t, std::size_t>> candidates;
+    for (std::size_t t = 0; t < tracks_.size(); t++) {
+        for (std::size_t d = 0; d < detections.size(); d++) {
+            if (tracks_[t]->detection.label_id != detections[d].label_id)
+                continue;
+            auto score = iou(predicted_bboxes[t], detections[d].bbox);
+            if (score >= options_.iou_threshold())
+                candidates.emplace_back(score, t, d);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+        return std::get<0>(a) > std::get<0>(b);
+    });
+    std::vector<bool> track_matched(tracks_.size(), false), detection_matched(detections.size(), false);
+    std::vector<Detection> results;
+    results.reserve(detections.size());
+    for (const auto &[score, t, d]: candidates) {
+        if (track_matched[t] || detection_matched[d])
+            continue;
+        track_matched[t] = detection_matched[d] = true;
+
+        auto &track = tracks_[t];
+        auto h = std::max(detections[d].bbox.height, 1.);
+        auto meas_std = options_.measurement_noise() * h;
+        track->kf.measurementNoiseCov = cv::Mat::eye(kMeasurementSize, kMeasurementSize, CV_64F) * meas_std * meas_std;
+        auto bbox = to_bbox(track->kf.correct(to_measurement(detections[d].bbox)));
+        track->detection = detections[d];
+        track->detection.track_id = track->id;
+        track->detection.bbox = bbox;
+        track->last_update_pts = pts;
+        track->hits++;
+        track->history.insert(pts, bbox);
+        if (track->hits >= options_.min_hits())
+            results.push_back(track->detection);
+    }
+
+    // drop tracks that have not been matched for too long
+    for (std::size_t t = tracks_.size(); t-- > 0;) {
+        if (!track_matched[t] && seconds_between(tracks_[t]->last_update_pts, pts) > options_.max_age())
+            tracks_.erase(tracks_.begin() + static_cast<std::ptrdiff_t>(t));
+    }
+
+    // spawn new tracks
+    for (std::size_t d = 0; d < detections.size(); d++) {
+        if (detection_matched[d])
+            continue;
+        auto &track = tracks_.emplace_back(std::make_unique<Track>(next_track_id_++, detections[d], pts, options_));
+        if (track->hits >= options_.min_hits())
+            results.push_back(track->detection);
+    }
+    return results;
+}
+
+std::vector<Detection> DetectionTracker::predict(GstClockTime pts) {
+    std::vector<Detection> results;
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return results;
+    results.reserve(tracks_.size());
+    for (auto &track: tracks_) {
+        if (track->hits < options_.min_hits())
+            continue;
+        if (seconds_between(track->last_update_pts, pts) > options_.max_age())
+            continue;
+
+        auto detection = track->detection;
+        auto dt = seconds_between(track->state_pts, pts);
+        if (dt >= 0) {
+            // extrapolate with the estimated velocity
+            const auto &state = track->kf.statePost;
+            cv::Mat extrapolated = state.rowRange(0, kMeasurementSize) +
+                                   state.rowRange(kMeasurementSize, kStateSize) * dt;
+            detection.bbox = to_bbox(extrapolated);
+        } else {
+            // displayed frame is behind the last result, interpolate the history
+            auto before = track->history.latest_record_before(pts);
+            auto after = track->history.earliest_record_after(pts);
+            if (!before.has_value())
+                continue;
+            if (!after.has_value()) {
+                detection.bbox = before->value;
+            } else {
+                auto alpha = seconds_between(before->timestamp, pts) /
+                             seconds_between(before->timestamp, after->timestamp);
+                const auto &a = before->value, &b = after->value;
+                detection.bbox = {a.x + (b.x - a.x) * alpha,
+                                  a.y + (b.y - a.y) * alpha,
+                                  a.width + (b.width - a.width) * alpha,
+                                  a.height + (b.height - a.height) * alpha};
+            }
+        }
+        results.push_back(detection);
+    }
+    return results;
+}
+
+const std::vector<std::unique_ptr<DetectionTracker::Track>> &DetectionTracker::tracks() const noexcept {
+    return tracks_;
+}
+
+bool DetectionTracker::empty() const noexcept {
+    return tracks_.empty();
+}
+
+void DetectionTracker::reset() {
+    tracks_.clear();
+}
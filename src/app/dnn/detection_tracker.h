@@ -0,0 +1,159 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <gst/gst.h>
+
+#include <opencv2/video/tracking.hpp>
+
+#include "dnn/return_types.h"
+#include "std/threading/work_stealing_thread_pool.h"
+
+#include "../utils/history.h"
+
+class DetectionTrackerOptions {
+public:
+    DetectionTrackerOptions()
+            : iou_threshold_(0.3),
+              max_age_(1.),
+              min_hits_(1),
+              history_size_(30),
+              position_noise_(0.05),
+              velocity_noise_(0.2),
+              measurement_noise_(0.05) {}
+
+    // setters
+    [[nodiscard]] inline DetectionTrackerOptions iou_threshold(double iou_threshold) const noexcept {
+        auto r = *this;
+        r.iou_threshold_ = iou_threshold;
+        return r;
+    }
+
+    [[nodiscard]] inline DetectionTrackerOptions max_age(double max_age) const noexcept {
+        auto r = *this;
+        r.max_age_ = max_age;
+        return r;
+    }
+
+    [[nodiscard]] inline DetectionTrackerOptions min_hits(int min_hits) const noexcept {
+        auto r = *this;
+        r.min_hits_ = min_hits;
+        return r;
+    }
+
+    [[nodiscard]] inline DetectionTrackerOptions history_size(int history_size) const noexcept {
+        auto r = *this;
+        r.history_size_ = history_size;
+        return r;
+    }
+
+    [[nodiscard]] inline DetectionTrackerOptions position_noise(double position_noise) const noexcept {
+        auto r = *this;
+        r.position_noise_ = position_noise;
+        return r;
+    }
+
+    [[nodiscard]] inline DetectionTrackerOptions velocity_noise(double velocity_noise) const noexcept {
+        auto r = *this;
+        r.velocity_noise_ = velocity_noise;
+        return r;
+    }
+
+    [[nodiscard]] inline DetectionTrackerOptions measurement_noise(double measurement_noise) const noexcept {
+        auto r = *this;
+        r.measurement_noise_ = measurement_noise;
+        return r;
+    }
+
+    // getters
+    [[nodiscard]] inline double iou_threshold() const noexcept {
+        return iou_threshold_;
+    }
+
+    /// Seconds a track survives without being matched.
+    [[nodiscard]] inline double max_age() const noexcept {
+        return max_age_;
+    }
+
+    [[nodiscard]] inline int min_hits() const noexcept {
+        return min_hits_;
+    }
+
+    [[nodiscard]] inline int history_size() const noexcept {
+        return history_size_;
+    }
+
+    /// Process noise standard deviations, relative to the box height per second.
+    [[nodiscard]] inline double position_noise() const noexcept {
+        return position_noise_;
+    }
+
+    [[nodiscard]] inline double velocity_noise() const noexcept {
+        return velocity_noise_;
+    }
+
+    /// Measurement noise standard deviation, relative to the box height.
+    [[nodiscard]] inline double measurement_noise() const noexcept {
+        return measurement_noise_;
+    }
+
+private:
+    double iou_threshold_;
+    double max_age_;
+    int min_hits_;
+    int history_size_;
+    double position_noise_;
+    double velocity_noise_;
+    double measurement_noise_;
+};
+
+/**
+ * SORT-like multi-object tracker.
+ * Each track is a constant velocity Kalman filter over the box center and size,
+ * associated to new detections of the same label by greedy IoU matching.
+ * Boxes can be predicted at any timestamp in between sparse detection results,
+ * either interpolated from the track history or extrapolated from its velocity.
+ */
+class DetectionTracker {
+public:
+    struct Track {
+        int id;
+        Detection detection;
+        cv::KalmanFilter kf;
+        GstClockTime last_update_pts;
+        GstClockTime state_pts;  // kf.statePost is the state at this timestamp
+        int hits = 1;
+        History<cv::Rect2d, GstClockTime> history;
+
+        Track(int id, const Detection &detection, GstClockTime pts, const DetectionTrackerOptions &options);
+    };
+
+private:
+    DetectionTrackerOptions options_;
+    std::shared_ptr<std::work_stealing_thread_pool> thread_pool_;
+    std::vector<std::unique_ptr<Track>> tracks_;
+    int next_track_id_ = 0;
+
+public:
+    explicit DetectionTracker(DetectionTrackerOptions options = {});
+
+    [[nodiscard]] DetectionTrackerOptions options() const noexcept;
+
+    void set_options(DetectionTrackerOptions options);
+
+    /// Kalman filter steps of many tracks are run in parallel on this pool, serially if null.
+    void set_thread_pool(std::shared_ptr<std::work_stealing_thread_pool> thread_pool);
+
+    /// Corrects tracks with the detections of the frame at pts and returns them with their track ids.
+    std::vector<Detection> update(GstClockTime pts, const std::vector<Detection> &detections);
+
+    /// Predicts boxes of confirmed tracks at pts without modifying the tracks.
+    [[nodiscard]] std::vector<Detection> predict(GstClockTime pts);
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Track>> &tracks() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    void reset();
+};
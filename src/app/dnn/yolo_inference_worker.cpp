@@ -1,9 +1,17 @@
 #include "yolo_inference_worker.h"
 
+#include "../app_thread_pool.h"
+#include "gst/utils/latency_tracer.h"
 #include "../utils/debug_mode.h"
 
 #include <QDebug>
 
+#undef slots
+
+#include <ATen/Parallel.h>
+
+#define slots Q_SLOTS
+
 YoloInferenceWorker::YoloInferenceWorker(GstElement *app_sink,
                                          at::Device device,
                                          at::ScalarType dtype,
@@ -11,7 +19,9 @@ YoloInferenceWorker::YoloInferenceWorker(GstElement *app_sink,
         : DynamicUpdateInferenceWorker(app_sink),
           device_(device),
           dtype_(dtype),
-          verbose_(verbose) {}
+          verbose_(verbose) {
+    model_.set_thread_pool(AppThreadPool::instance());
+}
 
 YoloInferenceWorker::YoloInferenceWorker(GstElement *app_sink,
                                          ultralytics::YoloOptions options,
@@ -33,6 +43,17 @@ YoloInferenceWorker::YoloInferenceWorker(GstElement *app_sink,
     update_model_later(model_filepath, classes_filepath, {}, {}, options);
 }
 
+void YoloInferenceWorker::setup() {
+    auto cpus = cpu_affinity();
+    if (cpus.empty())
+        return;
+    // one chunk per intra-op thread, each pins the thread running it
+    at::parallel_for(0, at::get_num_threads(), 1, [&cpus](int64_t begin, int64_t end) {
+        std::set_current_thread_affinity(cpus);
+        std::set_current_thread_numa_local();
+    });
+}
+
 std::optional<GstInferenceSample> YoloInferenceWorker::forward(const GstInferenceSample &sample) {
     AutoDebugMode m(verbose_);
     at::NoGradGuard g;
@@ -41,19 +62,47 @@ std::optional<GstInferenceSample> YoloInferenceWorker::forward(const GstInferenc
         time_meter_.reset();
     })
     auto frame_id = sample.frame_id();
+    if (timeline_ && timeline_->contains(sample.pts())) {
+        if (auto record = timeline_->lookup(sample.pts()); record.has_value()) {
+            last_detections_ = std::move(record->detections);
+            emit_results(frame_id, sample, last_detections_, false);
+            return std::nullopt;
+        }
+    }
     auto img = sample.get_image();
+    if (img.size() != input_size_) {
+        // this frame falls back to a warm shape, the graph is specialized before the next one
+        input_size_ = img.size();
+        update_later([this]() { warmup_inference_shapes(); });
+    }
 
     DEBUG_ONLY([&]() {
         time_meter_.tick();
     })
-    // inference
-    auto detections = model_.forward(img);
+    // inference, or post-processing only of a prediction cached by a previous pass
+    std::vector<Detection> detections;
+    if (prediction_cache_ && prediction_key_.source_hash && prediction_key_.model_hash &&
+        GST_CLOCK_TIME_IS_VALID(sample.pts())) {
+        auto key = prediction_key_;
+        key.pts = sample.pts();
+        auto prediction = prediction_cache_->find(key);
+        if (!prediction.has_value()) {
+            prediction = model_.predict(img, roi_mask_);
+            prediction_cache_->insert(key, prediction.value());
+        }
+        model_.retain_prediction(prediction.value());
+        detections = model_.postprocess(prediction.value());
+    } else {
+        detections = model_.forward(img, roi_mask_);
+    }
+    retain_frame(frame_id, sample);
     DEBUG_ONLY([&]() {
         time_meter_.tick();
     })
+    LatencyTracer::trace(LatencyTracer::STAGE_Forward, sample.capture_time());
 
-    emit new_sample_and_result(frame_id, sample, detections);
-    emit new_result(frame_id, detections);
+    last_detections_ = detections;
+    emit_results(frame_id, sample, detections);
 
     DEBUG_ONLY([&]() {
         time_meter_.duration_stats_update();
@@ -63,7 +112,8 @@ std::optional<GstInferenceSample> YoloInferenceWorker::forward(const GstInferenc
                 "\n\ttotal_elapsed_time=", std::setw(5),
                 (float) time_meter_.duration_cast<std::chrono::microseconds>().count() / 1000, "ms/",
                 (float) time_meter_.mean_duration_cast<std::chrono::microseconds>()->count() / 1000, "ms",
-                " (infer:", time_meter_.duration_cast<std::chrono::microseconds>(0, 1).count(), "µs)\n");
+                " (infer:", time_meter_.duration_cast<std::chrono::microseconds>(0, 1).count(), "µs)",
+                ", frame_gate_hit_rate=", frame_gate_hit_rate(), "\n");
         for (auto &det: detections) {
             result_str = c10::str(
                     result_str, " ", det.label_id,
@@ -75,6 +125,84 @@ std::optional<GstInferenceSample> YoloInferenceWorker::forward(const GstInferenc
     return std::nullopt;
 }
 
+std::optional<GstInferenceSample> YoloInferenceWorker::reuse(const GstInferenceSample &sample,
+                                                              const cv::Point2d &shift) {
+    auto detections = last_detections_;
+    for (auto &det: detections)
+        det.bbox += shift;
+    emit_results(sample.frame_id(), sample, detections);
+    return std::nullopt;
+}
+
+void YoloInferenceWorker::set_detection_log(std::shared_ptr<DetectionLogWriter> detection_log) {
+    detection_log_ = std::move(detection_log);
+}
+
+void YoloInferenceWorker::set_timeline(std::shared_ptr<DetectionTimeline> timeline) {
+    timeline_ = std::move(timeline);
+}
+
+void YoloInferenceWorker::set_prediction_cache(std::shared_ptr<ultralytics::YoloPredictionCache> prediction_cache) {
+    prediction_cache_ = std::move(prediction_cache);
+}
+
+std::shared_ptr<ultralytics::YoloPredictionCache> YoloInferenceWorker::prediction_cache() const noexcept {
+    return prediction_cache_;
+}
+
+void YoloInferenceWorker::update_prediction_key() {
+    prediction_key_.input_shape = options_.input_shape();
+    prediction_key_.dtype = dtype_;
+    prediction_key_.preprocess_hash = ultralytics::YoloPredictionCache::hash_preprocess(options_, roi_mask_);
+}
+
+void YoloInferenceWorker::warmup_inference_shapes() {
+    try {
+        at::NoGradGuard g;
+        model_.warmup_inference_shapes(input_size_);
+    } catch (const c10::Error &e) {
+        std::cerr << "error warming up the model\n";
+        emit error(e.what());
+    }
+}
+
+void YoloInferenceWorker::retain_frame(unsigned long frame_id, const GstInferenceSample &sample) {
+    if (!model_.max_retained_predictions())
+        return;
+    retained_frames_.push_back({frame_id, sample.pts(), sample.width(), sample.height()});
+    while (retained_frames_.size() > model_.max_retained_predictions())
+        retained_frames_.pop_front();
+}
+
+void YoloInferenceWorker::repostprocess_retained() {
+    const auto &predictions = model_.retained_predictions();
+    auto n = std::min(predictions.size(), retained_frames_.size());
+    for (std::size_t i = 0; i < n; i++) {
+        const auto &frame = retained_frames_[retained_frames_.size() - n + i];
+        auto detections = model_.postprocess(predictions[predictions.size() - n + i]);
+        if (i + 1 == n)
+            last_detections_ = detections;
+        emit new_frame_result(frame.frame_id, frame.pts, frame.width, frame.height, detections);
+        emit new_result(frame.frame_id, frame.pts, detections);
+    }
+}
+
+void YoloInferenceWorker::emit_results(unsigned long frame_id,
+                                       const GstInferenceSample &sample,
+                                       const std::vector<Detection> &detections,
+                                       bool append_to_log) {
+    auto tracer = LatencyTracer::instance();
+    if (tracer)  // the overlay only knows the pts of the results it shows
+        tracer->remember(sample.pts(), sample.capture_time());
+    emit new_sample_and_result(frame_id, sample, detections);
+    emit new_frame_result(frame_id, sample.pts(), sample.width(), sample.height(), detections);
+    emit new_result(frame_id, sample.pts(), detections);
+    if (detection_log_ && append_to_log)
+        detection_log_->append(frame_id, sample.pts(), detections);
+    if (tracer)
+        tracer->record(LatencyTracer::STAGE_Emit, sample.capture_time());
+}
+
 void YoloInferenceWorker::update_model_later(const std::string &model_filepath,
                                              const std::string &classes_filepath,
                                              std::optional<at::Device> device,
@@ -100,6 +228,13 @@ void YoloInferenceWorker::update_model_later(const std::string &model_filepath,
             options_ = options.value();
             model_.set_options(options_);
         }
+        if (prediction_cache_) {
+            prediction_key_.model_hash = ultralytics::YoloPredictionCache::hash_file(model_filepath, false);
+            update_prediction_key();
+        }
+        retained_frames_.clear();
+        warmup_inference_shapes();
+        reset_frame_gate();
     });
 }
 
@@ -116,6 +251,57 @@ void YoloInferenceWorker::update_options_later(std::optional<at::Device> device,
         if (options.has_value()) {
             options_ = options.value();
             model_.set_options(options_);
+            // results of the previous options are stale, frames seeked back to are post-processed again
+            if (timeline_)
+                timeline_->clear();
+            try {
+                repostprocess_retained();
+            } catch (const c10::Error &e) {
+                emit error(e.what());
+            }
+        }
+        if (device.has_value() || dtype.has_value() || options.has_value())
+            warmup_inference_shapes();
+        update_prediction_key();
+        reset_frame_gate();
+    });
+}
+
+void YoloInferenceWorker::update_roi_mask_later(const cv::Mat &roi_mask) {
+    update_later([this, roi_mask]() {
+        roi_mask_ = roi_mask;
+        update_prediction_key();
+        reset_frame_gate();
+    });
+}
+
+void YoloInferenceWorker::update_max_retained_predictions_later(std::size_t max_retained_predictions) {
+    update_later([this, max_retained_predictions]() {
+        model_.set_max_retained_predictions(max_retained_predictions);
+        while (retained_frames_.size() > max_retained_predictions)
+            retained_frames_.pop_front();
+    });
+}
+
+void YoloInferenceWorker::update_prediction_cache_source_later(const std::string &source_filepath) {
+    update_later([this, source_filepath]() {
+        prediction_key_.source_hash = source_filepath.empty()
+                                      ? 0 : ultralytics::YoloPredictionCache::hash_file(source_filepath);
+    });
+}
+
+void YoloInferenceWorker::warmup_later(const std::vector<cv::Size> &input_shapes,
+                                       std::optional<std::size_t> max_warm_shapes) {
+    update_later([this, input_shapes, max_warm_shapes]() {
+        if (max_warm_shapes.has_value())
+            model_.set_max_warm_shapes(max_warm_shapes.value());
+        try {
+            at::NoGradGuard g;
+            for (const auto &input_shape: input_shapes)
+                model_.warmup(input_shape);
+        } catch (const c10::Error &e) {
+            std::cerr << "error warming up the model\n";
+            emit error(e.what());
         }
     });
 }
@@ -2,8 +2,11 @@
 
 #include "dynamic_update_inference_worker.h"
 
+#include "dnn/detection_log.h"
+#include "dnn/ultralytics/prediction_cache.h"
 #include "dnn/ultralytics/yolo.h"
 
+#include "../utils/detection_timeline.h"
 #include "../utils/time_meter.h"
 
 class YoloInferenceWorker : public DynamicUpdateInferenceWorker {
@@ -13,6 +16,22 @@ Q_OBJECT  // Q_OBJECT does not allow template classes
     at::Device device_;
     at::ScalarType dtype_;
     ultralytics::YoloOptions options_;
+    cv::Mat roi_mask_;
+    std::vector<Detection> last_detections_;
+    std::shared_ptr<DetectionLogWriter> detection_log_;
+    std::shared_ptr<DetectionTimeline> timeline_;
+    std::shared_ptr<ultralytics::YoloPredictionCache> prediction_cache_;
+    // key of the current source, model and options, without pts
+    ultralytics::YoloPredictionKey prediction_key_;
+    struct RetainedFrame {
+        unsigned long frame_id;
+        GstClockTime pts;
+        int width, height;
+    };
+    // frames of the predictions retained by the model, oldest first
+    std::deque<RetainedFrame> retained_frames_;
+    // size of the last inferred frame, its inference shape is warmed in update()
+    cv::Size input_size_;
     bool verbose_;
 
     time_meter<std::chrono::high_resolution_clock> time_meter_;
@@ -45,18 +64,63 @@ public:
         return options_;
     }
 
+    /// Appends the results of every sample, inferred or reused, to the given log,
+    /// but not those looked up in the timeline.
+    /// Must be called before the thread is started.
+    void set_detection_log(std::shared_ptr<DetectionLogWriter> detection_log);
+
+    /// Samples within processed ranges of the timeline are given its results instead of being inferred.
+    /// Must be called before the thread is started.
+    void set_timeline(std::shared_ptr<DetectionTimeline> timeline);
+
+    /// Raw predictions of frames of a source file are looked up in, or added to, the cache
+    /// instead of running the model, see update_prediction_cache_source_later().
+    /// Must be called before the thread is started.
+    void set_prediction_cache(std::shared_ptr<ultralytics::YoloPredictionCache> prediction_cache);
+
+    [[nodiscard]] std::shared_ptr<ultralytics::YoloPredictionCache> prediction_cache() const noexcept;
+
 protected:
+    /// Extends the worker thread affinity to the ATen intra-op threads.
+    void setup() override;
+
     std::optional<GstInferenceSample> forward(const GstInferenceSample &sample) override;
 
+    std::optional<GstInferenceSample> reuse(const GstInferenceSample &sample, const cv::Point2d &shift) override;
+
+private:
+    void update_prediction_key();
+
+    void warmup_inference_shapes();
+
+    void retain_frame(unsigned long frame_id, const GstInferenceSample &sample);
+
+    /// Re-emits the results of the retained predictions post-processed with the current options.
+    void repostprocess_retained();
+
+    /// Results looked up in the timeline are already logged, and are not appended again.
+    void emit_results(unsigned long frame_id,
+                      const GstInferenceSample &sample,
+                      const std::vector<Detection> &detections,
+                      bool append_to_log = true);
+
 signals:
 
     void new_result(unsigned long frame_id,
+                    GstClockTime pts,
                     const std::vector<Detection> &detections);
 
     void new_sample_and_result(unsigned long frame_id,
                                const GstInferenceSample &sample,
                                const std::vector<Detection> &detections);
 
+    /// Also emitted for retained predictions post-processed again, when there is no sample.
+    void new_frame_result(unsigned long frame_id,
+                          GstClockTime pts,
+                          int frame_width,
+                          int frame_height,
+                          const std::vector<Detection> &detections);
+
     void error(const char *what);
 
 public slots:
@@ -70,4 +134,16 @@ public slots:
     void update_options_later(std::optional<at::Device> device = {},
                               std::optional<at::ScalarType> dtype = {},
                               std::optional<ultralytics::YoloOptions> options = {});
+
+    void update_roi_mask_later(const cv::Mat &roi_mask);
+
+    /// File the samples are decoded from, empty for live sources whose predictions are not cached.
+    void update_prediction_cache_source_later(const std::string &source_filepath);
+
+    /// Raw predictions of this many last inferred frames are post-processed again
+    /// and their results re-emitted when options change, even if no new frame comes.
+    void update_max_retained_predictions_later(std::size_t max_retained_predictions);
+
+    void warmup_later(const std::vector<cv::Size> &input_shapes,
+                      std::optional<std::size_t> max_warm_shapes = {});
 };
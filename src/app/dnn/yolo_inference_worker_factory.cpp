@@ -0,0 +1,99 @@
+#include "yolo_inference_worker_factory.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "../app_config.h"
+#include "../macros.h"
+
+ultralytics::YoloOptions yolo_options_from_config(const YAML::Node &config) {
+    return ultralytics::YoloOptions()
+            .input_shape(config["input_shape"].as<cv::Size>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, input_shape)))
+            .confidence_threshold(config["confidence_threshold"].as<float>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, confidence_threshold)))
+            .score_threshold(config["score_threshold"].as<float>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, score_threshold)))
+            .nms_threshold(config["nms_threshold"].as<float>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, nms_threshold)))
+            .max_det(config["max_det"].as<int>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, max_det)))
+            .align_center(config["align_center"].as<bool>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, align_center)))
+            .tile_shape(config["tile_shape"].as<cv::Size>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, tile_shape)))
+            .tile_overlap(config["tile_overlap"].as<float>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, tile_overlap)))
+            .tile_full_frame(config["tile_full_frame"].as<bool>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, tile_full_frame)))
+            .rect(config["rect"].as<bool>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, rect)))
+            .stride(config["stride"].as<int>(
+                    DEFAULT_PARAM(ultralytics::YoloOptions, stride)));
+}
+
+QSharedPointer<YoloInferenceWorker> init_yolo_inference_worker(GstInferenceQThread *thread,
+                                                               const YAML::Node &config,
+                                                               at::Device fallback_device,
+                                                               at::ScalarType fallback_dtype) {
+    auto worker = thread->init_worker<YoloInferenceWorker>(
+            nullptr,
+            config["model_filepath"].as<AppConfig::crel_path>().string(),
+            config["classes_filepath"].IsDefined()
+            ? config["classes_filepath"].as<AppConfig::crel_path>().string() : "",
+            yolo_options_from_config(config["yolo_options"]),
+            config["device"].as<at::Device>(fallback_device),
+            config["dtype"].as<at::ScalarType>(fallback_dtype),
+            config["verbose"].as<bool>(false));
+    if (config["roi_mask_filepath"].IsDefined() && !config["roi_mask_filepath"].IsNull()) {
+        auto roi_mask = cv::imread(config["roi_mask_filepath"].as<AppConfig::crel_path>().string(),
+                                   cv::IMREAD_GRAYSCALE);
+        if (!roi_mask.empty())
+            worker->update_roi_mask_later(roi_mask);
+    }
+    worker->warmup_later(
+            config["warmup_shapes"].as<std::vector<cv::Size>>(std::vector<cv::Size>{}),
+            config["max_warm_shapes"].as<std::size_t>(4));
+    if (config["retained_predictions"].IsDefined())
+        worker->update_max_retained_predictions_later(config["retained_predictions"].as<std::size_t>());
+    worker->set_sample_ring_size(config["sample_ring_size"].as<std::size_t>(0));
+    if (config["frame_gate"].IsDefined()) {
+        auto frame_gate_config = config["frame_gate"];
+        worker->set_frame_gate_options(
+                FrameDifferenceGateOptions()
+                        .threshold(frame_gate_config["threshold"].as<double>(
+                                DEFAULT_PARAM(FrameDifferenceGateOptions, threshold)))
+                        .thumbnail_width(frame_gate_config["thumbnail_width"].as<int>(
+                                DEFAULT_PARAM(FrameDifferenceGateOptions, thumbnail_width)))
+                        .motion_compensation(frame_gate_config["motion_compensation"].as<bool>(
+                                DEFAULT_PARAM(FrameDifferenceGateOptions, motion_compensation)))
+                        .max_consecutive_skips(frame_gate_config["max_consecutive_skips"].as<unsigned int>(
+                                DEFAULT_PARAM(FrameDifferenceGateOptions, max_consecutive_skips))));
+    }
+    if (config["prediction_cache"]["enabled"].as<bool>(false)) {
+        auto cache_config = config["prediction_cache"];
+        worker->set_prediction_cache(std::make_shared<ultralytics::YoloPredictionCache>(
+                ultralytics::YoloPredictionCacheOptions()
+                        .max_memory(cache_config["max_memory"].as<std::size_t>(
+                                DEFAULT_PARAM(ultralytics::YoloPredictionCacheOptions, max_memory) >> 20) << 20)
+                        .directory(cache_config["directory"].as<std::string>("").empty()
+                                   ? "" : cache_config["directory"].as<AppConfig::arel_path>().string())
+                        .min_score(cache_config["min_score"].as<float>(
+                                DEFAULT_PARAM(ultralytics::YoloPredictionCacheOptions, min_score)))));
+    }
+    auto detection_log_filepath = config["detection_log_filepath"].as<std::string>("");
+    if (!detection_log_filepath.empty()) {
+        // class names are stored in the log, read them here as the model is loaded in the worker
+        ultralytics::YoloBase classes;
+        if (config["classes_filepath"].IsDefined())
+            classes.load_classes(config["classes_filepath"].as<AppConfig::crel_path>().string());
+        auto classes_names = classes.classes_names();
+        auto detection_log = std::make_shared<DetectionLogWriter>(
+                config["detection_log_filepath"].as<AppConfig::arel_path>().string(),
+                std::vector<std::string>(classes_names.begin(), classes_names.end()));
+        if (detection_log->is_open())
+            worker->set_detection_log(std::move(detection_log));
+    }
+    worker->set_cpu_affinity(
+            std::parse_cpu_list(config["cpu_affinity"].as<std::string>("")));
+    return worker;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <yaml-cpp/yaml.h>
+
+#include "gst/gst_inference_qthread.h"
+
+#include "yolo_inference_worker.h"
+
+/// Yolo options of a yolo_infer config node, defaults for missing keys.
+ultralytics::YoloOptions yolo_options_from_config(const YAML::Node &config);
+
+/**
+ * Initializes the YoloInferenceWorker of thread from a yolo_infer config node:
+ * model, options, device, dtype, roi mask, warmup shapes, sample ring, frame gate
+ * and cpu affinity. The thread is not started.
+ */
+QSharedPointer<YoloInferenceWorker> init_yolo_inference_worker(GstInferenceQThread *thread,
+                                                               const YAML::Node &config,
+                                                               at::Device fallback_device,
+                                                               at::ScalarType fallback_dtype = at::kFloat);
@@ -1,10 +1,14 @@
 #include "gst_pipeline_manager.h"
 #include "gst/gst_bin_get_element.h"
+#include "gst/gst_detection_overlay_probe.h"
 #include "gst/gst_element_pad_link.h"
 
 #include <fmt/core.h>
 
+#include "std/threading/affinity.h"
+
 #include "../app_config.h"
+#include "../macros.h"
 
 namespace {
     inline gboolean gst_pipeline_set_state(GstElement *pipeline, GstState state) {
@@ -30,6 +34,8 @@ GstPipelineManager::GstPipelineManager() {
 GstPipelineManager::~GstPipelineManager() {
     if (pipeline_) {
         gst_element_set_state(pipeline_, GST_STATE_NULL);
+        // the flushing appsrc unblocks the replay thread
+        replay_source_.reset();
         while (GST_OBJECT_REFCOUNT(GST_OBJECT_CAST(pipeline_)))
             gst_object_unref(pipeline_);
     }
@@ -38,10 +44,21 @@ GstPipelineManager::~GstPipelineManager() {
 void GstPipelineManager::init_pipeline() {
     auto pipeline_config = AppConfig::instance()["app"]["gst"]["pipeline"];
 
+    /* Replay */
+    auto replay_config = pipeline_config["replay"];
+    std::shared_ptr<FrameReplayStore> replay_store;
+    if (auto replay_path = replay_config["source"].as<std::string>(""); !replay_path.empty()) {
+        replay_store = FrameReplayStore::open(replay_path, replay_config["fps"].as<double>(30.));
+        if (!replay_store)
+            g_error("failed to open replay source %s", replay_path.c_str());
+        replay_filepath_ = replay_path;
+    }
+
     /* Init pipeline */
     pipeline_ = gst_pipeline_new(pipeline_config["name"].as<std::string>().c_str());
     GError *error = NULL;
-    auto stem_bin_description = pipeline_config["stem_bin"]["description"].as<std::string>();
+    auto stem_bin_description = replay_store ? replay_config["description"].as<std::string>()
+                                             : pipeline_config["stem_bin"]["description"].as<std::string>();
     auto stem_bin = gst_parse_launch_full(
             stem_bin_description.c_str(), NULL, GST_BIN_PARSE_FLAGS, &error);
     if (error)
@@ -50,7 +67,24 @@ void GstPipelineManager::init_pipeline() {
         g_error("inference_tee not found in stem_bin description");
 
     /* Add elements */
-    add_bin("stem", stem_bin);
+    add_bin("stem", stem_bin,
+            std::parse_cpu_list(pipeline_config["stem_bin"]["cpu_affinity"].as<std::string>("")));
+
+    if (replay_store) {
+        auto replay_element = replay_config["element"].as<std::string>("replay_src");
+        auto *app_src = get_element(replay_element.c_str());
+        if (!app_src)
+            g_error("%s not found in replay description", replay_element.c_str());
+        auto options = GstFrameReplaySourceOptions()
+                .rate(replay_config["rate"].as<double>(
+                        DEFAULT_PARAM(GstFrameReplaySourceOptions, rate)))
+                .loop(replay_config["loop"].as<bool>(
+                        DEFAULT_PARAM(GstFrameReplaySourceOptions, loop)))
+                .max_buffers(replay_config["max_buffers"].as<guint>(
+                        DEFAULT_PARAM(GstFrameReplaySourceOptions, max_buffers)));
+        replay_source_ = std::make_unique<GstFrameReplaySource>(app_src, std::move(replay_store), options);
+        gst_object_unref(app_src);
+    }
 
     /* Add probes */
     if (pipeline_config["frame_meta_probe"]["element"].IsDefined()) {
@@ -86,7 +120,8 @@ GstElement *GstPipelineManager::add_inference_bin(const gchar *name) {
     if (error)
         g_error("failed to init %s_bin", name);
 
-    add_bin(name, bin);
+    add_bin(name, bin,
+            std::parse_cpu_list(pipeline_config["inference_bin"]["cpu_affinity"].as<std::string>("")));
 
     /* Link inference_tee */
     GstElement *bin_sink_element = NULL;
@@ -105,8 +140,79 @@ GstElement *GstPipelineManager::add_inference_bin(const gchar *name) {
     return bin;
 }
 
-void GstPipelineManager::add_bin(const gchar *name, GstElement *bin) {
+bool GstPipelineManager::add_detection_meta_probe(std::shared_ptr<GstDetectionResults> results) {
+    auto pipeline_config = AppConfig::instance()["app"]["gst"]["pipeline"];
+    if (!pipeline_config["detection_meta_probe"]["element"].IsDefined())
+        return false;
+    auto *element = get_element(pipeline_config["detection_meta_probe"]["element"].as<std::string>().c_str());
+    if (!element) {
+        g_printerr("detection_meta_probe element not found\n");
+        return false;
+    }
+    auto *detection_meta_add_probe = new GstDetectionMetaAddProbe(std::move(results));
+    return detection_meta_add_probe->add_on(
+            element, pipeline_config["detection_meta_probe"]["pad"].as<std::string>().c_str());
+}
+
+GstElement *GstPipelineManager::add_osd_bin(std::shared_ptr<GstDetectionResults> results) {
+    auto pipeline_config = AppConfig::instance()["app"]["gst"]["pipeline"];
+    auto osd_config = pipeline_config["osd_bin"];
+    if (!osd_config["enabled"].as<bool>(false))
+        return NULL;
+
+    auto osd_bin_description = fmt::format(osd_config["description"].as<std::string>(),
+                                           fmt::arg("bin_name", "osd"));
+    GError *error = NULL;
+    GstElement *bin = gst_parse_launch_full(
+            osd_bin_description.c_str(), NULL, GST_BIN_PARSE_FLAGS, &error);
+    if (error)
+        g_error("failed to init osd_bin");
+
+    add_bin("osd", bin, std::parse_cpu_list(osd_config["cpu_affinity"].as<std::string>("")));
+
+    /* Link inference_tee */
+    auto *bin_sink_element = gst_bin_get_element_by_factory_name(GST_BIN(bin), "queue") ?:
+                             gst_bin_get_first_added_element(GST_BIN(bin));
+    if (!gst_element_link(get_element("inference_tee"), bin_sink_element))
+        g_error("failed to link tee -> osd_bin");
+
+    /* Add probe */
+    auto options = OsdRasterizerOptions()
+            .line_width(osd_config["line_width"].as<int>(
+                    DEFAULT_PARAM(OsdRasterizerOptions, line_width)))
+            .draw_labels(osd_config["draw_labels"].as<bool>(
+                    DEFAULT_PARAM(OsdRasterizerOptions, draw_labels)))
+            .draw_confidence(osd_config["draw_confidence"].as<bool>(
+                    DEFAULT_PARAM(OsdRasterizerOptions, draw_confidence)))
+            .font_scale(osd_config["font_scale"].as<double>(
+                    DEFAULT_PARAM(OsdRasterizerOptions, font_scale)))
+            .font_thickness(osd_config["font_thickness"].as<int>(
+                    DEFAULT_PARAM(OsdRasterizerOptions, font_thickness)));
+    auto *element = gst_bin_get_by_name(GST_BIN(bin), osd_config["element"].as<std::string>("osd").c_str());
+    if (!element) {
+        g_printerr("osd_bin element not found\n");
+        return bin;
+    }
+    auto *overlay_probe = new GstDetectionOverlayProbe(std::move(results), options);
+    overlay_probe->add_on(element, osd_config["pad"].as<std::string>("src").c_str());
+    gst_object_unref(element);
+    return bin;
+}
+
+void GstPipelineManager::add_bin(const gchar *name, GstElement *bin, const std::vector<int> &cpu_affinity) {
     g_assert(bins_.find(name) == bins_.end());
+    if (!cpu_affinity.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(bin_cpu_affinities_mutex_);
+            bin_cpu_affinities_.emplace_back(bin, cpu_affinity);
+        }
+        if (!bus_sync_handler_set_) {
+            GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+            gst_bus_set_sync_handler(bus, &GstPipelineManager::on_bus_sync_message, this, NULL);
+            gst_object_unref(bus);
+            bus_sync_handler_set_ = true;
+        }
+    }
     gst_bin_add(GST_BIN(pipeline_), bin);
     gst_element_sync_state_with_parent(bin);
     bins_.insert({name, bin});
@@ -124,6 +230,62 @@ GstElement *GstPipelineManager::get_element_by_factory_name(const gchar *factory
     return gst_bin_get_element_by_factory_name(GST_BIN(pipeline_), factory_name);
 }
 
+GstFrameReplaySource *GstPipelineManager::replay_source() const noexcept {
+    return replay_source_.get();
+}
+
+std::string GstPipelineManager::source_filepath() const {
+    if (replay_source_)
+        return replay_filepath_;
+    std::string filepath;
+    auto *it = gst_bin_iterate_all_by_element_factory_name(GST_BIN(pipeline_), "filesrc");
+    GValue item = G_VALUE_INIT;
+    if (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+        gchar *location = NULL;
+        g_object_get(g_value_get_object(&item), "location", &location, NULL);
+        if (location)
+            filepath = location;
+        g_free(location);
+        g_value_unset(&item);
+    }
+    gst_iterator_free(it);
+    return filepath;
+}
+
 bool GstPipelineManager::set_state(GstState new_state) {
-    return gst_pipeline_set_state(pipeline_, new_state);
+    if (!gst_pipeline_set_state(pipeline_, new_state)) {
+        if (replay_source_)
+            replay_source_->stop();
+        return false;
+    }
+    if (replay_source_) {
+        if (new_state == GST_STATE_PLAYING)
+            replay_source_->start();
+        else if (new_state <= GST_STATE_READY)
+            replay_source_->stop();
+    }
+    return true;
+}
+
+GstBusSyncReply GstPipelineManager::on_bus_sync_message(GstBus *bus, GstMessage *message, gpointer user_data) {
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_STREAM_STATUS)
+        return GST_BUS_PASS;
+    GstStreamStatusType type;
+    GstElement *owner;
+    gst_message_parse_stream_status(message, &type, &owner);
+    if (type != GST_STREAM_STATUS_TYPE_ENTER)
+        return GST_BUS_PASS;
+
+    // enter messages are posted synchronously from the streaming thread that just started
+    auto *self = static_cast<GstPipelineManager *>(user_data);
+    std::lock_guard<std::mutex> lock(self->bin_cpu_affinities_mutex_);
+    for (const auto &[bin, cpus]: self->bin_cpu_affinities_) {
+        if (owner != bin && !gst_object_has_as_ancestor(GST_OBJECT(owner), GST_OBJECT(bin)))
+            continue;
+        if (!std::set_current_thread_affinity(cpus))
+            g_printerr("Failed to set affinity of %s streaming thread\n", GST_ELEMENT_NAME(owner));
+        std::set_current_thread_numa_local();
+        break;
+    }
+    return GST_BUS_PASS;
 }
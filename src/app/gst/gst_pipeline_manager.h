@@ -1,11 +1,17 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <gst/gst.h>
 #include <gst/video/videooverlay.h>
 #include <gst/gstelement.h>
 #include "gst/gst_frame_meta.h"
+#include "gst/gst_detection_meta.h"
+#include "gst/gst_frame_replay_source.h"
 
 class GstPipelineManager {
     static constexpr GstParseFlags GST_BIN_PARSE_FLAGS = (GstParseFlags)(
@@ -15,6 +21,11 @@ class GstPipelineManager {
 
     GstElement *pipeline_;
     std::map<const gchar *, GstElement *> bins_;
+    std::mutex bin_cpu_affinities_mutex_;
+    std::vector<std::pair<GstElement *, std::vector<int>>> bin_cpu_affinities_;
+    bool bus_sync_handler_set_ = false;
+    std::unique_ptr<GstFrameReplaySource> replay_source_;
+    std::string replay_filepath_;
 
 public:
     GstPipelineManager();
@@ -27,16 +38,35 @@ public:
 
     GstElement *add_inference_bin(const gchar *name);
 
+    /// Attaches results to buffers at the detection_meta_probe element pad of the config, if any.
+    bool add_detection_meta_probe(std::shared_ptr<GstDetectionResults> results);
+
+    /// Adds the osd_bin of the config after inference_tee, if enabled, with detections
+    /// burnt into its frames at the configured element pad.
+    GstElement *add_osd_bin(std::shared_ptr<GstDetectionResults> results);
+
     [[nodiscard]] GstElement *get_bin(const gchar *name) const;
 
     [[nodiscard]] GstElement *get_element(const gchar *name) const;
 
     [[nodiscard]] GstElement *get_element_by_factory_name(const gchar *factory_name) const;
 
+    /// Source of the replay stem of the config when a replay source is set, NULL otherwise.
+    [[nodiscard]] GstFrameReplaySource *replay_source() const noexcept;
+
+    /// File the frames come from, the replay source or the location of the first filesrc,
+    /// empty for live sources.
+    [[nodiscard]] std::string source_filepath() const;
+
+    /// Replaying starts over when the pipeline goes to PLAYING after NULL or READY.
     bool set_state(GstState new_state);
 
 protected:
     void init_pipeline();
 
-    void add_bin(const gchar *name, GstElement *bin);
+    /// Streaming threads of elements inside bin are pinned to cpu_affinity when they start.
+    void add_bin(const gchar *name, GstElement *bin, const std::vector<int> &cpu_affinity = {});
+
+private:
+    static GstBusSyncReply on_bus_sync_message(GstBus *bus, GstMessage *message, gpointer user_data);
 };
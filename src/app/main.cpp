@@ -8,9 +8,27 @@
 #include "ui/main_window.h"
 
 #include "app_config.h"
+#include "app_thread_pool.h"
+#include "gst/utils/latency_tracer.h"
 
 int main(int argc, char *argv[]) {
     auto configs = AppConfig::load("../resources/configs.yaml");
+    AppThreadPool::configure(configs["app"]["threading"]);
+
+    auto latency_tracer_config = configs["app"]["latency_tracer"];
+    if (latency_tracer_config["enabled"].as<bool>(false)) {
+        LatencyTracer::configure(std::make_shared<LatencyTracer>(
+                latency_tracer_config["export_filepath"].as<std::string>(""),
+                std::chrono::milliseconds(latency_tracer_config["export_interval"].as<int>(5000))));
+        if (latency_tracer_config["gst_latency_tracer"].as<bool>(false)) {
+            // must be set before gst_init, explicit environment variables take precedence
+            g_setenv("GST_TRACERS", "latency(flags=pipeline+element)", FALSE);
+            g_setenv("GST_DEBUG", "GST_TRACER:7", FALSE);
+            auto gst_log_filepath = latency_tracer_config["gst_log_filepath"].as<std::string>("");
+            if (!gst_log_filepath.empty())
+                g_setenv("GST_DEBUG_FILE", gst_log_filepath.c_str(), FALSE);
+        }
+    }
 
     gst_init(&argc, &argv);
     QApplication app(argc, argv);
@@ -108,25 +108,19 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     /* Pipeline */
     auto yolo_infer_config = configs["app"]["dnn"]["yolo_infer"];
     yolo_infer_thread.reset(new GstInferenceQThread(this));
-    auto yolo_infer_worker = yolo_infer_thread->init_worker<YoloInferenceWorker>(
-            nullptr,
-            yolo_infer_config["model_filepath"].as<AppConfig::crel_path>().string(),
-            yolo_infer_config["classes_filepath"].IsDefined()
-            ? yolo_infer_config["classes_filepath"].as<AppConfig::crel_path>().string() : "",
-            ultralytics::YoloOptions()
-                    .input_shape(yolo_infer_config["yolo_options"]["input_shape"].as<cv::Size>(
-                            DEFAULT_PARAM(ultralytics::YoloOptions, input_shape)))
-                    .confidence_threshold(yolo_infer_config["yolo_options"]["confidence_threshold"].as<float>(
-                            DEFAULT_PARAM(ultralytics::YoloOptions, confidence_threshold)))
-                    .score_threshold(yolo_infer_config["yolo_options"]["score_threshold"].as<float>(
-                            DEFAULT_PARAM(ultralytics::YoloOptions, score_threshold)))
-                    .nms_threshold(yolo_infer_config["yolo_options"]["nms_threshold"].as<float>(
-                            DEFAULT_PARAM(ultralytics::YoloOptions, nms_threshold)))
-                    .align_center(yolo_infer_config["yolo_options"]["align_center"].as<bool>(
-                            DEFAULT_PARAM(ultralytics::YoloOptions, align_center))),
-            yolo_infer_config["device"].as<at::Device>(fallback_device),
-            yolo_infer_config["dtype"].as<at::ScalarType>(fallback_dtype),
-            yolo_infer_config["verbose"].as<bool>(false));
+    // the detection log of this run is truncated when opened, so it cannot be the one scrubbed
+    auto written_log_config = yolo_infer_config["detection_log_filepath"];
+    auto scrubbed_log_config = window_configs["video_widget"]["timeline"]["detection_log_filepath"];
+    std::error_code ec;
+    if (!written_log_config.as<std::string>("").empty() && !scrubbed_log_config.as<std::string>("").empty() &&
+        std::filesystem::equivalent(written_log_config.as<AppConfig::arel_path>(),
+                                    scrubbed_log_config.as<AppConfig::arel_path>(), ec)) {
+        qWarning() << "detection log written and scrubbed at once, only writing it";
+        video_widget->timeline()->unload();
+    }
+    auto yolo_infer_worker = init_yolo_inference_worker(
+            yolo_infer_thread.data(), yolo_infer_config, fallback_device, fallback_dtype);
+    yolo_infer_worker->set_timeline(video_widget->timeline());
     yolo_infer_thread->start(yolo_infer_config["priority"].as<QThread::Priority>(QThread::NormalPriority));
 
     /* Signals */
@@ -171,13 +165,35 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
             yolo_infer_worker.data(),
             &YoloInferenceWorker::new_result,
             this,
-            [this](unsigned long frame_id, const std::vector<Detection> &dets) {
-                video_widget->request_bboxes_from_pool(dets);
+            [this](unsigned long frame_id, GstClockTime pts, const std::vector<Detection> &dets) {
+                video_widget->on_new_detections(pts, dets);
             }, Qt::BlockingQueuedConnection);
 
+    QObject::connect(  // detection metas, set directly from the worker thread, also after re-post-processing
+            yolo_infer_worker.data(),
+            &YoloInferenceWorker::new_frame_result,
+            this,
+            [results = detection_results](unsigned long frame_id,
+                                          GstClockTime pts,
+                                          int frame_width,
+                                          int frame_height,
+                                          const std::vector<Detection> &dets) {
+                std::vector<GstDetectionMetaEntry> entries;
+                entries.reserve(dets.size());
+                for (const auto &det: dets) {
+                    entries.push_back({det.bbox.x, det.bbox.y, det.bbox.width, det.bbox.height,
+                                       det.label_id, det.label.empty() ? 0 : g_quark_from_string(det.label.c_str()),
+                                       det.confidence, det.track_id});
+                }
+                results->set(pts, frame_width, frame_height, std::move(entries));
+            }, Qt::DirectConnection);
+
     QObject::connect(toggle_ai_btn, &QPushButton::clicked, this, [this](bool checked = false) {
         yolo_infer_thread->pause(!checked);
+        if (!checked)
+            detection_results->clear();
         QTimer::singleShot(200, this, [this]() {
+            video_widget->reset_results();
             video_widget->request_bboxes_from_pool({});
         });
     });
@@ -218,10 +234,15 @@ void MainWindow::resetPipeline() {
             pipeline->get_element("display_sink") ?:
             pipeline->get_element_by_factory_name("qwidget5videosink"));
     pipeline->add_inference_bin("yolo_infer");
-
-    if (!yolo_infer_thread.isNull())
-        yolo_infer_thread->worker<YoloInferenceWorker>()->set_app_sink(
-                pipeline->get_element("yolo_infer_sink"));
+    pipeline->add_detection_meta_probe(detection_results);
+    pipeline->add_osd_bin(detection_results);
+
+    if (!yolo_infer_thread.isNull()) {
+        auto yolo_infer_worker = yolo_infer_thread->worker<YoloInferenceWorker>();
+        yolo_infer_worker->set_app_sink(pipeline->get_element("yolo_infer_sink"));
+        if (yolo_infer_worker->prediction_cache())
+            yolo_infer_worker->update_prediction_cache_source_later(pipeline->source_filepath());
+    }
 
     setPipelineState(GST_STATE_PLAYING);
     pauseInferenceThreads(false);
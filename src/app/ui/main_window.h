@@ -9,6 +9,7 @@
 
 #include "../gst/gst_pipeline_manager.h"
 #include "../dnn/yolo_inference_worker.h"
+#include "../dnn/yolo_inference_worker_factory.h"
 
 #include "video_widget.h"
 
@@ -29,6 +30,7 @@ Q_OBJECT
 
     QScopedPointer<GstPipelineManager> pipeline;
     QScopedPointer<GstInferenceQThread> yolo_infer_thread;
+    std::shared_ptr<GstDetectionResults> detection_results = std::make_shared<GstDetectionResults>();
 
     ColorPalette bbox_color_palette;
 
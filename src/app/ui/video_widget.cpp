@@ -1,7 +1,10 @@
 #include "video_widget.h"
 
 #include "../app_config.h"
+#include "../app_thread_pool.h"
 #include "../macros.h"
+#include "yaml-cpp/qt_custom.h"
+#include "gst/utils/latency_tracer.h"
 
 #include <QDebug>
 
@@ -53,12 +56,115 @@ VideoWidget::VideoWidget(QWidget *parent)
     bbox_pool_ = new OverlayGraphicsItemPool<DetectionBoundingBox>(view());
     bbox_pool_->factory_resize(100, graphics_item_factory(), bbox_options, nullptr);
     bbox_pool_->addToScene(scene_);
+    // the margins of the boxes are in view pixels, so their bounds change with the render scale
+    QObject::connect(this, &MediaWidget::render_scale_changed, this, [this]() {
+        for (const auto &bbox: bbox_pool_->items())
+            bbox->invalidateGeometry();
+    });
+
+    auto tracker_config = configs["tracker"];
+    tracking_ = tracker_config["enabled"].as<bool>(false);
+    tracker_.set_options(DetectionTrackerOptions()
+            .iou_threshold(tracker_config["iou_threshold"].as<double>(
+                    DEFAULT_PARAM(DetectionTrackerOptions, iou_threshold)))
+            .max_age(tracker_config["max_age"].as<double>(
+                    DEFAULT_PARAM(DetectionTrackerOptions, max_age)))
+            .min_hits(tracker_config["min_hits"].as<int>(
+                    DEFAULT_PARAM(DetectionTrackerOptions, min_hits)))
+            .history_size(tracker_config["history_size"].as<int>(
+                    DEFAULT_PARAM(DetectionTrackerOptions, history_size)))
+            .position_noise(tracker_config["position_noise"].as<double>(
+                    DEFAULT_PARAM(DetectionTrackerOptions, position_noise)))
+            .velocity_noise(tracker_config["velocity_noise"].as<double>(
+                    DEFAULT_PARAM(DetectionTrackerOptions, velocity_noise)))
+            .measurement_noise(tracker_config["measurement_noise"].as<double>(
+                    DEFAULT_PARAM(DetectionTrackerOptions, measurement_noise))));
+    tracker_.set_thread_pool(AppThreadPool::instance());
+
+    auto overlay_sync_config = configs["overlay_sync"];
+    pts_aligned_ = overlay_sync_config["enabled"].as<bool>(true);
+    max_lateness_ = static_cast<GstClockTime>(overlay_sync_config["max_lateness"].as<double>(0.5) * GST_SECOND);
+
+    auto timeline_config = configs["timeline"];
+    timeline_ = std::make_shared<DetectionTimeline>(
+            static_cast<GstClockTime>(timeline_config["max_gap"].as<double>(0.5) * GST_SECOND),
+            timeline_config["max_results"].as<std::size_t>(0));
+    if (timeline_config["detection_log_filepath"].IsDefined() &&
+        !timeline_config["detection_log_filepath"].as<std::string>("").empty())
+        load_detection_log(timeline_config["detection_log_filepath"].as<AppConfig::arel_path>().string());
+
+    // show results matching every displayed frame
+    QObject::connect(this, &GstVideoWidget::frame_pts_changed, this, [this](GstClockTime pts) {
+        displayed_pts_ = pts;
+        if (pts_aligned_ || tracking_)
+            refresh_overlay(pts);
+    });
 }
 
 auto *VideoWidget::bbox_pool() const noexcept {
     return bbox_pool_;
 }
 
+bool VideoWidget::tracking() const noexcept {
+    return tracking_;
+}
+
+std::shared_ptr<DetectionTimeline> VideoWidget::timeline() const noexcept {
+    return timeline_;
+}
+
+bool VideoWidget::load_detection_log(const std::string &filepath) {
+    if (!timeline_->load(filepath))
+        return false;
+    if (GST_CLOCK_TIME_IS_VALID(displayed_pts_))
+        refresh_overlay(displayed_pts_);
+    return true;
+}
+
+void VideoWidget::set_tracking(bool tracking) {
+    tracking_ = tracking;
+    reset_results();
+}
+
+std::optional<double> VideoWidget::mean_staleness() const noexcept {
+    return staleness_stats_.mean();
+}
+
+unsigned long VideoWidget::num_stale_frames() const noexcept {
+    return num_stale_frames_;
+}
+
+void VideoWidget::refresh_overlay(GstClockTime pts) {
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+    GstClockTime result_pts = GST_CLOCK_TIME_NONE;
+    if (tracking_) {
+        // tracks are interpolated or extrapolated to pts
+        if (tracker_.empty())
+            return;
+        request_bboxes_from_pool(tracker_.predict(pts), latest_result_pts_);
+        if (GST_CLOCK_TIME_IS_VALID(latest_result_pts_) &&
+            (latest_result_pts_ >= pts || pts - latest_result_pts_ <= max_lateness_))
+            result_pts = std::min(latest_result_pts_, pts);
+    } else {
+        auto record = timeline_->lookup(pts, max_lateness_);
+        if (record.has_value()) {
+            request_bboxes_from_pool(record->detections, record->pts);
+            result_pts = record->pts;
+        } else {
+            request_bboxes_from_pool({});
+        }
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID(result_pts)) {
+        staleness_stats_.update(static_cast<double>(pts - result_pts));
+        emit overlay_staleness_changed(pts - result_pts);
+    } else {
+        num_stale_frames_++;
+        emit overlay_staleness_changed(GST_CLOCK_TIME_NONE);
+    }
+}
+
 QSharedPointer<DetectionBoundingBox> VideoWidget::add_bbox(const Detection &det) {
     auto bbox = graphics_item_factory()->createItem<DetectionBoundingBox>(
             det.label_id,
@@ -89,17 +195,40 @@ QList<QSharedPointer<DetectionBoundingBox>> VideoWidget::add_bboxes(const std::v
 }
 
 QList<QSharedPointer<DetectionBoundingBox>> VideoWidget::request_bboxes_from_pool(
-        const std::vector<Detection> &dets) {
+        const std::vector<Detection> &dets, GstClockTime result_pts) {
+    // items only schedule repaints of their old and new regions when their properties change,
+    // the scene merges them instead of repainting the whole widget
     auto active_bboxes = bbox_pool_->request(std::min((int) dets.size(), bbox_pool_->size()));
-    for (auto i = 0; i < dets.size(); i++) {
-        auto item = active_bboxes[i];
-        auto det = dets[i];
+    for (auto i = 0; i < active_bboxes.size(); i++) {
+        const auto &item = active_bboxes[i];
+        const auto &det = dets[i];
         item->setLabelId(det.label_id);
         item->setLabel(QString::fromStdString(det.label));
         item->setConfidence(det.confidence);
         item->setBBox(QRectF(det.bbox.x, det.bbox.y, det.bbox.width, det.bbox.height));
         item->setColor(bbox_color_palette.at(det.label_id));
     }
-    update();
+    if (auto tracer = LatencyTracer::instance(); tracer && !dets.empty())
+        tracer->record_by_pts(LatencyTracer::STAGE_Overlay, result_pts);
     return active_bboxes;
 }
+
+void VideoWidget::on_new_detections(GstClockTime pts, const std::vector<Detection> &dets) {
+    auto tracked_dets = tracking_ ? tracker_.update(pts, dets) : dets;
+    if (!GST_CLOCK_TIME_IS_VALID(pts)) {
+        request_bboxes_from_pool(tracked_dets);
+        return;
+    }
+    timeline_->insert(pts, tracked_dets);
+    latest_result_pts_ = pts;
+    if ((pts_aligned_ || tracking_) && GST_CLOCK_TIME_IS_VALID(displayed_pts_))
+        refresh_overlay(displayed_pts_);
+    else
+        request_bboxes_from_pool(tracked_dets, pts);
+}
+
+void VideoWidget::reset_results() {
+    tracker_.reset();
+    timeline_->clear();
+    latest_result_pts_ = GST_CLOCK_TIME_NONE;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "dnn/return_types.h"
+#include "../dnn/detection_tracker.h"
+#include "../utils/detection_timeline.h"
+#include "../utils/stats_tracker.h"
 
 #include "qt/ColorPalette"
 #include "qt/OverlayGraphicsScene"
@@ -12,6 +15,17 @@ class VideoWidget : public GraphicsViewOverlayedGstVideoWidget {
 Q_OBJECT
     OverlayGraphicsScene *scene_;
     OverlayGraphicsItemPool<DetectionBoundingBox> *bbox_pool_;
+    DetectionTracker tracker_;
+    bool tracking_ = false;
+
+    // results stamped with the pts of their source frames
+    std::shared_ptr<DetectionTimeline> timeline_;
+    bool pts_aligned_ = true;
+    GstClockTime max_lateness_ = GST_SECOND / 2;
+    GstClockTime displayed_pts_ = GST_CLOCK_TIME_NONE;
+    GstClockTime latest_result_pts_ = GST_CLOCK_TIME_NONE;
+    stats_tracker<double> staleness_stats_;
+    unsigned long num_stale_frames_ = 0;
 
 public:
     DetectionBoundingBoxOptions bbox_options;
@@ -21,10 +35,40 @@ public:
 
     [[nodiscard]] auto *bbox_pool() const noexcept;
 
+    [[nodiscard]] bool tracking() const noexcept;
+
+    /// Results shown on displayed frames, shared with the inference worker.
+    [[nodiscard]] std::shared_ptr<DetectionTimeline> timeline() const noexcept;
+
+    /// Shows the results of a previous run on the frames it processed.
+    bool load_detection_log(const std::string &filepath);
+
+    void set_tracking(bool tracking);
+
+    /// Mean lag between displayed frames and the frames their overlaid results come from, in nanoseconds.
+    [[nodiscard]] std::optional<double> mean_staleness() const noexcept;
+
+    /// Number of displayed frames without any result within max lateness.
+    [[nodiscard]] unsigned long num_stale_frames() const noexcept;
+
+private:
+    void refresh_overlay(GstClockTime pts);
+
+signals:
+    /// Emitted for every displayed frame, staleness is GST_CLOCK_TIME_NONE when no result is shown.
+    void overlay_staleness_changed(GstClockTime staleness);
+
 public slots:
     QSharedPointer<DetectionBoundingBox> add_bbox(const Detection &det);
 
     QList<QSharedPointer<DetectionBoundingBox>> add_bboxes(const std::vector<Detection> &dets);
 
-    QList<QSharedPointer<DetectionBoundingBox>> request_bboxes_from_pool(const std::vector<Detection> &dets);
+    /// result_pts, if valid, is the pts of the frame the detections were inferred on, for latency tracing.
+    QList<QSharedPointer<DetectionBoundingBox>> request_bboxes_from_pool(const std::vector<Detection> &dets,
+                                                                         GstClockTime result_pts = GST_CLOCK_TIME_NONE);
+
+    /// Displays new detection results of the frame at pts, through the tracker if tracking is enabled.
+    void on_new_detections(GstClockTime pts, const std::vector<Detection> &dets);
+
+    void reset_results();
 };
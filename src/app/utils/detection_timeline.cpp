@@ -0,0 +1,149 @@
+#include "detection_timeline.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    using Ranges = std::map<GstClockTime, GstClockTime>;
+
+    inline bool ranges_contain(const Ranges &ranges, GstClockTime pts) {
+        auto it = ranges.upper_bound(pts);
+        return it != ranges.begin() && pts <= std::prev(it)->second;
+    }
+}
+
+DetectionTimeline::DetectionTimeline(GstClockTime max_gap, std::size_t max_results)
+        : max_gap_(max_gap), max_results_(max_results) {}
+
+bool DetectionTimeline::load(const std::string &filepath) {
+    auto log = DetectionLog::open(filepath);
+    if (!log)
+        return false;
+    std::vector<std::pair<GstClockTime, std::uint64_t>> log_frames;
+    log_frames.reserve(log->num_frames());
+    for (std::uint64_t i = 0; i < log->num_frames(); i++) {
+        auto pts = log->pts(i);
+        if (GST_CLOCK_TIME_IS_VALID(pts))
+            log_frames.emplace_back(pts, i);
+    }
+    // seeks while logging leave pts out of order, the latest logged frame wins
+    if (!std::is_sorted(log_frames.begin(), log_frames.end()))
+        std::stable_sort(log_frames.begin(), log_frames.end(), [](const auto &a, const auto &b) {
+            return a.first < b.first;
+        });
+    Ranges log_ranges;
+    for (const auto &[pts, index]: log_frames)
+        add_to_ranges(log_ranges, pts);
+
+    QMutexLocker lock(&mutex_);
+    log_ = std::move(log);
+    log_frames_ = std::move(log_frames);
+    log_ranges_ = std::move(log_ranges);
+    return true;
+}
+
+void DetectionTimeline::unload() {
+    QMutexLocker lock(&mutex_);
+    log_.reset();
+    log_frames_.clear();
+    log_ranges_.clear();
+}
+
+std::shared_ptr<DetectionLog> DetectionTimeline::log() const {
+    QMutexLocker lock(&mutex_);
+    return log_;
+}
+
+void DetectionTimeline::add_to_ranges(Ranges &ranges, GstClockTime pts) const {
+    auto next = ranges.upper_bound(pts);
+    if (next != ranges.begin()) {
+        auto prev = std::prev(next);
+        if (pts <= prev->second + max_gap_) {
+            prev->second = std::max(prev->second, pts);
+            if (next != ranges.end() && next->first <= prev->second + max_gap_) {
+                prev->second = std::max(prev->second, next->second);
+                ranges.erase(next);
+            }
+            return;
+        }
+    }
+    if (next != ranges.end() && next->first <= pts + max_gap_) {
+        auto last = next->second;
+        ranges.erase(next);
+        ranges.emplace(pts, last);
+        return;
+    }
+    ranges.emplace(pts, pts);
+}
+
+void DetectionTimeline::evict_oldest_result() {
+    auto oldest = results_.begin();
+    auto pts = oldest->first;
+    results_.erase(oldest);
+    // the oldest result starts the first range, which now starts at the next result if any
+    auto range = ranges_.find(pts);
+    if (range == ranges_.end())
+        return;
+    auto last = range->second;
+    ranges_.erase(range);
+    if (!results_.empty() && results_.begin()->first <= last)
+        ranges_.emplace(results_.begin()->first, last);
+}
+
+void DetectionTimeline::insert(GstClockTime pts, const std::vector<Detection> &detections) {
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+    QMutexLocker lock(&mutex_);
+    results_[pts] = detections;
+    add_to_ranges(ranges_, pts);
+    while (max_results_ && results_.size() > max_results_)
+        evict_oldest_result();
+}
+
+bool DetectionTimeline::contains(GstClockTime pts) const {
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return false;
+    QMutexLocker lock(&mutex_);
+    return ranges_contain(ranges_, pts) || ranges_contain(log_ranges_, pts);
+}
+
+std::optional<DetectionTimeline::Record> DetectionTimeline::lookup(GstClockTime pts,
+                                                                   GstClockTime max_lateness) const {
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return {};
+    QMutexLocker lock(&mutex_);
+    auto result_it = results_.upper_bound(pts);
+    auto has_result = result_it != results_.begin();
+    auto result_pts = has_result ? std::prev(result_it)->first : 0;
+    auto log_it = std::upper_bound(log_frames_.begin(), log_frames_.end(), pts,
+                                   [](GstClockTime value, const auto &frame) { return value < frame.first; });
+    auto has_log_frame = log_it != log_frames_.begin();
+    auto log_pts = has_log_frame ? std::prev(log_it)->first : 0;
+    if (!has_result && !has_log_frame)
+        return {};
+
+    // live results of a frame override logged ones
+    auto from_log = has_log_frame && (!has_result || log_pts > result_pts);
+    auto record_pts = from_log ? log_pts : result_pts;
+    if (GST_CLOCK_TIME_IS_VALID(max_lateness) && pts - record_pts > max_lateness &&
+        !ranges_contain(from_log ? log_ranges_ : ranges_, pts))
+        return {};
+    if (from_log)
+        return Record{record_pts, log_->detections(std::prev(log_it)->second)};
+    return Record{record_pts, std::prev(result_it)->second};
+}
+
+void DetectionTimeline::clear() {
+    QMutexLocker lock(&mutex_);
+    results_.clear();
+    ranges_.clear();
+}
+
+std::size_t DetectionTimeline::size() const {
+    QMutexLocker lock(&mutex_);
+    return results_.size() + log_frames_.size();
+}
+
+bool DetectionTimeline::empty() const {
+    return size() == 0;
+}
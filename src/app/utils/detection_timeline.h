@@ -0,0 +1,75 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QMutex>
+
+#include <gst/gst.h>
+
+#include "dnn/detection_log.h"
+#include "dnn/return_types.h"
+
+/**
+ * Detection results indexed by the pts of their frames, for seeking to results without
+ * re-running the model. Results come from a DetectionLog of a previous run, mapped and
+ * only materialized when looked up, and from live inference.
+ * Frames no further than max_gap apart are merged into processed ranges, frames within
+ * them are given the results of the closest frame at or before them.
+ * Thread-safe.
+ */
+class DetectionTimeline {
+public:
+    struct Record {
+        GstClockTime pts;
+        std::vector<Detection> detections;
+    };
+
+private:
+    mutable QMutex mutex_;
+    GstClockTime max_gap_;
+    std::size_t max_results_;
+
+    std::shared_ptr<DetectionLog> log_;
+    // pts and log index of every logged frame, sorted by pts
+    std::vector<std::pair<GstClockTime, std::uint64_t>> log_frames_;
+    // first to last pts of processed ranges
+    std::map<GstClockTime, GstClockTime> log_ranges_;
+    std::map<GstClockTime, GstClockTime> ranges_;
+    std::map<GstClockTime, std::vector<Detection>> results_;
+
+    void add_to_ranges(std::map<GstClockTime, GstClockTime> &ranges, GstClockTime pts) const;
+
+    void evict_oldest_result();
+
+public:
+    /// max_results bounds the live results kept, those of the earliest pts are evicted first. 0 for no bound.
+    explicit DetectionTimeline(GstClockTime max_gap = GST_SECOND / 2, std::size_t max_results = 0);
+
+    /// Replaces the logged results by those of the detection log at filepath.
+    bool load(const std::string &filepath);
+
+    void unload();
+
+    [[nodiscard]] std::shared_ptr<DetectionLog> log() const;
+
+    void insert(GstClockTime pts, const std::vector<Detection> &detections);
+
+    /// Whether pts lies within a processed range, whose results are looked up instead of inferred.
+    [[nodiscard]] bool contains(GstClockTime pts) const;
+
+    /// Latest results at or before pts, either within a processed range or at most max_lateness before.
+    [[nodiscard]] std::optional<Record> lookup(GstClockTime pts,
+                                               GstClockTime max_lateness = GST_CLOCK_TIME_NONE) const;
+
+    /// Clears the live results, logged ones are kept.
+    void clear();
+
+    [[nodiscard]] std::size_t size() const;
+
+    [[nodiscard]] bool empty() const;
+};
@@ -110,4 +110,12 @@ public:
         }
         return {};
     }
+
+    inline std::optional<Record> earliest_record_after(const TimestampT &key) {
+        auto locker = this->locker();
+        auto it = this->upperBound(key);
+        if (it == this->end())
+            return {};
+        return Record{it.key(), it.value()};
+    }
 };
@@ -0,0 +1,471 @@
+#include "detection_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    static_assert(sizeof(DetectionLogHeader) == 40);
+    static_assert(sizeof(DetectionLogBlockHeader) <= DetectionLogBlockHeader::SIZE);
+    static_assert(sizeof(DetectionLogIndexEntry) == 40);
+    static_assert(sizeof(DetectionLogFooter) == 24);
+
+    constexpr std::uint64_t DATA_ALIGNMENT = 4096;
+    constexpr std::uint64_t COLUMN_ALIGNMENT = 64;
+
+    inline std::uint64_t align_up(std::uint64_t size, std::uint64_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    template<typename T>
+    inline T read_value(const std::uint8_t *data) {
+        T value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    template<typename T>
+    inline void write_value(std::uint8_t *data, T value) {
+        std::memcpy(data, &value, sizeof(value));
+    }
+
+    template<typename T>
+    inline T read_column(const std::uint8_t *block, std::uint64_t column, std::uint64_t index) {
+        return read_value<T>(block + column + index * sizeof(T));
+    }
+
+    template<typename T>
+    inline void write_column(std::uint8_t *block, std::uint64_t column, std::uint64_t index, T value) {
+        write_value<T>(block + column + index * sizeof(T), value);
+    }
+}
+
+// ---------------------
+// DetectionLogLayout
+// ---------------------
+DetectionLogLayout::DetectionLogLayout(std::uint32_t frames_per_block, std::uint32_t detections_per_block)
+        : frames_per_block(frames_per_block), detections_per_block(detections_per_block) {
+    auto offset = DetectionLogBlockHeader::SIZE;
+    auto column = [&offset](std::uint64_t count, std::uint64_t item_size) {
+        auto column_offset = offset;
+        offset = align_up(offset + count * item_size, COLUMN_ALIGNMENT);
+        return column_offset;
+    };
+    frame_ids = column(frames_per_block, sizeof(std::uint64_t));
+    pts = column(frames_per_block, sizeof(std::uint64_t));
+    first_detections = column(frames_per_block, sizeof(std::uint32_t));
+    num_detections = column(frames_per_block, sizeof(std::uint32_t));
+    class_ids = column(detections_per_block, sizeof(std::int32_t));
+    track_ids = column(detections_per_block, sizeof(std::int32_t));
+    scores = column(detections_per_block, sizeof(float));
+    x = column(detections_per_block, sizeof(float));
+    y = column(detections_per_block, sizeof(float));
+    width = column(detections_per_block, sizeof(float));
+    height = column(detections_per_block, sizeof(float));
+    block_size = align_up(offset, DATA_ALIGNMENT);
+}
+
+// ---------------------
+// DetectionLogWriter
+// ---------------------
+DetectionLogWriter::DetectionLogWriter(const std::string &filepath,
+                                       const std::vector<std::string> &class_names,
+                                       std::uint32_t frames_per_block,
+                                       std::uint32_t detections_per_block)
+        : file_(std::fopen(filepath.c_str(), "wb")),
+          layout_(std::max(frames_per_block, 1u), std::max(detections_per_block, 1u)) {
+    if (!file_) {
+        std::cerr << "failed to open detection log " << filepath << "\n";
+        return;
+    }
+    DetectionLogHeader header{};
+    std::memcpy(header.magic, DetectionLogHeader::MAGIC, sizeof(header.magic));
+    header.version = DetectionLogHeader::VERSION;
+    header.frames_per_block = layout_.frames_per_block;
+    header.detections_per_block = layout_.detections_per_block;
+    header.block_size = layout_.block_size;
+    header.num_classes = (std::uint32_t) class_names.size();
+
+    std::vector<std::uint8_t> prefix(sizeof(header));
+    for (const auto &name: class_names) {
+        auto offset = prefix.size();
+        prefix.resize(offset + sizeof(std::uint32_t) + name.size());
+        write_value<std::uint32_t>(prefix.data() + offset, (std::uint32_t) name.size());
+        std::memcpy(prefix.data() + offset + sizeof(std::uint32_t), name.data(), name.size());
+    }
+    header.data_offset = align_up(prefix.size(), DATA_ALIGNMENT);
+    std::memcpy(prefix.data(), &header, sizeof(header));
+    prefix.resize(header.data_offset, 0);
+    if (std::fwrite(prefix.data(), 1, prefix.size(), file_) != prefix.size()) {
+        std::cerr << "failed to write detection log " << filepath << "\n";
+        std::fclose(file_);
+        file_ = nullptr;
+        return;
+    }
+
+    block_.assign(layout_.block_size, 0);
+    thread_ = std::thread(&DetectionLogWriter::write_loop, this);
+}
+
+DetectionLogWriter::~DetectionLogWriter() {
+    close();
+}
+
+bool DetectionLogWriter::is_open() const noexcept {
+    return file_ != nullptr;
+}
+
+std::uint64_t DetectionLogWriter::num_frames() const noexcept {
+    return num_frames_;
+}
+
+void DetectionLogWriter::append(std::uint64_t frame_id, std::uint64_t pts,
+                                const std::vector<Detection> &detections) {
+    if (!file_)
+        return;
+    auto num_detections = (std::uint32_t) std::min<std::size_t>(detections.size(),
+                                                                layout_.detections_per_block);
+    // blocks stay sorted by pts for find(), going back starts a new one
+    if (block_header_.num_frames == layout_.frames_per_block ||
+        block_header_.num_detections + num_detections > layout_.detections_per_block ||
+        (block_header_.num_frames && pts < block_header_.last_pts))
+        seal_block();
+
+    auto frame = block_header_.num_frames;
+    if (frame == 0) {
+        block_header_.first_pts = pts;
+        block_header_.first_frame_id = frame_id;
+    }
+    block_header_.last_pts = pts;
+    auto *block = block_.data();
+    write_column<std::uint64_t>(block, layout_.frame_ids, frame, frame_id);
+    write_column<std::uint64_t>(block, layout_.pts, frame, pts);
+    write_column<std::uint32_t>(block, layout_.first_detections, frame, block_header_.num_detections);
+    write_column<std::uint32_t>(block, layout_.num_detections, frame, num_detections);
+    for (std::uint32_t i = 0; i < num_detections; i++) {
+        const auto &detection = detections[i];
+        auto d = block_header_.num_detections + i;
+        write_column<std::int32_t>(block, layout_.class_ids, d, detection.label_id);
+        write_column<std::int32_t>(block, layout_.track_ids, d, detection.track_id);
+        write_column<float>(block, layout_.scores, d, detection.confidence);
+        write_column<float>(block, layout_.x, d, (float) detection.bbox.x);
+        write_column<float>(block, layout_.y, d, (float) detection.bbox.y);
+        write_column<float>(block, layout_.width, d, (float) detection.bbox.width);
+        write_column<float>(block, layout_.height, d, (float) detection.bbox.height);
+    }
+    block_header_.num_frames++;
+    block_header_.num_detections += num_detections;
+    num_frames_++;
+}
+
+void DetectionLogWriter::seal_block() {
+    if (block_header_.num_frames == 0)
+        return;
+    std::memcpy(block_header_.magic, DetectionLogBlockHeader::MAGIC, sizeof(block_header_.magic));
+    std::memcpy(block_.data(), &block_header_, sizeof(block_header_));
+    index_.push_back({block_header_.first_pts, block_header_.last_pts, block_header_.first_frame_id,
+                      block_header_.num_frames, block_header_.num_detections, index_.size()});
+    block_header_ = {};
+
+    std::vector<std::uint8_t> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_blocks_.push_back(std::move(block_));
+        if (!free_blocks_.empty()) {
+            next = std::move(free_blocks_.back());
+            free_blocks_.pop_back();
+        }
+    }
+    cond_.notify_one();
+    // stale columns past the counts of the block header are never read
+    if (next.size() != layout_.block_size)
+        next.assign(layout_.block_size, 0);
+    block_ = std::move(next);
+}
+
+void DetectionLogWriter::write_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cond_.wait(lock, [this]() { return closing_ || !pending_blocks_.empty(); });
+        if (pending_blocks_.empty())
+            return;
+        auto block = std::move(pending_blocks_.front());
+        pending_blocks_.pop_front();
+        lock.unlock();
+        auto written = !failed_ && std::fwrite(block.data(), 1, block.size(), file_) == block.size();
+        lock.lock();
+        if (!written && !failed_) {
+            failed_ = true;
+            std::cerr << "failed to write detection log block\n";
+        }
+        free_blocks_.push_back(std::move(block));
+    }
+}
+
+void DetectionLogWriter::flush() {
+    if (!file_)
+        return;
+    seal_block();
+}
+
+void DetectionLogWriter::close() {
+    if (!file_)
+        return;
+    seal_block();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    cond_.notify_one();
+    if (thread_.joinable())
+        thread_.join();
+
+    if (!failed_) {
+        std::stable_sort(index_.begin(), index_.end(), [](const auto &a, const auto &b) {
+            return a.first_pts < b.first_pts;
+        });
+        DetectionLogFooter footer{};
+        footer.index_offset = (std::uint64_t) std::ftell(file_);
+        footer.num_blocks = index_.size();
+        std::memcpy(footer.magic, DetectionLogFooter::MAGIC, sizeof(footer.magic));
+        footer.version = DetectionLogHeader::VERSION;
+        auto index_size = index_.size() * sizeof(DetectionLogIndexEntry);
+        if ((index_size && std::fwrite(index_.data(), 1, index_size, file_) != index_size) ||
+            std::fwrite(&footer, 1, sizeof(footer), file_) != sizeof(footer))
+            std::cerr << "failed to write detection log index\n";
+    }
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+// ---------------------
+// DetectionLog
+// ---------------------
+std::shared_ptr<DetectionLog> DetectionLog::open(const std::string &filepath) {
+    std::shared_ptr<DetectionLog> log(new DetectionLog());
+    if (!log->open_file(filepath))
+        return nullptr;
+    return log;
+}
+
+bool DetectionLog::open_file(const std::string &filepath) {
+    auto fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "failed to open detection log " << filepath << "\n";
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (std::uint64_t) st.st_size < sizeof(DetectionLogHeader)) {
+        ::close(fd);
+        std::cerr << filepath << " is not a detection log\n";
+        return false;
+    }
+    auto file_size = (std::uint64_t) st.st_size;
+    auto *addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "failed to map detection log " << filepath << "\n";
+        return false;
+    }
+    // scrubbing jumps around the timeline
+    madvise(addr, file_size, MADV_RANDOM);
+    mapping_ = std::shared_ptr<const std::uint8_t>(
+            static_cast<const std::uint8_t *>(addr), [file_size](const std::uint8_t *data) {
+                munmap(const_cast<std::uint8_t *>(data), file_size);
+            });
+
+    DetectionLogHeader header{};
+    std::memcpy(&header, mapping_.get(), sizeof(header));
+    if (std::memcmp(header.magic, DetectionLogHeader::MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != DetectionLogHeader::VERSION ||
+        header.frames_per_block == 0 || header.detections_per_block == 0 ||
+        header.data_offset < sizeof(header) || header.data_offset > file_size) {
+        std::cerr << filepath << " is not a detection log of version " << DetectionLogHeader::VERSION << "\n";
+        return false;
+    }
+    layout_ = DetectionLogLayout(header.frames_per_block, header.detections_per_block);
+    if (layout_.block_size != header.block_size) {
+        std::cerr << "unexpected block size in detection log " << filepath << "\n";
+        return false;
+    }
+    data_offset_ = header.data_offset;
+
+    std::uint64_t offset = sizeof(header);
+    class_names_.reserve(header.num_classes);
+    for (std::uint32_t i = 0; i < header.num_classes; i++) {
+        if (offset + sizeof(std::uint32_t) > data_offset_)
+            break;
+        auto length = read_value<std::uint32_t>(mapping_.get() + offset);
+        offset += sizeof(std::uint32_t);
+        if (offset + length > data_offset_)
+            break;
+        class_names_.emplace_back(reinterpret_cast<const char *>(mapping_.get() + offset), length);
+        offset += length;
+    }
+
+    // index written on close, otherwise rebuilt from the block headers
+    DetectionLogFooter footer{};
+    if (file_size >= data_offset_ + sizeof(footer))
+        std::memcpy(&footer, mapping_.get() + file_size - sizeof(footer), sizeof(footer));
+    auto num_blocks = (file_size - data_offset_) / layout_.block_size;
+    if (std::memcmp(footer.magic, DetectionLogFooter::MAGIC, sizeof(footer.magic)) == 0 &&
+        footer.version == DetectionLogHeader::VERSION && footer.num_blocks <= num_blocks &&
+        footer.index_offset == data_offset_ + footer.num_blocks * layout_.block_size &&
+        footer.index_offset + footer.num_blocks * sizeof(DetectionLogIndexEntry) + sizeof(footer) == file_size) {
+        // the index is sorted by pts, blocks_ is in file order
+        blocks_.resize(footer.num_blocks);
+        std::vector<bool> seen(footer.num_blocks, false);
+        for (std::uint64_t i = 0; i < footer.num_blocks; i++) {
+            auto entry = read_value<DetectionLogIndexEntry>(
+                    mapping_.get() + footer.index_offset + i * sizeof(DetectionLogIndexEntry));
+            if (entry.block >= footer.num_blocks || seen[entry.block]) {
+                std::cerr << "corrupted index in detection log " << filepath << "\n";
+                return false;
+            }
+            seen[entry.block] = true;
+            blocks_[entry.block] = entry;
+        }
+    } else {
+        blocks_.reserve(num_blocks);
+        for (std::uint64_t i = 0; i < num_blocks; i++) {
+            DetectionLogBlockHeader block_header{};
+            std::memcpy(&block_header, block(i), sizeof(block_header));
+            if (std::memcmp(block_header.magic, DetectionLogBlockHeader::MAGIC, sizeof(block_header.magic)) != 0)
+                break;
+            blocks_.push_back({block_header.first_pts, block_header.last_pts, block_header.first_frame_id,
+                               block_header.num_frames, block_header.num_detections, i});
+        }
+    }
+
+    block_first_frames_.reserve(blocks_.size());
+    for (const auto &entry: blocks_) {
+        if (entry.num_frames > layout_.frames_per_block || entry.num_detections > layout_.detections_per_block) {
+            std::cerr << "corrupted block in detection log " << filepath << "\n";
+            return false;
+        }
+        block_first_frames_.push_back(num_frames_);
+        num_frames_ += entry.num_frames;
+    }
+
+    pts_order_.resize(blocks_.size());
+    for (std::size_t i = 0; i < pts_order_.size(); i++)
+        pts_order_[i] = i;
+    std::stable_sort(pts_order_.begin(), pts_order_.end(), [this](std::size_t a, std::size_t b) {
+        return blocks_[a].first_pts < blocks_[b].first_pts;
+    });
+    max_last_pts_.reserve(pts_order_.size());
+    std::uint64_t max_last_pts = 0;
+    for (auto block_index: pts_order_) {
+        // frames without pts are only ever at the end of a block
+        auto n = upper_bound(block_index, PTS_NONE - 1);
+        if (n)
+            max_last_pts = std::max(max_last_pts, read_column<std::uint64_t>(block(block_index), layout_.pts, n - 1));
+        max_last_pts_.push_back(max_last_pts);
+    }
+    return true;
+}
+
+const std::uint8_t *DetectionLog::block(std::size_t block_index) const {
+    return mapping_.get() + data_offset_ + block_index * layout_.block_size;
+}
+
+std::pair<std::size_t, std::uint32_t> DetectionLog::locate(std::uint64_t index) const {
+    if (index >= num_frames_)
+        throw std::out_of_range("detection log frame index out of range");
+    auto it = std::upper_bound(block_first_frames_.begin(), block_first_frames_.end(), index);
+    auto block_index = (std::size_t) (it - block_first_frames_.begin()) - 1;
+    return {block_index, (std::uint32_t) (index - block_first_frames_[block_index])};
+}
+
+std::uint32_t DetectionLog::upper_bound(std::size_t block_index, std::uint64_t pts) const {
+    const auto *data = block(block_index);
+    std::uint32_t lo = 0, hi = blocks_[block_index].num_frames;
+    while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        if (read_column<std::uint64_t>(data, layout_.pts, mid) <= pts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+std::uint64_t DetectionLog::num_frames() const noexcept {
+    return num_frames_;
+}
+
+bool DetectionLog::empty() const noexcept {
+    return num_frames_ == 0;
+}
+
+const std::vector<std::string> &DetectionLog::class_names() const noexcept {
+    return class_names_;
+}
+
+std::uint64_t DetectionLog::frame_id(std::uint64_t index) const {
+    auto [block_index, frame] = locate(index);
+    return read_column<std::uint64_t>(block(block_index), layout_.frame_ids, frame);
+}
+
+std::uint64_t DetectionLog::pts(std::uint64_t index) const {
+    auto [block_index, frame] = locate(index);
+    return read_column<std::uint64_t>(block(block_index), layout_.pts, frame);
+}
+
+std::vector<Detection> DetectionLog::detections(std::uint64_t index) const {
+    auto [block_index, frame] = locate(index);
+    const auto *data = block(block_index);
+    auto first = read_column<std::uint32_t>(data, layout_.first_detections, frame);
+    auto count = read_column<std::uint32_t>(data, layout_.num_detections, frame);
+    count = std::min(count, blocks_[block_index].num_detections - std::min(first, blocks_[block_index].num_detections));
+
+    std::vector<Detection> detections(count);
+    for (std::uint32_t i = 0; i < count; i++) {
+        auto d = first + i;
+        auto &detection = detections[i];
+        detection.label_id = read_column<std::int32_t>(data, layout_.class_ids, d);
+        if (detection.label_id >= 0 && (std::size_t) detection.label_id < class_names_.size())
+            detection.label = class_names_[detection.label_id];
+        detection.track_id = read_column<std::int32_t>(data, layout_.track_ids, d);
+        detection.confidence = read_column<float>(data, layout_.scores, d);
+        detection.bbox = {read_column<float>(data, layout_.x, d),
+                          read_column<float>(data, layout_.y, d),
+                          read_column<float>(data, layout_.width, d),
+                          read_column<float>(data, layout_.height, d)};
+    }
+    return detections;
+}
+
+std::int64_t DetectionLog::find(std::uint64_t pts) const {
+    // blocks starting at or before pts, latest starting first, until none of the earlier
+    // ones can hold a greater pts, which is right away unless seeks made blocks overlap
+    auto k = (std::size_t) (std::upper_bound(pts_order_.begin(), pts_order_.end(), pts,
+                                             [this](std::uint64_t value, std::size_t block_index) {
+                                                 return value < blocks_[block_index].first_pts;
+                                             }) - pts_order_.begin());
+    std::int64_t best = -1;
+    std::uint64_t best_pts = 0;
+    std::size_t best_block = 0;
+    while (k > 0) {
+        k--;
+        if (best >= 0 && max_last_pts_[k] < best_pts)
+            break;
+        auto block_index = pts_order_[k];
+        auto n = upper_bound(block_index, pts);
+        if (!n)
+            continue;
+        auto frame_pts = read_column<std::uint64_t>(block(block_index), layout_.pts, n - 1);
+        if (best < 0 || frame_pts > best_pts || (frame_pts == best_pts && block_index > best_block)) {
+            best = (std::int64_t) (block_first_frames_[block_index] + n - 1);
+            best_pts = frame_pts;
+            best_block = block_index;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "return_types.h"
+
+/**
+ * Binary append-only detection log, columnar and memory mappable. Fields are in host byte order:
+ *   header   DetectionLogHeader, then the class names (u32 length and bytes each),
+ *            zero padded up to data_offset (a multiple of 4096)
+ *   blocks   block_size bytes each: a DetectionLogBlockHeader, then the columns of up to
+ *            frames_per_block frames and detections_per_block detections (see DetectionLogLayout)
+ *   index    one DetectionLogIndexEntry per block sorted by first_pts, then a DetectionLogFooter
+ * A log whose writer did not close it has no index, readers rebuild it by scanning the blocks.
+ * Pts are non-decreasing within a block, a pts going back (e.g. after a seek) starts a new one,
+ * so blocks may overlap. Among frames of equal pts, the one logged last wins.
+ */
+struct DetectionLogHeader {
+    static constexpr char MAGIC[4] = {'L', 'T', 'D', 'L'};
+    static constexpr std::uint32_t VERSION = 2;
+
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t frames_per_block;
+    std::uint32_t detections_per_block;
+    std::uint64_t block_size;
+    std::uint64_t data_offset;
+    std::uint32_t num_classes;
+    std::uint32_t reserved;
+};
+
+struct DetectionLogBlockHeader {
+    static constexpr char MAGIC[4] = {'L', 'T', 'D', 'B'};
+    static constexpr std::uint64_t SIZE = 64;
+
+    char magic[4];
+    std::uint32_t num_frames;
+    std::uint32_t num_detections;
+    std::uint32_t reserved;
+    std::uint64_t first_pts;
+    std::uint64_t last_pts;
+    std::uint64_t first_frame_id;
+};
+
+struct DetectionLogIndexEntry {
+    std::uint64_t first_pts;
+    std::uint64_t last_pts;
+    std::uint64_t first_frame_id;
+    std::uint32_t num_frames;
+    std::uint32_t num_detections;
+    /// Position of the block in the file.
+    std::uint64_t block;
+};
+
+struct DetectionLogFooter {
+    static constexpr char MAGIC[4] = {'L', 'T', 'D', 'X'};
+
+    std::uint64_t index_offset;
+    std::uint64_t num_blocks;
+    char magic[4];
+    std::uint32_t version;
+};
+
+/// Byte offsets of the columns inside a block.
+struct DetectionLogLayout {
+    std::uint32_t frames_per_block = 0;
+    std::uint32_t detections_per_block = 0;
+    // frame columns
+    std::uint64_t frame_ids = 0;          // u64
+    std::uint64_t pts = 0;                // u64
+    std::uint64_t first_detections = 0;   // u32, index of the frame's first detection in the block
+    std::uint64_t num_detections = 0;     // u32
+    // detection columns
+    std::uint64_t class_ids = 0;          // i32
+    std::uint64_t track_ids = 0;          // i32
+    std::uint64_t scores = 0;             // f32
+    std::uint64_t x = 0;                  // f32, box columns
+    std::uint64_t y = 0;
+    std::uint64_t width = 0;
+    std::uint64_t height = 0;
+    std::uint64_t block_size = 0;
+
+    DetectionLogLayout() = default;
+
+    DetectionLogLayout(std::uint32_t frames_per_block, std::uint32_t detections_per_block);
+};
+
+/**
+ * Appends detections of consecutive frames to a detection log.
+ * append() only copies the detections into the columns of the current block, which
+ * is written by a background thread once full, so it can be called from the inference loop.
+ * Not meant to be appended to from several threads at once.
+ */
+class DetectionLogWriter {
+    std::FILE *file_ = nullptr;
+    DetectionLogLayout layout_;
+    std::vector<std::uint8_t> block_;
+    DetectionLogBlockHeader block_header_{};
+    std::vector<DetectionLogIndexEntry> index_;
+    std::uint64_t num_frames_ = 0;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::vector<std::uint8_t>> pending_blocks_;
+    std::vector<std::vector<std::uint8_t>> free_blocks_;
+    bool closing_ = false;
+    bool failed_ = false;
+
+    void seal_block();
+
+    void write_loop();
+
+public:
+    static constexpr std::uint64_t PTS_NONE = std::numeric_limits<std::uint64_t>::max();
+
+    explicit DetectionLogWriter(const std::string &filepath,
+                                const std::vector<std::string> &class_names = {},
+                                std::uint32_t frames_per_block = 256,
+                                std::uint32_t detections_per_block = 4096);
+
+    DetectionLogWriter(const DetectionLogWriter &) = delete;
+
+    DetectionLogWriter &operator=(const DetectionLogWriter &) = delete;
+
+    ~DetectionLogWriter();
+
+    [[nodiscard]] bool is_open() const noexcept;
+
+    [[nodiscard]] std::uint64_t num_frames() const noexcept;
+
+    /// Detections beyond detections_per_block in a single frame are dropped.
+    /// A pts before the previous one seals the current block.
+    void append(std::uint64_t frame_id, std::uint64_t pts, const std::vector<Detection> &detections);
+
+    /// Hands the current, partially filled block to the writer thread.
+    void flush();
+
+    /// Writes the pending blocks, the index and the footer.
+    void close();
+};
+
+/**
+ * Read-only, memory mapped detection log.
+ * Frames are addressed by their position in the log, detections are only
+ * materialized for the frames asked for.
+ */
+class DetectionLog {
+    std::shared_ptr<const std::uint8_t> mapping_;
+    std::uint64_t data_offset_ = 0;
+    DetectionLogLayout layout_;
+    std::vector<std::string> class_names_;
+    // in file order
+    std::vector<DetectionLogIndexEntry> blocks_;
+    // position in the log of the first frame of every block
+    std::vector<std::uint64_t> block_first_frames_;
+    // blocks sorted by first_pts, and the running maximum of their last valid pts in that order
+    std::vector<std::size_t> pts_order_;
+    std::vector<std::uint64_t> max_last_pts_;
+    std::uint64_t num_frames_ = 0;
+
+    DetectionLog() = default;
+
+    bool open_file(const std::string &filepath);
+
+    [[nodiscard]] const std::uint8_t *block(std::size_t block_index) const;
+
+    [[nodiscard]] std::pair<std::size_t, std::uint32_t> locate(std::uint64_t index) const;
+
+    /// Number of frames of the block whose pts is not after pts.
+    [[nodiscard]] std::uint32_t upper_bound(std::size_t block_index, std::uint64_t pts) const;
+
+public:
+    static constexpr std::uint64_t PTS_NONE = DetectionLogWriter::PTS_NONE;
+
+    /// Returns nullptr if filepath is not a detection log.
+    static std::shared_ptr<DetectionLog> open(const std::string &filepath);
+
+    [[nodiscard]] std::uint64_t num_frames() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    [[nodiscard]] const std::vector<std::string> &class_names() const noexcept;
+
+    [[nodiscard]] std::uint64_t frame_id(std::uint64_t index) const;
+
+    [[nodiscard]] std::uint64_t pts(std::uint64_t index) const;
+
+    /// Detections of the frame at index, labels are filled from the class names.
+    [[nodiscard]] std::vector<Detection> detections(std::uint64_t index) const;
+
+    /// Index of the frame of the greatest pts not after pts, the last logged one among equals,
+    /// -1 if there is none.
+    [[nodiscard]] std::int64_t find(std::uint64_t pts) const;
+};
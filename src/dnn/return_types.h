@@ -23,6 +23,7 @@ struct Detection {
     std::string label;
     float confidence = 0.;
     cv::Rect2d bbox{};
+    int track_id = -1;
 };
 
 Q_DECLARE_METATYPE(Detection)
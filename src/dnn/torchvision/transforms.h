@@ -193,7 +193,6 @@ namespace torchvision {
                     InterpolationMethods interpolation = INTERPOLATION_LINEAR,
                     bool antialias = false,
                     bool align_corners = false) {
-                src.unsqueeze_(0);
                 switch (interpolation) {
                     case INTERPOLATION_NEAREST:
                         return at::upsample_nearest2d(src.unsqueeze(0), {size.height, size.width}).squeeze(0);
@@ -216,6 +215,7 @@ namespace torchvision {
                     default:
                         break;
                 }
+                TORCH_CHECK_VALUE(false, "Unsupported interpolation method ", interpolation)
             }
 
             template<int64_t width, int64_t height,
@@ -141,19 +141,35 @@ namespace ultralytics {
             return keep_t.narrow(0, 0, num_to_keep);
         }
 
-        at::Tensor non_max_suppression(
+        // Reference: https://github.com/pytorch/vision/blob/main/torchvision/ops/boxes.py
+        at::Tensor batched_nms(
+                const at::Tensor &bboxes,
+                const at::Tensor &scores,
+                const at::Tensor &idxs,
+                double iou_threshold) {
+            if (bboxes.numel() == 0)
+                return at::empty({0}, bboxes.options().dtype(at::kLong));
+            // offset boxes of each class so that they do not overlap
+            auto max_coordinate = bboxes.max();
+            auto offsets = idxs.to(bboxes.scalar_type()) * (max_coordinate + 1);
+            auto bboxes_for_nms = bboxes + offsets.unsqueeze(1);
+            return nms(bboxes_for_nms, scores, iou_threshold);
+        }
+
+        std::vector<at::Tensor> non_max_suppression(
                 const at::Tensor &prediction,
                 double conf_threshold,
                 double iou_threshold,
-                int64_t max_det) {
+                int64_t max_det,
+                std::work_stealing_thread_pool *pool) {
             auto bs = prediction.size(0);
             auto nc = prediction.size(1) - 4;
             auto nm = prediction.size(1) - nc - 4;
             auto mi = 4 + nc;
             auto xc = prediction.index({at::indexing::Slice(), at::indexing::Slice(4, mi)}).amax(1) > conf_threshold;
 
+            // boxes are converted on the candidates only, prediction is left untouched
             auto output = prediction.transpose(-1, -2);
-            xywh2xyxy_(output);
 
             std::vector<at::Tensor> outputs;
             outputs.reserve(bs);
@@ -161,16 +177,17 @@ namespace ultralytics {
                 outputs.push_back(at::zeros({0, 6 + nm}, output.options()));
             }
 
-            for (int xi = 0; xi < output.size(0); xi++) {
-                auto x = output[xi];
+            std::parallel_for(pool, 0, output.size(0), [&](std::size_t xi) {
+                auto x = output[static_cast<int64_t>(xi)];
                 x = x.index({xc[xi]});
+                xywh2xyxy_(x);
                 auto x_split = x.split({4, nc, nm}, 1);
                 auto box = x_split[0], cls = x_split[1], mask = x_split[2];
                 auto [conf, j] = cls.max(1, true);
                 x = at::cat({box, conf, j.toType(prediction.scalar_type()), mask}, 1);
                 x = x.index({conf.view(-1) > conf_threshold});
                 int n = x.size(0);
-                if (!n) { continue; }
+                if (!n) { return; }
 
                 // NMS
                 auto c = x.index({at::indexing::Slice(), at::indexing::Slice{5, 6}}) * 7680;
@@ -179,8 +196,8 @@ namespace ultralytics {
                 auto i = nms(boxes, scores, iou_threshold);
                 i = i.index({at::indexing::Slice(at::indexing::None, max_det)});
                 outputs[xi] = x.index({i});
-            }
-            return at::stack(outputs);
+            });
+            return outputs;
         }
     }
 }
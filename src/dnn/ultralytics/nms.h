@@ -4,6 +4,10 @@
 #include <ATen/ATen.h>
 #define slots Q_SLOTS
 
+#include <vector>
+
+#include "std/threading/work_stealing_thread_pool.h"
+
 namespace ultralytics {
     namespace ops {
         at::Tensor nms(
@@ -11,10 +15,21 @@ namespace ultralytics {
                 const at::Tensor &scores,
                 double iou_threshold);
 
-        at::Tensor non_max_suppression(
+        /// Class-aware NMS, boxes of different idxs never suppress each other.
+        at::Tensor batched_nms(
+                const at::Tensor &bboxes,
+                const at::Tensor &scores,
+                const at::Tensor &idxs,
+                double iou_threshold);
+
+        /// Returns one (n, 6 + nm) tensor of [x1, y1, x2, y2, conf, cls, mask...]
+        /// per image of the batch. Images are processed in parallel on pool if given.
+        /// prediction is not modified, so it can be post-processed again with other thresholds.
+        std::vector<at::Tensor> non_max_suppression(
                 const at::Tensor &prediction,
                 double conf_threshold = 0.25,
                 double iou_threshold = 0.45,
-                int64_t max_det = 100);
+                int64_t max_det = 100,
+                std::work_stealing_thread_pool *pool = nullptr);
     }
 }
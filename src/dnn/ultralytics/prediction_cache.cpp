@@ -0,0 +1,371 @@
+#include "prediction_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "std/hash.h"
+
+namespace ultralytics {
+    namespace {
+        constexpr char ENTRY_MAGIC[4] = {'L', 'T', 'P', 'C'};
+        constexpr std::uint32_t ENTRY_VERSION = 1;
+        // files up to this size are hashed entirely, larger ones by chunks of it
+        constexpr std::size_t HASH_CHUNK_SIZE = 4 << 20;
+
+        struct ByteWriter {
+            std::vector<char> bytes;
+
+            template<typename T>
+            inline void put(const T &value) {
+                put_bytes(&value, sizeof(value));
+            }
+
+            inline void put_bytes(const void *data, std::size_t size) {
+                const auto *begin = static_cast<const char *>(data);
+                bytes.insert(bytes.end(), begin, begin + size);
+            }
+        };
+
+        struct ByteReader {
+            const std::vector<char> &bytes;
+            std::size_t offset = 0;
+
+            template<typename T>
+            inline bool get(T &value) {
+                return get_bytes(&value, sizeof(value));
+            }
+
+            inline bool get_bytes(void *data, std::size_t size) {
+                if (offset + size > bytes.size())
+                    return false;
+                std::memcpy(data, bytes.data() + offset, size);
+                offset += size;
+                return true;
+            }
+        };
+
+        inline void put_key(ByteWriter &writer, const YoloPredictionKey &key) {
+            writer.put(key.source_hash);
+            writer.put(key.pts);
+            writer.put(key.model_hash);
+            writer.put(static_cast<std::int32_t>(key.input_shape.width));
+            writer.put(static_cast<std::int32_t>(key.input_shape.height));
+            writer.put(static_cast<std::int32_t>(key.dtype));
+            writer.put(key.preprocess_hash);
+        }
+
+        inline bool get_key(ByteReader &reader, YoloPredictionKey &key) {
+            std::int32_t width, height, dtype;
+            if (!reader.get(key.source_hash) || !reader.get(key.pts) || !reader.get(key.model_hash) ||
+                !reader.get(width) || !reader.get(height) || !reader.get(dtype) || !reader.get(key.preprocess_hash))
+                return false;
+            key.input_shape = {width, height};
+            key.dtype = static_cast<at::ScalarType>(dtype);
+            return true;
+        }
+
+        inline void put_size(ByteWriter &writer, const cv::Size &size) {
+            writer.put(static_cast<std::int32_t>(size.width));
+            writer.put(static_cast<std::int32_t>(size.height));
+        }
+
+        inline bool get_size(ByteReader &reader, cv::Size &size) {
+            std::int32_t width, height;
+            if (!reader.get(width) || !reader.get(height))
+                return false;
+            size = {width, height};
+            return true;
+        }
+
+        /// Drops the anchors no threshold above min_score keeps, NMS of the rest gives the same detections.
+        inline at::Tensor compact(const at::Tensor &prediction, float min_score) {
+            auto scores = prediction.index({at::indexing::Slice(), at::indexing::Slice(4, at::indexing::None)});
+            auto keep = (scores.amax(1) > min_score).any(0).nonzero().view(-1);
+            return prediction.index_select(2, keep).contiguous();
+        }
+
+        /// Stores queued past it are dropped oldest first, they are only recomputed by a later run.
+        constexpr std::size_t MAX_PENDING_STORES = 256;
+    }
+
+    // ---------------------
+    // YoloPredictionKey
+    // ---------------------
+    std::uint64_t YoloPredictionKey::digest() const {
+        ByteWriter writer;
+        put_key(writer, *this);
+        return std::fnv1a_64(writer.bytes.data(), writer.bytes.size());
+    }
+
+    bool YoloPredictionKey::operator==(const YoloPredictionKey &other) const {
+        return source_hash == other.source_hash && pts == other.pts && model_hash == other.model_hash &&
+               input_shape == other.input_shape && dtype == other.dtype && preprocess_hash == other.preprocess_hash;
+    }
+
+    // ---------------------
+    // YoloPredictionCache
+    // ---------------------
+    YoloPredictionCache::YoloPredictionCache(YoloPredictionCacheOptions options)
+            : options_(std::move(options)) {
+        if (!options_.directory().empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(options_.directory(), ec);
+            store_thread_ = std::thread(&YoloPredictionCache::store_loop, this);
+        }
+    }
+
+    YoloPredictionCache::~YoloPredictionCache() {
+        {
+            std::lock_guard<std::mutex> lock(store_mutex_);
+            closing_ = true;
+        }
+        store_cond_.notify_one();
+        if (store_thread_.joinable())
+            store_thread_.join();
+    }
+
+    YoloPredictionCacheOptions YoloPredictionCache::options() const noexcept {
+        return options_;
+    }
+
+    std::optional<YoloPrediction> YoloPredictionCache::find(const YoloPredictionKey &key) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(key.digest());
+            if (it != index_.end() && it->second->key == key) {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                num_hits_++;
+                return it->second->prediction;
+            }
+        }
+        auto prediction = load(key);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!prediction.has_value()) {
+            num_misses_++;
+            return {};
+        }
+        num_hits_++;
+        insert_in_memory(key, *prediction);
+        return prediction;
+    }
+
+    void YoloPredictionCache::insert(const YoloPredictionKey &key, const YoloPrediction &prediction) {
+        if (prediction.version != Yolov8)
+            return;
+        auto compacted = prediction;
+        if (!compacted.empty())
+            compacted.prediction = compact(prediction.prediction, options_.min_score());
+        if (store_thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(store_mutex_);
+                if (pending_stores_.size() >= MAX_PENDING_STORES)
+                    pending_stores_.pop_front();
+                pending_stores_.emplace_back(key, compacted);
+            }
+            store_cond_.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        insert_in_memory(key, std::move(compacted));
+    }
+
+    void YoloPredictionCache::store_loop() {
+        std::unique_lock<std::mutex> lock(store_mutex_);
+        while (true) {
+            store_cond_.wait(lock, [this]() { return closing_ || !pending_stores_.empty(); });
+            if (pending_stores_.empty())
+                return;
+            auto [key, prediction] = std::move(pending_stores_.front());
+            pending_stores_.pop_front();
+            lock.unlock();
+            store(key, prediction);
+            lock.lock();
+        }
+    }
+
+    void YoloPredictionCache::insert_in_memory(const YoloPredictionKey &key, YoloPrediction prediction) {
+        auto digest = key.digest();
+        if (auto it = index_.find(digest); it != index_.end()) {
+            memory_ -= it->second->size;
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+        auto size = sizeof(Entry) + (prediction.empty() ? 0 : prediction.prediction.nbytes());
+        if (size > options_.max_memory())
+            return;
+        entries_.push_front({key, std::move(prediction), size});
+        index_[digest] = entries_.begin();
+        memory_ += size;
+        while (memory_ > options_.max_memory()) {
+            auto &oldest = entries_.back();
+            memory_ -= oldest.size;
+            index_.erase(oldest.key.digest());
+            entries_.pop_back();
+        }
+    }
+
+    std::string YoloPredictionCache::entry_filepath(const YoloPredictionKey &key) const {
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << key.digest();
+        auto filename = name.str();
+        // spread entries over subdirectories, files of a long recording are many
+        return (std::filesystem::path(options_.directory()) / filename.substr(0, 2) / (filename + ".ltpc")).string();
+    }
+
+    std::optional<YoloPrediction> YoloPredictionCache::load(const YoloPredictionKey &key) const {
+        if (options_.directory().empty())
+            return {};
+        std::ifstream file(entry_filepath(key), std::ios::binary);
+        if (!file)
+            return {};
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        ByteReader reader{bytes};
+
+        char magic[4];
+        std::uint32_t version, yolo_version, num_tiles;
+        YoloPredictionKey stored_key;
+        YoloPrediction prediction;
+        if (!reader.get_bytes(magic, sizeof(magic)) || std::memcmp(magic, ENTRY_MAGIC, sizeof(magic)) != 0 ||
+            !reader.get(version) || version != ENTRY_VERSION ||
+            !get_key(reader, stored_key) || !(stored_key == key) ||
+            !reader.get(yolo_version) || !get_size(reader, prediction.input_size) ||
+            !get_size(reader, prediction.inference_shape) || !reader.get(num_tiles))
+            return {};
+        prediction.version = static_cast<YoloVersion>(yolo_version);
+        prediction.tiles.resize(num_tiles);
+        for (auto &tile: prediction.tiles) {
+            std::int32_t rect[4];
+            if (!reader.get_bytes(rect, sizeof(rect)))
+                return {};
+            tile = {rect[0], rect[1], rect[2], rect[3]};
+        }
+
+        std::int32_t scalar_type;
+        std::uint32_t ndim;
+        if (!reader.get(scalar_type) || !reader.get(ndim))
+            return {};
+        if (ndim == 0)
+            return prediction;
+        std::vector<int64_t> sizes(ndim);
+        if (!reader.get_bytes(sizes.data(), ndim * sizeof(int64_t)))
+            return {};
+        auto tensor = at::empty(sizes, at::TensorOptions(static_cast<at::ScalarType>(scalar_type)));
+        if (!reader.get_bytes(tensor.data_ptr(), tensor.nbytes()))
+            return {};
+        prediction.prediction = tensor;
+        return prediction;
+    }
+
+    void YoloPredictionCache::store(const YoloPredictionKey &key, const YoloPrediction &prediction) const {
+        if (options_.directory().empty())
+            return;
+        ByteWriter writer;
+        writer.put_bytes(ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+        writer.put(ENTRY_VERSION);
+        put_key(writer, key);
+        writer.put(static_cast<std::uint32_t>(prediction.version));
+        put_size(writer, prediction.input_size);
+        put_size(writer, prediction.inference_shape);
+        writer.put(static_cast<std::uint32_t>(prediction.tiles.size()));
+        for (const auto &tile: prediction.tiles) {
+            std::int32_t rect[4] = {tile.x, tile.y, tile.width, tile.height};
+            writer.put_bytes(rect, sizeof(rect));
+        }
+        if (prediction.empty()) {
+            writer.put(static_cast<std::int32_t>(at::kFloat));
+            writer.put(static_cast<std::uint32_t>(0));
+        } else {
+            auto tensor = prediction.prediction.to(at::kCPU).contiguous();
+            writer.put(static_cast<std::int32_t>(tensor.scalar_type()));
+            writer.put(static_cast<std::uint32_t>(tensor.dim()));
+            writer.put_bytes(tensor.sizes().data(), tensor.dim() * sizeof(int64_t));
+            writer.put_bytes(tensor.data_ptr(), tensor.nbytes());
+        }
+
+        // written aside and renamed, so that concurrent runs never read a partial entry
+        std::filesystem::path filepath = entry_filepath(key);
+        std::error_code ec;
+        std::filesystem::create_directories(filepath.parent_path(), ec);
+        auto tmp_filepath = filepath;
+        tmp_filepath += ".tmp";
+        {
+            std::ofstream file(tmp_filepath, std::ios::binary | std::ios::trunc);
+            if (!file.write(writer.bytes.data(), static_cast<std::streamsize>(writer.bytes.size())))
+                return;
+        }
+        std::filesystem::rename(tmp_filepath, filepath, ec);
+    }
+
+    void YoloPredictionCache::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        index_.clear();
+        memory_ = 0;
+    }
+
+    std::uint64_t YoloPredictionCache::num_hits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_hits_;
+    }
+
+    std::uint64_t YoloPredictionCache::num_misses() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_misses_;
+    }
+
+    std::size_t YoloPredictionCache::memory() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return memory_;
+    }
+
+    std::uint64_t YoloPredictionCache::hash_file(const std::string &filepath, bool sampled) {
+        std::ifstream file(filepath, std::ios::binary);
+        if (!file)
+            return 0;
+        file.seekg(0, std::ios::end);
+        auto size = static_cast<std::uint64_t>(file.tellg());
+        auto hash = std::fnv1a_64(&size, sizeof(size));
+
+        std::vector<char> chunk(HASH_CHUNK_SIZE);
+        auto hash_range = [&](std::uint64_t offset, std::uint64_t length) {
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(offset));
+            while (length && file) {
+                auto n = std::min<std::uint64_t>(length, chunk.size());
+                file.read(chunk.data(), static_cast<std::streamsize>(n));
+                hash = std::fnv1a_64(chunk.data(), static_cast<std::size_t>(file.gcount()), hash);
+                length -= n;
+            }
+        };
+        if (!sampled || size <= 3 * HASH_CHUNK_SIZE) {
+            hash_range(0, size);
+        } else {
+            hash_range(0, HASH_CHUNK_SIZE);
+            hash_range(size / 2 - HASH_CHUNK_SIZE / 2, HASH_CHUNK_SIZE);
+            hash_range(size - HASH_CHUNK_SIZE, HASH_CHUNK_SIZE);
+        }
+        return hash;
+    }
+
+    std::uint64_t YoloPredictionCache::hash_preprocess(const YoloOptions &options, const cv::Mat &roi_mask) {
+        ByteWriter writer;
+        writer.put(options.align_center());
+        writer.put(options.rect());
+        writer.put(static_cast<std::int32_t>(options.stride()));
+        put_size(writer, options.tile_shape());
+        writer.put(options.tile_overlap());
+        writer.put(options.tile_full_frame());
+        auto hash = std::fnv1a_64(writer.bytes.data(), writer.bytes.size());
+        if (!roi_mask.empty()) {
+            auto mask = roi_mask.isContinuous() ? roi_mask : roi_mask.clone();
+            std::int32_t mask_size[2] = {mask.cols, mask.rows};
+            hash = std::fnv1a_64(mask_size, sizeof(mask_size), hash);
+            hash = std::fnv1a_64(mask.data, mask.total() * mask.elemSize(), hash);
+        }
+        return hash;
+    }
+}  // namespace ultralytics
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "yolo.h"
+
+namespace ultralytics {
+    /// What the raw prediction of a frame depends on.
+    struct YoloPredictionKey {
+        /// See YoloPredictionCache::hash_file().
+        std::uint64_t source_hash = 0;
+        std::uint64_t pts = 0;
+        std::uint64_t model_hash = 0;
+        cv::Size input_shape;
+        at::ScalarType dtype = at::kFloat;
+        /// Remaining pre-processing options and region-of-interest mask, see YoloPredictionCache::hash_preprocess().
+        std::uint64_t preprocess_hash = 0;
+
+        [[nodiscard]] std::uint64_t digest() const;
+
+        [[nodiscard]] bool operator==(const YoloPredictionKey &other) const;
+    };
+
+    class YoloPredictionCacheOptions {
+    public:
+        YoloPredictionCacheOptions()
+                : max_memory_(256ull << 20),
+                  directory_(),
+                  min_score_(0.01) {}
+
+        // setters
+        [[nodiscard]] inline YoloPredictionCacheOptions max_memory(std::size_t max_memory) const noexcept {
+            auto r = *this;
+            r.max_memory_ = max_memory;
+            return r;
+        }
+
+        [[nodiscard]] inline YoloPredictionCacheOptions directory(const std::string &directory) const noexcept {
+            auto r = *this;
+            r.directory_ = directory;
+            return r;
+        }
+
+        [[nodiscard]] inline YoloPredictionCacheOptions min_score(float min_score) const noexcept {
+            auto r = *this;
+            r.min_score_ = min_score;
+            return r;
+        }
+
+        // getters
+        /// Bytes of predictions kept in memory, least recently used ones are evicted first.
+        [[nodiscard]] inline std::size_t max_memory() const noexcept {
+            return max_memory_;
+        }
+
+        /// Predictions are also stored in this directory to be reused by later runs, empty to only keep them in memory.
+        [[nodiscard]] inline std::string directory() const noexcept {
+            return directory_;
+        }
+
+        /// Anchors whose best class score is not above min_score are not stored,
+        /// score thresholds below it give fewer detections than the network.
+        [[nodiscard]] inline float min_score() const noexcept {
+            return min_score_;
+        }
+
+    private:
+        std::size_t max_memory_;
+        std::string directory_;
+        float min_score_;
+    };
+
+    /**
+     * Raw pre-NMS predictions of frames of previously inferred files, so that replaying
+     * them, even with other thresholds, does not run the network again.
+     * Stored predictions are written by a background thread, insert() does no disk I/O.
+     * Thread-safe.
+     */
+    class YoloPredictionCache {
+        struct Entry {
+            YoloPredictionKey key;
+            YoloPrediction prediction;
+            std::size_t size;
+        };
+
+        YoloPredictionCacheOptions options_;
+        std::mutex mutex_;
+        // most recently used first
+        std::list<Entry> entries_;
+        std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index_;
+        std::size_t memory_ = 0;
+        std::uint64_t num_hits_ = 0;
+        std::uint64_t num_misses_ = 0;
+
+        std::thread store_thread_;
+        std::mutex store_mutex_;
+        std::condition_variable store_cond_;
+        std::deque<std::pair<YoloPredictionKey, YoloPrediction>> pending_stores_;
+        bool closing_ = false;
+
+        void insert_in_memory(const YoloPredictionKey &key, YoloPrediction prediction);
+
+        [[nodiscard]] std::string entry_filepath(const YoloPredictionKey &key) const;
+
+        [[nodiscard]] std::optional<YoloPrediction> load(const YoloPredictionKey &key) const;
+
+        void store(const YoloPredictionKey &key, const YoloPrediction &prediction) const;
+
+        void store_loop();
+
+    public:
+        explicit YoloPredictionCache(YoloPredictionCacheOptions options = {});
+
+        /// Waits for the pending predictions to be stored.
+        ~YoloPredictionCache();
+
+        [[nodiscard]] YoloPredictionCacheOptions options() const noexcept;
+
+        std::optional<YoloPrediction> find(const YoloPredictionKey &key);
+
+        void insert(const YoloPredictionKey &key, const YoloPrediction &prediction);
+
+        /// Clears the predictions in memory, stored ones are kept.
+        void clear();
+
+        [[nodiscard]] std::uint64_t num_hits();
+
+        [[nodiscard]] std::uint64_t num_misses();
+
+        [[nodiscard]] std::size_t memory();
+
+        /// Content hash of a file. Large files are sampled at their start, middle and end
+        /// along with their size instead of being read entirely. Returns 0 on failure.
+        static std::uint64_t hash_file(const std::string &filepath, bool sampled = true);
+
+        /// Hash of the options changing the raw prediction besides the input shape, and of the roi mask.
+        static std::uint64_t hash_preprocess(const YoloOptions &options, const cv::Mat &roi_mask = cv::Mat());
+    };
+}  // namespace ultralytics
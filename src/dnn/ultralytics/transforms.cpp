@@ -1,5 +1,7 @@
 #include "transforms.h"
 
+#include <cmath>
+
 #include <opencv2/imgproc.hpp>
 
 #include <c10/macros/Macros.h>
@@ -26,7 +28,7 @@ namespace ultralytics {
                     const cv::Scalar &value,
                     int interpolation,
                     bool copy) {
-                if (input.rows == output_size.width && input.cols == output_size.height)
+                if (input.rows == output_size.height && input.cols == output_size.width)
                     return copy ? input.clone() : input;
                 auto resize_scale = generate_scale(input.size(), output_size);
                 int new_shape_w = std::round(input.cols * resize_scale);
@@ -54,6 +56,54 @@ namespace ultralytics {
                                    cv::BORDER_CONSTANT, value);
                 return output;
             }
+
+            cv::Size rect_shape(
+                    const cv::Size &input_size,
+                    const cv::Size &max_shape,
+                    int stride) {
+                TORCH_CHECK_VALUE(stride > 0, "stride must be positive. Got stride=", stride)
+                auto scale = generate_scale(input_size, max_shape);
+                auto align = [stride](double length, int max_length) {
+                    auto aligned = static_cast<int>(std::ceil(std::round(length) / stride)) * stride;
+                    // max_length itself may not be a multiple of stride
+                    return std::max(stride, std::min(aligned, max_length / stride * stride));
+                };
+                return {align(input_size.width * scale, max_shape.width),
+                        align(input_size.height * scale, max_shape.height)};
+            }
+
+            namespace {
+                C10_ALWAYS_INLINE std::vector<int> generate_tile_offsets(int length, int tile_length, double overlap) {
+                    if (tile_length >= length)
+                        return {0};
+                    int stride = std::max(1, static_cast<int>(std::round(tile_length * (1. - overlap))));
+                    std::vector<int> offsets;
+                    for (int offset = 0; offset + tile_length < length; offset += stride)
+                        offsets.push_back(offset);
+                    offsets.push_back(length - tile_length);
+                    return offsets;
+                }
+            }
+
+            std::vector<cv::Rect> generate_tiles(
+                    const cv::Size &input_size,
+                    const cv::Size &tile_size,
+                    double overlap) {
+                TORCH_CHECK_VALUE(overlap >= 0 && overlap < 1,
+                                  "overlap must be in range [0, 1). Got overlap=",
+                                  overlap)
+                auto tile_w = std::min(tile_size.width, input_size.width);
+                auto tile_h = std::min(tile_size.height, input_size.height);
+                auto xs = generate_tile_offsets(input_size.width, tile_w, overlap);
+                auto ys = generate_tile_offsets(input_size.height, tile_h, overlap);
+
+                std::vector<cv::Rect> tiles;
+                tiles.reserve(xs.size() * ys.size());
+                for (auto y: ys)
+                    for (auto x: xs)
+                        tiles.emplace_back(x, y, tile_w, tile_h);
+                return tiles;
+            }
         }  // namespace functional
 
         // ---------------------
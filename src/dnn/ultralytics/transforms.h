@@ -26,6 +26,21 @@ namespace ultralytics {
                     const cv::Scalar &value = 0,
                     int interpolation = cv::INTER_AREA,
                     bool copy = false);
+
+            /// Smallest shape that is a multiple of stride, fits inside max_shape and
+            /// covers input_size scaled down with its aspect ratio preserved.
+            /// rect_shape(max_shape, max_shape, stride) is the largest one, covering all others.
+            cv::Size rect_shape(
+                    const cv::Size &input_size,
+                    const cv::Size &max_shape,
+                    int stride = 32);
+
+            /// Split an image of input_size into overlapping tiles of tile_size.
+            /// The last tile of each row/column is aligned to the image border.
+            std::vector<cv::Rect> generate_tiles(
+                    const cv::Size &input_size,
+                    const cv::Size &tile_size,
+                    double overlap = 0.2);
         }
 
         class [[maybe_unused]] LetterBox {
@@ -2,6 +2,7 @@
 #include "nms.h"
 #include "transforms.h"
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 
@@ -19,6 +20,22 @@ namespace ultralytics {
         C10_ALWAYS_INLINE YoloVersion _deduce_yolo_version(const at::Tensor &output) {
             return output.size(-1) > output.size(-2) ? Yolov8 : Yolov5;
         }
+
+        C10_ALWAYS_INLINE bool _intersects_roi(const cv::Rect &rect,
+                                               const cv::Size &input_size,
+                                               const cv::Mat &roi_mask) {
+            if (roi_mask.empty())
+                return true;
+            // roi_mask may have a different resolution from the input
+            auto scale_x = static_cast<double>(roi_mask.cols) / input_size.width;
+            auto scale_y = static_cast<double>(roi_mask.rows) / input_size.height;
+            auto x1 = static_cast<int>(std::floor(rect.x * scale_x));
+            auto y1 = static_cast<int>(std::floor(rect.y * scale_y));
+            auto x2 = static_cast<int>(std::ceil((rect.x + rect.width) * scale_x));
+            auto y2 = static_cast<int>(std::ceil((rect.y + rect.height) * scale_y));
+            auto mask_rect = cv::Rect(x1, y1, x2 - x1, y2 - y1) & cv::Rect(0, 0, roi_mask.cols, roi_mask.rows);
+            return !mask_rect.empty() && cv::countNonZero(roi_mask(mask_rect)) > 0;
+        }
     }
 
     YoloBase::YoloBase(YoloOptions options)
@@ -36,6 +53,14 @@ namespace ultralytics {
         return options_;
     }
 
+    void YoloBase::set_thread_pool(std::shared_ptr<std::work_stealing_thread_pool> thread_pool) {
+        thread_pool_ = std::move(thread_pool);
+    }
+
+    std::shared_ptr<std::work_stealing_thread_pool> YoloBase::thread_pool() const noexcept {
+        return thread_pool_;
+    }
+
     void YoloBase::load_classes(const std::string &classes_filepath) {
         std::ifstream inputFile(classes_filepath);
         if (inputFile.is_open()) {
@@ -179,7 +204,7 @@ namespace ultralytics {
         std::vector<int> keep_indices;
         cv::dnn::NMSBoxes(bboxes, confidences,
                           is_yolov8 ? options_.score_threshold() : options_.confidence_threshold(),
-                          options_.nms_threshold(), keep_indices);
+                          options_.nms_threshold(), keep_indices, 1.f, options_.max_det());
 
         std::vector<Detection> detections;
         for (auto idx: keep_indices) {
@@ -221,14 +246,121 @@ namespace ultralytics {
     void YoloLibTorch::load(const std::string &filename, c10::optional<at::Device> device) {
         LibTorchModule::load(filename, device);
         version_ = Yolo_UNKNOWN;
+        warm_shapes_.clear();
+        retained_predictions_.clear();
+    }
+
+    void YoloLibTorch::warmup(const cv::Size &input_shape, int n_iters) {
+        at::NoGradGuard no_grad;
+        auto dummy_input = at::zeros({1, 3, input_shape.height, input_shape.width},
+                                     at::TensorOptions(device_).dtype(dtype_));
+        for (int i = 0; i < n_iters; i++)
+            forward(dummy_input);
+
+        auto it = std::find_if(warm_shapes_.begin(), warm_shapes_.end(), [&](const WarmShape &warm_shape) {
+            return warm_shape.shape == input_shape;
+        });
+        if (it != warm_shapes_.end())
+            warm_shapes_.erase(it);
+        warm_shapes_.push_back({input_shape, device_, dtype_});
+        evict_warm_shapes();
+    }
+
+    cv::Size YoloLibTorch::max_inference_shape() const {
+        return transforms::functional::rect_shape(options_.input_shape(), options_.input_shape(), options_.stride());
+    }
+
+    void YoloLibTorch::evict_warm_shapes() {
+        auto max_shape = max_inference_shape();
+        while (warm_shapes_.size() > max_warm_shapes_) {
+            auto lru = warm_shapes_.begin();
+            if (lru->shape == max_shape)
+                lru++;
+            warm_shapes_.erase(lru);
+        }
+    }
+
+    std::size_t YoloLibTorch::max_warm_shapes() const noexcept {
+        return max_warm_shapes_;
+    }
+
+    void YoloLibTorch::set_max_warm_shapes(std::size_t max_warm_shapes) {
+        max_warm_shapes_ = std::max<std::size_t>(max_warm_shapes, 1);
+        evict_warm_shapes();
+    }
+
+    void YoloLibTorch::drop_stale_warm_shapes() {
+        warm_shapes_.erase(std::remove_if(warm_shapes_.begin(), warm_shapes_.end(), [&](const WarmShape &warm_shape) {
+            return warm_shape.device != device_ || warm_shape.dtype != dtype_;
+        }), warm_shapes_.end());
+    }
+
+    bool YoloLibTorch::is_warm(const cv::Size &shape) const {
+        return std::any_of(warm_shapes_.begin(), warm_shapes_.end(), [&](const WarmShape &warm_shape) {
+            return warm_shape.shape == shape && warm_shape.device == device_ && warm_shape.dtype == dtype_;
+        });
+    }
+
+    void YoloLibTorch::warmup_inference_shapes(const cv::Size &input_size) {
+        drop_stale_warm_shapes();
+        if (!options_.rect()) {
+            if (!is_warm(options_.input_shape()))
+                warmup(options_.input_shape());
+            return;
+        }
+        // the largest shape covers any other and is the fallback of a full cache, it is always kept warm
+        auto max_shape = max_inference_shape();
+        if (!is_warm(max_shape))
+            warmup(max_shape);
+        if (input_size.empty())
+            return;
+        auto shape = transforms::functional::rect_shape(input_size, options_.input_shape(), options_.stride());
+        if (!is_warm(shape))
+            warmup(shape);
+    }
+
+    cv::Size YoloLibTorch::inference_shape(const cv::Size &input_size) {
+        if (!options_.rect())
+            return options_.input_shape();
+        auto shape = transforms::functional::rect_shape(input_size, options_.input_shape(), options_.stride());
+
+        drop_stale_warm_shapes();
+        auto it = std::find_if(warm_shapes_.begin(), warm_shapes_.end(), [&](const WarmShape &warm_shape) {
+            return warm_shape.shape == shape;
+        });
+        if (it != warm_shapes_.end()) {
+            std::rotate(it, std::next(it), warm_shapes_.end());
+            return shape;
+        }
+        // not warm yet, reuse the smallest warm shape that covers this one
+        // instead of specializing the graph on the frame path
+        auto max_shape = max_inference_shape();
+        auto best = warm_shapes_.end();
+        for (auto warm_it = warm_shapes_.begin(); warm_it != warm_shapes_.end(); warm_it++) {
+            if (warm_it->shape.width >= shape.width && warm_it->shape.height >= shape.height &&
+                (best == warm_shapes_.end() || warm_it->shape.area() < best->shape.area()))
+                best = warm_it;
+        }
+        return best != warm_shapes_.end() ? best->shape : max_shape;
     }
 
     at::Tensor YoloLibTorch::forward(const at::Tensor &input) {
-        TORCH_CHECK_VALUE(input.size(-2) == options_.input_height() && input.size(-1) == options_.input_width(),
-                          "input must has spatial size of ",
-                          options_.input_shape(),
-                          ". Got input.sizes()=",
-                          input.sizes())
+        if (options_.rect()) {
+            TORCH_CHECK_VALUE(input.size(-2) <= options_.input_height() && input.size(-1) <= options_.input_width() &&
+                              input.size(-2) % options_.stride() == 0 && input.size(-1) % options_.stride() == 0,
+                              "input must has spatial size within ",
+                              options_.input_shape(),
+                              " and divisible by stride=",
+                              options_.stride(),
+                              ". Got input.sizes()=",
+                              input.sizes())
+        } else {
+            TORCH_CHECK_VALUE(input.size(-2) == options_.input_height() && input.size(-1) == options_.input_width(),
+                              "input must has spatial size of ",
+                              options_.input_shape(),
+                              ". Got input.sizes()=",
+                              input.sizes())
+        }
         // only inference, no preprocessing nor postprocessing
         std::vector<torch::jit::IValue> inputs{input};
         auto prediction = net.forward(inputs).toTensor();
@@ -238,8 +370,25 @@ namespace ultralytics {
     }
 
     std::vector<Detection> YoloLibTorch::forward(const cv::Mat &input) {
+        return forward(input, cv::Mat());
+    }
+
+    std::vector<Detection> YoloLibTorch::forward(const cv::Mat &input, const cv::Mat &roi_mask) {
+        auto prediction = predict(input, roi_mask);
+        retain_prediction(prediction);
+        return postprocess(prediction);
+    }
+
+    YoloPrediction YoloLibTorch::predict(const cv::Mat &input, const cv::Mat &roi_mask) {
+        if (options_.tiled())
+            return predict_tiled(input, roi_mask);
+        YoloPrediction result;
+        result.input_size = input.size();
+        if (!_intersects_roi(cv::Rect(0, 0, input.cols, input.rows), input.size(), roi_mask))
+            return result;
+
         auto scaled_input = transforms::functional::letterbox(
-                input, options_.input_shape(), options_.align_center(), cv::Scalar(117, 117, 117));
+                input, inference_shape(input.size()), options_.align_center(), cv::Scalar(117, 117, 117));
 
         auto input_tensor = at::from_blob(
                 scaled_input.data, {scaled_input.rows, scaled_input.cols, scaled_input.channels()},
@@ -249,18 +398,160 @@ namespace ultralytics {
         std::vector<torch::jit::IValue> inputs{input_tensor};
 
         // inference
-        auto prediction = net.forward(inputs).toTensor().cpu();
+        result.prediction = net.forward(inputs).toTensor().cpu();
         if (version_ == Yolo_UNKNOWN)
-            version_ = _deduce_yolo_version(prediction);
-        TORCH_CHECK_NOT_IMPLEMENTED(version_ == Yolov8,
+            version_ = _deduce_yolo_version(result.prediction);
+        result.version = version_;
+        result.inference_shape = scaled_input.size();
+        return result;
+    }
+
+    std::vector<Detection> YoloLibTorch::postprocess(const YoloPrediction &prediction) {
+        if (prediction.empty())
+            return {};
+        TORCH_CHECK_NOT_IMPLEMENTED(prediction.version == Yolov8,
                                     "Post-processing for Yolov5 LibTorch is not implemented.")
+        if (!prediction.tiles.empty())
+            return postprocess_tiled(prediction);
 
         // nms
-        prediction = ops::non_max_suppression(
-                prediction, version_ == Yolov8 ? options_.score_threshold() : options_.confidence_threshold(),
-                options_.nms_threshold())[0];
+        auto output = ops::non_max_suppression(
+                prediction.prediction, options_.score_threshold(), options_.nms_threshold(), options_.max_det())[0];
         transforms::functional::rescale_bboxes_(
-                prediction, input.size(), scaled_input.size(), options_.align_center());
-        return transforms::functional::to_detection_list(prediction, classes_);
+                output, prediction.input_size, prediction.inference_shape, options_.align_center());
+        return transforms::functional::to_detection_list(output, classes_);
+    }
+
+    const std::deque<YoloPrediction> &YoloLibTorch::retained_predictions() const noexcept {
+        return retained_predictions_;
+    }
+
+    std::size_t YoloLibTorch::max_retained_predictions() const noexcept {
+        return max_retained_predictions_;
+    }
+
+    void YoloLibTorch::set_max_retained_predictions(std::size_t max_retained_predictions) {
+        max_retained_predictions_ = max_retained_predictions;
+        while (retained_predictions_.size() > max_retained_predictions_)
+            retained_predictions_.pop_front();
+    }
+
+    void YoloLibTorch::retain_prediction(YoloPrediction prediction) {
+        if (!max_retained_predictions_)
+            return;
+        // tensors are shared, not copied
+        retained_predictions_.push_back(std::move(prediction));
+        while (retained_predictions_.size() > max_retained_predictions_)
+            retained_predictions_.pop_front();
+    }
+
+    void YoloLibTorch::clear_retained_predictions() {
+        retained_predictions_.clear();
+    }
+
+    std::vector<std::vector<Detection>> YoloLibTorch::forward_batch(const std::vector<cv::Mat> &inputs) {
+        if (inputs.empty())
+            return {};
+
+        // letterboxed inputs are written directly into the batch
+        auto input_shape = options_.input_shape();
+        auto channels = inputs.front().channels();
+        for (const auto &input: inputs)
+            TORCH_CHECK_VALUE(input.channels() == channels,
+                              "all inputs must have ", channels, " channels. Got ", input.channels())
+        auto batch = at::empty({static_cast<int64_t>(inputs.size()),
+                                input_shape.height, input_shape.width, channels},
+                               at::TensorOptions(at::kByte));
+        std::parallel_for(thread_pool_.get(), 0, inputs.size(), [&](std::size_t i) {
+            cv::Mat batch_slice(input_shape, CV_8UC(channels), batch[static_cast<int64_t>(i)].data_ptr());
+            transforms::functional::letterbox(
+                    inputs[i], input_shape, options_.align_center(), cv::Scalar(117, 117, 117)
+            ).copyTo(batch_slice);
+        });
+
+        auto input_tensor = batch.to(device_, dtype_).div_(255).permute({0, 3, 1, 2});
+        std::vector<torch::jit::IValue> net_inputs{input_tensor};
+
+        // inference
+        auto prediction = net.forward(net_inputs).toTensor().cpu();
+        if (version_ == Yolo_UNKNOWN)
+            version_ = _deduce_yolo_version(prediction);
+        TORCH_CHECK_NOT_IMPLEMENTED(version_ == Yolov8,
+                                    "Post-processing for Yolov5 LibTorch is not implemented.")
+
+        // per-frame nms
+        auto outputs = ops::non_max_suppression(
+                prediction, options_.score_threshold(), options_.nms_threshold(), options_.max_det(),
+                thread_pool_.get());
+        std::vector<std::vector<Detection>> detections(inputs.size());
+        std::parallel_for(thread_pool_.get(), 0, inputs.size(), [&](std::size_t i) {
+            transforms::functional::rescale_bboxes_(
+                    outputs[i], inputs[i].size(), input_shape, options_.align_center());
+            detections[i] = transforms::functional::to_detection_list(outputs[i], classes_);
+        });
+        return detections;
+    }
+
+    YoloPrediction YoloLibTorch::predict_tiled(const cv::Mat &input, const cv::Mat &roi_mask) {
+        YoloPrediction result;
+        result.input_size = input.size();
+        auto tiles = transforms::functional::generate_tiles(
+                input.size(), options_.tile_shape(), options_.tile_overlap());
+        // an extra full frame pass keeps large objects that are cut by tile borders
+        if (options_.tile_full_frame() && tiles.size() > 1)
+            tiles.emplace_back(0, 0, input.cols, input.rows);
+        tiles.erase(std::remove_if(tiles.begin(), tiles.end(), [&](const cv::Rect &tile) {
+            return !_intersects_roi(tile, input.size(), roi_mask);
+        }), tiles.end());
+        if (tiles.empty())
+            return result;
+
+        // tiles are views of input, letterboxed outputs are written directly into the batch
+        auto input_shape = options_.input_shape();
+        auto batch = at::empty({static_cast<int64_t>(tiles.size()),
+                                input_shape.height, input_shape.width, input.channels()},
+                               at::TensorOptions(at::kByte));
+        std::parallel_for(thread_pool_.get(), 0, tiles.size(), [&](std::size_t i) {
+            cv::Mat batch_slice(input_shape, CV_8UC(input.channels()), batch[static_cast<int64_t>(i)].data_ptr());
+            transforms::functional::letterbox(
+                    input(tiles[i]), input_shape, options_.align_center(), cv::Scalar(117, 117, 117)
+            ).copyTo(batch_slice);
+        });
+
+        auto input_tensor = batch.to(device_, dtype_).div_(255).permute({0, 3, 1, 2});
+        std::vector<torch::jit::IValue> inputs{input_tensor};
+
+        // inference
+        result.prediction = net.forward(inputs).toTensor().cpu();
+        if (version_ == Yolo_UNKNOWN)
+            version_ = _deduce_yolo_version(result.prediction);
+        result.version = version_;
+        result.inference_shape = input_shape;
+        result.tiles = std::move(tiles);
+        return result;
+    }
+
+    std::vector<Detection> YoloLibTorch::postprocess_tiled(const YoloPrediction &prediction) {
+        const auto &tiles = prediction.tiles;
+        // per-tile nms, then map boxes back to input coordinates
+        auto outputs = ops::non_max_suppression(
+                prediction.prediction, options_.score_threshold(), options_.nms_threshold(), options_.max_det(),
+                thread_pool_.get());
+        std::parallel_for(thread_pool_.get(), 0, tiles.size(), [&](std::size_t i) {
+            auto &output = outputs[i];
+            transforms::functional::rescale_bboxes_(
+                    output, tiles[i].size(), prediction.inference_shape, options_.align_center());
+            output.index({at::indexing::Ellipsis, indexing::BboxXSlice}).add_(tiles[i].x);
+            output.index({at::indexing::Ellipsis, indexing::BboxYSlice}).add_(tiles[i].y);
+        });
+
+        // cross-tile nms
+        auto merged = at::cat(outputs, 0);
+        auto keep = ops::batched_nms(merged.index({at::indexing::Slice(), indexing::BboxXYSlice}),
+                                     merged.index({at::indexing::Slice(), 4}),
+                                     merged.index({at::indexing::Slice(), 5}),
+                                     options_.nms_threshold());
+        merged = merged.index({keep.index({at::indexing::Slice(at::indexing::None, options_.max_det())})});
+        return transforms::functional::to_detection_list(merged, classes_);
     }
 }  // namespace ultralytics
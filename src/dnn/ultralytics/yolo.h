@@ -6,9 +6,13 @@
 
 #define slots Q_SLOTS
 
+#include <deque>
+#include <memory>
+
 #include "../inference_engine.h"
 #include "../module.h"
 #include "../return_types.h"
+#include "std/threading/work_stealing_thread_pool.h"
 
 namespace ultralytics {
     enum YoloVersion {
@@ -23,7 +27,13 @@ namespace ultralytics {
         float confidence_threshold_;
         float score_threshold_;
         float nms_threshold_;
+        int max_det_;
         bool align_center_;
+        cv::Size tile_shape_;
+        float tile_overlap_;
+        bool tile_full_frame_;
+        bool rect_;
+        int stride_;
 
     public:
         YoloOptions()
@@ -31,7 +41,13 @@ namespace ultralytics {
                   confidence_threshold_(0.25),
                   score_threshold_(0.45),
                   nms_threshold_(0.5),
-                  align_center_(true) {}
+                  max_det_(100),
+                  align_center_(true),
+                  tile_shape_(0, 0),
+                  tile_overlap_(0.2),
+                  tile_full_frame_(true),
+                  rect_(false),
+                  stride_(32) {}
 
         explicit YoloOptions(const cv::Size &input_shape)
                 : YoloOptions() {
@@ -62,10 +78,42 @@ namespace ultralytics {
             return nms_threshold_;
         }
 
+        /// Detections kept per frame, after cross-tile NMS when tiled.
+        [[nodiscard]] inline int max_det() const noexcept {
+            return max_det_;
+        }
+
         [[nodiscard]] inline bool align_center() const noexcept {
             return align_center_;
         }
 
+        [[nodiscard]] inline cv::Size tile_shape() const noexcept {
+            return tile_shape_;
+        }
+
+        [[nodiscard]] inline float tile_overlap() const noexcept {
+            return tile_overlap_;
+        }
+
+        [[nodiscard]] inline bool tile_full_frame() const noexcept {
+            return tile_full_frame_;
+        }
+
+        /// Tiled inference is enabled when tile_shape is not empty.
+        [[nodiscard]] inline bool tiled() const noexcept {
+            return !tile_shape_.empty();
+        }
+
+        /// Rectangular inference letterboxes inputs to the smallest stride-aligned
+        /// shape within input_shape that covers the source aspect ratio.
+        [[nodiscard]] inline bool rect() const noexcept {
+            return rect_;
+        }
+
+        [[nodiscard]] inline int stride() const noexcept {
+            return stride_;
+        }
+
         [[nodiscard]] inline YoloOptions input_shape(const cv::Size &input_shape) const noexcept {
             auto r = *this;
             r.set_input_shape(input_shape);
@@ -90,12 +138,48 @@ namespace ultralytics {
             return r;
         }
 
+        [[nodiscard]] inline YoloOptions max_det(int max_det) const noexcept {
+            auto r = *this;
+            r.set_max_det(max_det);
+            return r;
+        }
+
         [[nodiscard]] inline YoloOptions align_center(bool align_center) const noexcept {
             auto r = *this;
             r.set_align_center(align_center);
             return r;
         }
 
+        [[nodiscard]] inline YoloOptions tile_shape(const cv::Size &tile_shape) const noexcept {
+            auto r = *this;
+            r.set_tile_shape(tile_shape);
+            return r;
+        }
+
+        [[nodiscard]] inline YoloOptions tile_overlap(float tile_overlap) const noexcept {
+            auto r = *this;
+            r.set_tile_overlap(tile_overlap);
+            return r;
+        }
+
+        [[nodiscard]] inline YoloOptions tile_full_frame(bool tile_full_frame) const noexcept {
+            auto r = *this;
+            r.set_tile_full_frame(tile_full_frame);
+            return r;
+        }
+
+        [[nodiscard]] inline YoloOptions rect(bool rect) const noexcept {
+            auto r = *this;
+            r.set_rect(rect);
+            return r;
+        }
+
+        [[nodiscard]] inline YoloOptions stride(int stride) const noexcept {
+            auto r = *this;
+            r.set_stride(stride);
+            return r;
+        }
+
     private:
         inline void set_input_shape(const cv::Size &input_shape) & noexcept {
             input_shape_ = input_shape;
@@ -113,15 +197,56 @@ namespace ultralytics {
             nms_threshold_ = nms_threshold;
         }
 
+        inline void set_max_det(int max_det) & noexcept {
+            max_det_ = max_det;
+        }
+
         inline void set_align_center(bool align_center) & noexcept {
             align_center_ = align_center;
         }
+
+        inline void set_tile_shape(const cv::Size &tile_shape) & noexcept {
+            tile_shape_ = tile_shape;
+        }
+
+        inline void set_tile_overlap(float tile_overlap) & noexcept {
+            tile_overlap_ = tile_overlap;
+        }
+
+        inline void set_tile_full_frame(bool tile_full_frame) & noexcept {
+            tile_full_frame_ = tile_full_frame;
+        }
+
+        inline void set_rect(bool rect) & noexcept {
+            rect_ = rect;
+        }
+
+        inline void set_stride(int stride) & noexcept {
+            stride_ = stride;
+        }
+    };
+
+    /// Raw network output of a frame, before NMS, with what post-processing it needs.
+    struct YoloPrediction {
+        YoloVersion version = Yolo_UNKNOWN;
+        /// (batch, 4 + nc, anchors) on cpu, one batch item per tile, undefined if nothing was inferred.
+        at::Tensor prediction;
+        cv::Size input_size;
+        /// Letterboxed size of the frame, or of every tile.
+        cv::Size inference_shape;
+        /// Tiles of the frame in batch order, empty if not tiled.
+        std::vector<cv::Rect> tiles;
+
+        [[nodiscard]] inline bool empty() const noexcept {
+            return !prediction.defined();
+        }
     };
 
     class YoloBase {
     protected:
         YoloVersion version_ = Yolo_UNKNOWN;
         YoloOptions options_;
+        std::shared_ptr<std::work_stealing_thread_pool> thread_pool_;
         std::vector<std::string> classes_ = {
                 "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck",
                 "boat", "traffic light", "fire hydrant", "stop sign", "parking meter", "bench",
@@ -146,6 +271,11 @@ namespace ultralytics {
 
         [[nodiscard]] YoloOptions options() const noexcept;
 
+        /// CPU-side pre and post-processing run in parallel on this pool, serially if null.
+        void set_thread_pool(std::shared_ptr<std::work_stealing_thread_pool> thread_pool);
+
+        [[nodiscard]] std::shared_ptr<std::work_stealing_thread_pool> thread_pool() const noexcept;
+
         void load_classes(const std::string &classes_filepath);
 
         [[nodiscard]] int num_classes() const noexcept;
@@ -202,6 +332,28 @@ namespace ultralytics {
 
     template<>
     class Yolo<INFERENCE_ENGINE_LibTorch> : public YoloBase, public LibTorchModule {
+        struct WarmShape {
+            cv::Size shape;
+            at::Device device;
+            at::ScalarType dtype;
+        };
+        // least recently used first
+        std::deque<WarmShape> warm_shapes_;
+        std::size_t max_warm_shapes_ = 4;
+
+        /// Largest rectangular shape, reused by inputs whose shape does not fit in a full cache.
+        [[nodiscard]] cv::Size max_inference_shape() const;
+
+        void evict_warm_shapes();
+
+        /// Forgets the shapes warmed on another device or dtype.
+        void drop_stale_warm_shapes();
+
+        [[nodiscard]] bool is_warm(const cv::Size &shape) const;
+        // oldest first
+        std::deque<YoloPrediction> retained_predictions_;
+        std::size_t max_retained_predictions_ = 1;
+
     public:
         explicit Yolo(YoloOptions options = {});
 
@@ -216,10 +368,57 @@ namespace ultralytics {
 
         void load(const std::string &filename, c10::optional<at::Device> device = c10::nullopt);
 
+        /// Run a few dummy forwards so that the graph executor specializes
+        /// for this input shape before real frames arrive. When warmed, the largest
+        /// rectangular shape is never evicted.
+        void warmup(const cv::Size &input_shape, int n_iters = 2);
+
+        [[nodiscard]] std::size_t max_warm_shapes() const noexcept;
+
+        void set_max_warm_shapes(std::size_t max_warm_shapes);
+
+        /// Warms the largest shape, and the rectangular shape of input_size if not empty,
+        /// unless they are already warm on the current device and dtype. Meant to be called
+        /// off the frame path whenever the input size, device, dtype or options change.
+        void warmup_inference_shapes(const cv::Size &input_size = {});
+
+        /// Returns the shape an input of input_size will be letterboxed to, among the warm ones:
+        /// its own rectangular shape, else the smallest one covering it, else the largest shape.
+        /// Never warms up, see warmup_inference_shapes().
+        [[nodiscard]] cv::Size inference_shape(const cv::Size &input_size);
+
         at::Tensor forward(const at::Tensor &input);
 
         std::vector<Detection> forward(const cv::Mat &input);
 
+        /// Forward with an optional single channel region-of-interest mask,
+        /// tiles (or the whole frame) not overlapping with the mask are skipped.
+        std::vector<Detection> forward(const cv::Mat &input, const cv::Mat &roi_mask);
+
+        /// Pre-processing and inference of forward, without post-processing.
+        YoloPrediction predict(const cv::Mat &input, const cv::Mat &roi_mask = cv::Mat());
+
+        /// NMS and rescaling of a prediction with the current options, the network is not run.
+        std::vector<Detection> postprocess(const YoloPrediction &prediction);
+
+        /// Raw predictions of the last frames forwarded, oldest first, to post-process
+        /// them again when thresholds change.
+        [[nodiscard]] const std::deque<YoloPrediction> &retained_predictions() const noexcept;
+
+        [[nodiscard]] std::size_t max_retained_predictions() const noexcept;
+
+        /// 0 retains nothing.
+        void set_max_retained_predictions(std::size_t max_retained_predictions);
+
+        /// Retains a prediction not obtained from forward, e.g. looked up in a cache.
+        void retain_prediction(YoloPrediction prediction);
+
+        void clear_retained_predictions();
+
+        /// Batched forward of frames of any size letterboxed to input_shape, for offline
+        /// throughput. Tiling and rectangular inference are not applied.
+        std::vector<std::vector<Detection>> forward_batch(const std::vector<cv::Mat> &inputs);
+
         inline at::Tensor operator()(const at::Tensor &input) {
             return forward(input);
         }
@@ -227,6 +426,17 @@ namespace ultralytics {
         inline std::vector<Detection> operator()(const cv::Mat &input) {
             return forward(input);
         }
+
+        inline std::vector<Detection> operator()(const cv::Mat &input, const cv::Mat &roi_mask) {
+            return forward(input, roi_mask);
+        }
+
+    protected:
+        /// Sliced inference: overlapping tiles of the input are letterboxed and
+        /// batched through a single forward, then merged with cross-tile NMS.
+        YoloPrediction predict_tiled(const cv::Mat &input, const cv::Mat &roi_mask);
+
+        std::vector<Detection> postprocess_tiled(const YoloPrediction &prediction);
     };
 
     // aliases
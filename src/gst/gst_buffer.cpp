@@ -1,62 +1,198 @@
 #include "gst_buffer.h"
 
 #include <cstring>
-#include <cmath>
 
 namespace {
-    template<gint ru = 0>
-    inline gint rstride(gint base) {
-        if constexpr (ru == 0)
-            return base;
-        else
-            return (gint) std::ceil((gdouble) (base) / ru) * ru;
+    // row alignment of pooled frames, 32 bytes suits SIMD loads of the converters
+    constexpr guint POOL_STRIDE_ALIGN = 31;
+
+    inline void copy_rows(guint8 *dst, gint dst_stride, const guint8 *src, gint src_stride,
+                          gint row_size, gint height) {
+        if (dst_stride == src_stride && row_size == src_stride) {
+            std::memcpy(dst, src, (gsize) src_stride * height);
+            return;
+        }
+        for (gint row = 0; row < height; row++)
+            std::memcpy(dst + (gsize) row * dst_stride, src + (gsize) row * src_stride, row_size);
+    }
+
+    /// Bytes per pixel of a packed single-plane format, 0 otherwise.
+    inline gint packed_pixel_stride(GstVideoFormat format) {
+        auto *finfo = gst_video_format_get_info(format);
+        if (!finfo || GST_VIDEO_FORMAT_INFO_N_PLANES(finfo) != 1)
+            return 0;
+        return GST_VIDEO_FORMAT_INFO_PSTRIDE(finfo, 0);
+    }
+
+    /// Copies a single-plane frame of the given source stride into a buffer laid out as in info.
+    inline gboolean copy_into_frame(GstBuffer *buf, const GstVideoInfo *info,
+                                    gconstpointer data, gint src_stride) {
+        GstVideoFrame frame;
+        if (!gst_video_frame_map(&frame, info, buf, GST_MAP_WRITE))
+            return FALSE;
+        copy_rows((guint8 *) GST_VIDEO_FRAME_PLANE_DATA(&frame, 0),
+                  GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0),
+                  (const guint8 *) data, src_stride,
+                  GST_VIDEO_FRAME_COMP_WIDTH(&frame, 0) * GST_VIDEO_FRAME_COMP_PSTRIDE(&frame, 0),
+                  GST_VIDEO_FRAME_HEIGHT(&frame));
+        gst_video_frame_unmap(&frame);
+        return TRUE;
     }
 }
 
 GstBuffer *gst_buffer_new_memdup_from_contiguous(
         gconstpointer data, gint width, gint height, GstVideoFormat format) {
-    gint src_step, step;
-    // Ref: https://gstreamer.freedesktop.org/documentation/additional/design/mediatype-video-raw.html?gi-language=c#formats
-    switch (format) {
-        case GST_VIDEO_FORMAT_AYUV:
-        case GST_VIDEO_FORMAT_RGBx:
-        case GST_VIDEO_FORMAT_BGRx:
-        case GST_VIDEO_FORMAT_xRGB:
-        case GST_VIDEO_FORMAT_xBGR:
-        case GST_VIDEO_FORMAT_RGBA:
-        case GST_VIDEO_FORMAT_BGRA:
-        case GST_VIDEO_FORMAT_ARGB:
-        case GST_VIDEO_FORMAT_ABGR:
-            return gst_buffer_new_memdup(data, height * width * 4);
-        case GST_VIDEO_FORMAT_RGB:
-        case GST_VIDEO_FORMAT_BGR:
-            src_step = width * 3;
-            step = rstride<4>(src_step);
-            break;
-        case GST_VIDEO_FORMAT_GRAY8:
-            src_step = width;
-            step = rstride<4>(src_step);
-            break;
-        case GST_VIDEO_FORMAT_GRAY16_BE:
-        case GST_VIDEO_FORMAT_GRAY16_LE:
-//        case GST_VIDEO_FORMAT_RGB16:
-//        case GST_VIDEO_FORMAT_BGR16:
-            src_step = width * 2;
-            step = rstride<4>(src_step);
-            break;
-        default:
-            g_error("%s is not supported", gst_video_format_to_string(format));
-    }
-    gsize s = step * height;
-    const auto *data_uc = (const guint8 *) data;
-    auto *buf = gst_buffer_new();
-    auto mem = gst_allocator_alloc(NULL, s, NULL);
-    gst_buffer_append_memory(buf, mem);
-    GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_WRITE);
-#pragma unroll
-    for (gint row = 0; row < height; row++) {
-        std::memcpy(map_info.data + row * step, data_uc + row * src_step, src_step);
+    // one pool per producing thread, its buffers come back to it once released downstream
+    thread_local GstFrameBufferPool pool;
+    if (!packed_pixel_stride(format))
+        g_error("%s is not supported", gst_video_format_to_string(format));
+    return pool.copy_from_contiguous(data, width, height, format);
+}
+
+GstBuffer *gst_buffer_new_wrapped_frame(gpointer data, gint width, gint height, gint stride, GstVideoFormat format,
+                                        gpointer user_data, GDestroyNotify notify) {
+    auto pixel_stride = packed_pixel_stride(format);
+    g_return_val_if_fail(pixel_stride > 0 && width > 0 && height > 0 && stride >= width * pixel_stride, NULL);
+    // the padding after the last row of a ROI or slice is not part of the storage
+    gsize size = (gsize) stride * (height - 1) + (gsize) width * pixel_stride;
+    auto *buf = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, data, size, 0, size, user_data, notify);
+    gsize offset[GST_VIDEO_MAX_PLANES] = {0};
+    gint strides[GST_VIDEO_MAX_PLANES] = {stride};
+    gst_buffer_add_video_meta_full(buf, GST_VIDEO_FRAME_FLAG_NONE, format, width, height, 1, offset, strides);
+    return buf;
+}
+
+GstBuffer *gst_buffer_new_wrapped_mat(const cv::Mat &mat, GstVideoFormat format) {
+    CV_CheckEQ((int) mat.elemSize(), packed_pixel_stride(format),
+               "Mat pixel size must match the pixel stride of format");
+    CV_Assert(mat.dims == 2);
+    // the Mat header copy holds a reference to the shared storage
+    auto *holder = new cv::Mat(mat);
+    return gst_buffer_new_wrapped_frame(holder->data, holder->cols, holder->rows, (gint) holder->step[0], format,
+                                        holder, [](gpointer data) { delete static_cast<cv::Mat *>(data); });
+}
+
+GstBuffer *gst_buffer_new_wrapped_tensor(const at::Tensor &tensor, GstVideoFormat format) {
+    TORCH_CHECK(tensor.device().is_cpu() && tensor.scalar_type() == at::kByte,
+                "only uint8 cpu tensors can be wrapped, got ", tensor.scalar_type(), " on ", tensor.device());
+    TORCH_CHECK(tensor.dim() == 2 || tensor.dim() == 3, "expected a HW or HWC tensor, got ", tensor.sizes());
+    // rows may be padded, but pixels must be packed
+    TORCH_CHECK(tensor.dim() == 2 ? tensor.stride(1) == 1
+                                  : (tensor.stride(2) == 1 && tensor.stride(1) == tensor.size(2)),
+                "tensor pixels are not contiguous, strides ", tensor.strides());
+    auto channels = tensor.dim() == 2 ? 1 : tensor.size(2);
+    TORCH_CHECK(channels == packed_pixel_stride(format),
+                "a tensor of ", channels, " channels cannot be wrapped as ", gst_video_format_to_string(format));
+    auto *holder = new at::Tensor(tensor);
+    return gst_buffer_new_wrapped_frame(holder->data_ptr(), (gint) holder->size(1), (gint) holder->size(0),
+                                        (gint) holder->stride(0), format,
+                                        holder, [](gpointer data) { delete static_cast<at::Tensor *>(data); });
+}
+
+GstFrameBufferPool::GstFrameBufferPool(guint min_buffers, guint max_buffers)
+        : min_buffers_(min_buffers), max_buffers_(max_buffers) {
+    gst_video_info_init(&info_);
+}
+
+GstFrameBufferPool::~GstFrameBufferPool() {
+    if (pool_) {
+        gst_buffer_pool_set_active(pool_, FALSE);
+        gst_object_unref(pool_);
+    }
+}
+
+bool GstFrameBufferPool::configure(gint width, gint height, GstVideoFormat format) {
+    if (is_configured() && GST_VIDEO_INFO_WIDTH(&info_) == width &&
+        GST_VIDEO_INFO_HEIGHT(&info_) == height && GST_VIDEO_INFO_FORMAT(&info_) == format)
+        return true;
+
+    // buffers still in flight keep the old pool alive until they are released
+    if (pool_) {
+        gst_buffer_pool_set_active(pool_, FALSE);
+        gst_object_unref(pool_);
+        pool_ = NULL;
+    }
+    if (!gst_video_info_set_format(&info_, format, width, height))
+        return false;
+    GstVideoAlignment align;
+    gst_video_alignment_reset(&align);
+    for (guint i = 0; i < GST_VIDEO_INFO_N_PLANES(&info_); i++)
+        align.stride_align[i] = POOL_STRIDE_ALIGN;
+    gst_video_info_align(&info_, &align);
+
+    auto *pool = gst_video_buffer_pool_new();
+    auto *config = gst_buffer_pool_get_config(pool);
+    auto *caps = gst_video_info_to_caps(&info_);
+    gst_buffer_pool_config_set_params(config, caps, GST_VIDEO_INFO_SIZE(&info_), min_buffers_, max_buffers_);
+    gst_caps_unref(caps);
+    gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+    gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+    gst_buffer_pool_config_set_video_alignment(config, &align);
+    if (!gst_buffer_pool_set_config(pool, config) || !gst_buffer_pool_set_active(pool, TRUE)) {
+        gst_object_unref(pool);
+        gst_video_info_init(&info_);
+        return false;
+    }
+    pool_ = pool;
+    return true;
+}
+
+bool GstFrameBufferPool::is_configured() const noexcept {
+    return pool_ != NULL;
+}
+
+const GstVideoInfo &GstFrameBufferPool::info() const noexcept {
+    return info_;
+}
+
+GstCaps *GstFrameBufferPool::caps() const {
+    return gst_video_info_to_caps(&info_);
+}
+
+GstBuffer *GstFrameBufferPool::acquire() {
+    if (!pool_)
+        return NULL;
+    GstBuffer *buf = NULL;
+    if (gst_buffer_pool_acquire_buffer(pool_, &buf, NULL) != GST_FLOW_OK)
+        return NULL;
+    return buf;
+}
+
+GstBuffer *GstFrameBufferPool::copy_from_contiguous(
+        gconstpointer data, gint width, gint height, GstVideoFormat format) {
+    if (!configure(width, height, format))
+        return NULL;
+    if (GST_VIDEO_INFO_N_PLANES(&info_) != 1) {
+        g_printerr("%s has more than one plane, use gst_buffer_new_wrapped_frame instead\n",
+                   gst_video_format_to_string(format));
+        return NULL;
+    }
+    auto src_stride = GST_VIDEO_INFO_COMP_WIDTH(&info_, 0) * GST_VIDEO_INFO_COMP_PSTRIDE(&info_, 0);
+    auto *buf = acquire();
+    if (buf && !copy_into_frame(buf, &info_, data, src_stride)) {
+        gst_buffer_unref(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+GstBuffer *GstFrameBufferPool::copy_from_mat(const cv::Mat &mat, GstVideoFormat format) {
+    if (!configure(mat.cols, mat.rows, format))
+        return NULL;
+    if (GST_VIDEO_INFO_N_PLANES(&info_) != 1) {
+        g_printerr("%s has more than one plane, use gst_buffer_new_wrapped_frame instead\n",
+                   gst_video_format_to_string(format));
+        return NULL;
+    }
+    if ((gint) mat.elemSize() != GST_VIDEO_INFO_COMP_PSTRIDE(&info_, 0)) {
+        g_printerr("Mat pixels of %zu bytes cannot be copied as %s\n", mat.elemSize(),
+                   gst_video_format_to_string(format));
+        return NULL;
+    }
+    auto *buf = acquire();
+    if (buf && !copy_into_frame(buf, &info_, mat.data, (gint) mat.step[0])) {
+        gst_buffer_unref(buf);
+        return NULL;
     }
     return buf;
 }
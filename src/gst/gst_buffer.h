@@ -1,6 +1,84 @@
 #pragma once
 
 #include <gst/gstbuffer.h>
-#include <gst/video/video-format.h>
+#include <gst/gstbufferpool.h>
+#include <gst/video/video.h>
 
+#include <opencv2/core.hpp>
+
+#undef slots
+
+#include <ATen/ATen.h>
+
+#define slots Q_SLOTS
+
+/**
+ * Copy contiguous single-plane frame data into a buffer of a per-thread GstFrameBufferPool,
+ * so that producing frames of the same geometry does not allocate once the pool is warm.
+ * Rows are 32-byte aligned and described by a GstVideoMeta.
+ */
 GstBuffer *gst_buffer_new_memdup_from_contiguous(gconstpointer data, gint width, gint height, GstVideoFormat format);
+
+/**
+ * Wrap externally owned single-plane frame data without copying. notify(user_data) is called once
+ * the last reference to the buffer is gone. A GstVideoMeta carrying stride is attached
+ * so that rows with padding are read correctly downstream. The buffer ends with the last pixel,
+ * not after the padding of the last row. Returns NULL for formats that are not packed single-plane.
+ */
+GstBuffer *gst_buffer_new_wrapped_frame(gpointer data, gint width, gint height, gint stride, GstVideoFormat format,
+                                        gpointer user_data, GDestroyNotify notify);
+
+/**
+ * Zero-copy buffer sharing the storage of mat, which is kept alive by the buffer.
+ * The pixel size of mat must match format.
+ */
+GstBuffer *gst_buffer_new_wrapped_mat(const cv::Mat &mat, GstVideoFormat format);
+
+/**
+ * Zero-copy buffer sharing the storage of a contiguous uint8 HWC (or HW) cpu tensor,
+ * which is kept alive by the buffer. The number of channels must match format.
+ */
+GstBuffer *gst_buffer_new_wrapped_tensor(const at::Tensor &tensor, GstVideoFormat format);
+
+/**
+ * Pool of reusable, stride-aligned video frame buffers backed by a GstVideoBufferPool.
+ * Buffers return to the pool when their last reference is dropped, so once the pool
+ * has grown to the number of frames in flight, acquiring output frames no longer allocates.
+ * The pool is reconfigured when the requested frame geometry or format changes.
+ */
+class GstFrameBufferPool {
+    GstBufferPool *pool_ = NULL;
+    GstVideoInfo info_{};
+    guint min_buffers_;
+    guint max_buffers_;
+
+public:
+    /// max_buffers 0 lets the pool grow without limit instead of blocking acquire().
+    explicit GstFrameBufferPool(guint min_buffers = 2, guint max_buffers = 0);
+
+    GstFrameBufferPool(const GstFrameBufferPool &) = delete;
+
+    GstFrameBufferPool &operator=(const GstFrameBufferPool &) = delete;
+
+    ~GstFrameBufferPool();
+
+    /// Returns false if the pool could not be configured for this frame.
+    bool configure(gint width, gint height, GstVideoFormat format);
+
+    [[nodiscard]] bool is_configured() const noexcept;
+
+    /// Frame layout of the pooled buffers, including their strides.
+    [[nodiscard]] const GstVideoInfo &info() const noexcept;
+
+    /// Caps matching the pooled buffers, transfer full.
+    [[nodiscard]] GstCaps *caps() const;
+
+    /// Returns NULL on failure.
+    GstBuffer *acquire();
+
+    /// Copy contiguous frame data into a pooled buffer, row by row only if its stride differs.
+    GstBuffer *copy_from_contiguous(gconstpointer data, gint width, gint height, GstVideoFormat format);
+
+    /// Copy a cv::Mat of any step into a pooled buffer.
+    GstBuffer *copy_from_mat(const cv::Mat &mat, GstVideoFormat format);
+};
@@ -10,7 +10,7 @@ gulong GstBufferProbe::add_on(GstPad *pad) {
     if (is_added())
         g_error("callback already added with id=%lu", callback_id);
     callback_id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
-                                    this->to_callback(), NULL, NULL);
+                                    to_callback(), this, NULL);
     if (callback_id) {
         _pad = pad;
         bind_lifecycle(pad);
@@ -24,7 +24,7 @@ gulong GstBufferProbe::add_on(GstElement *element, const gchar *pad_name) {
     GstPad *pad;
     pad = gst_element_get_static_pad(element, pad_name);
     callback_id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
-                                    this->to_callback(), NULL, NULL);
+                                    to_callback(), this, NULL);
     if (callback_id) {
         _pad = pad;
         bind_lifecycle(pad);
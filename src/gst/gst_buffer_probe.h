@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include "std/function_ptr.h"
 
 #include "gst_self_destruct_object.h"
@@ -10,7 +12,7 @@
 class GstBufferProbe : public GstSelfDestructObject {
     GstPad *_pad = NULL;
     gulong callback_id = 0;
-    GstPadProbeCallback callback_func = NULL;
+    std::function<GstPadProbeReturn(GstPad *, GstPadProbeInfo *, gpointer)> callback_func;
 
 public:
     GstBufferProbe() = default;
@@ -19,7 +21,7 @@ public:
 
     template<typename Function>
     inline void set_callback_func(Function &&cb) {
-        callback_func = std::function_ptr<GstPadProbeReturn(GstPad *, GstPadProbeInfo *, gpointer)>(cb);
+        callback_func = std::forward<Function>(cb);
     }
 
     virtual inline GstPadProbeReturn call(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
@@ -32,11 +34,11 @@ public:
         return call(pad, info, user_data);
     }
 
-    inline GstPadProbeCallback to_callback() {
-        return std::function_ptr<GstPadProbeReturn(GstPad *, GstPadProbeInfo *, gpointer)>(
-                [=](GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
-                    return this->call(pad, info, user_data);
-                });
+    /// Probe callback to be added with this as user_data.
+    static inline GstPadProbeCallback to_callback() {
+        return [](GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+            return static_cast<GstBufferProbe *>(user_data)->call(pad, info, NULL);
+        };
     }
 
     gulong add_on(GstPad *pad);
@@ -0,0 +1,134 @@
+#include "gst_detection_meta.h"
+
+#include <gst/video/video.h>
+
+namespace {
+    inline gboolean init_func(GstMeta *meta, gpointer params, GstBuffer *buffer) {
+        auto *detection_meta = (GstDetectionMeta *) meta;
+        detection_meta->pts = GST_CLOCK_TIME_NONE;
+        detection_meta->frame_width = 0;
+        detection_meta->frame_height = 0;
+        detection_meta->detections = g_array_new(FALSE, FALSE, sizeof(GstDetectionMetaEntry));
+        return TRUE;
+    }
+
+    inline gboolean transform_func(GstBuffer *dest_buf,
+                                   GstMeta *src_meta,
+                                   GstBuffer *src_buf,
+                                   GQuark type,
+                                   gpointer data) {
+        auto *src_detection_meta = (GstDetectionMeta *) src_meta;
+        gdouble sx = 1., sy = 1.;
+        gint frame_width = src_detection_meta->frame_width, frame_height = src_detection_meta->frame_height;
+        if (GST_VIDEO_META_TRANSFORM_IS_SCALE(type)) {
+            auto *trans = (GstVideoMetaTransform *) data;
+            // boxes are in the coordinates of the frame they were detected on, which need not
+            // be the size of src_buf, only fall back to the buffer size when it is unknown
+            gint in_width = frame_width > 0 ? frame_width : GST_VIDEO_INFO_WIDTH(trans->in_info);
+            gint in_height = frame_height > 0 ? frame_height : GST_VIDEO_INFO_HEIGHT(trans->in_info);
+            if (in_width > 0 && in_height > 0) {
+                sx = (gdouble) GST_VIDEO_INFO_WIDTH(trans->out_info) / in_width;
+                sy = (gdouble) GST_VIDEO_INFO_HEIGHT(trans->out_info) / in_height;
+            }
+            frame_width = GST_VIDEO_INFO_WIDTH(trans->out_info);
+            frame_height = GST_VIDEO_INFO_HEIGHT(trans->out_info);
+        } else if (!GST_META_TRANSFORM_IS_COPY(type)) {
+            return FALSE;
+        }
+
+        auto *dest_detection_meta = GST_DETECTION_META_ADD(dest_buf);
+        if (!dest_detection_meta)
+            return FALSE;
+        dest_detection_meta->pts = src_detection_meta->pts;
+        dest_detection_meta->frame_width = frame_width;
+        dest_detection_meta->frame_height = frame_height;
+        g_array_append_vals(dest_detection_meta->detections,
+                            src_detection_meta->detections->data, src_detection_meta->detections->len);
+        if (sx != 1. || sy != 1.) {
+            for (guint i = 0; i < dest_detection_meta->detections->len; i++) {
+                auto &det = g_array_index(dest_detection_meta->detections, GstDetectionMetaEntry, i);
+                det.x *= sx;
+                det.y *= sy;
+                det.width *= sx;
+                det.height *= sy;
+            }
+        }
+        return TRUE;
+    }
+
+    inline void free_func(GstMeta *meta, GstBuffer *buffer) {
+        auto *detection_meta = (GstDetectionMeta *) meta;
+        g_array_unref(detection_meta->detections);
+        detection_meta->detections = NULL;
+    }
+}
+
+GType gst_detection_meta_api_get_type() {
+    static GType type;
+    // video and size tags let scaling elements transform the boxes instead of dropping the meta
+    static const gchar *tags[] = {GST_META_TAG_VIDEO_STR, GST_META_TAG_VIDEO_SIZE_STR, NULL};
+    if (g_once_init_enter(&type)) {
+        GType _type = gst_meta_api_type_register("GstDetectionMetaAPI", tags);
+        g_once_init_leave(&type, _type);
+    }
+    return type;
+}
+
+const GstMetaInfo *gst_detection_meta_get_info() {
+    static const GstMetaInfo *meta_info = NULL;
+    if (g_once_init_enter(&meta_info)) {
+        const GstMetaInfo *meta =
+                gst_meta_register(gst_detection_meta_api_get_type(),
+                                  "GstDetectionMeta",
+                                  sizeof(GstDetectionMeta),
+                                  init_func,
+                                  free_func,
+                                  transform_func);
+        g_once_init_leave(&meta_info, meta);
+    }
+    return meta_info;
+}
+
+void GstDetectionResults::set(GstClockTime pts, gint frame_width, gint frame_height,
+                              std::vector<GstDetectionMetaEntry> detections) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pts_ = pts;
+    frame_width_ = frame_width;
+    frame_height_ = frame_height;
+    detections_ = std::move(detections);
+}
+
+void GstDetectionResults::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pts_ = GST_CLOCK_TIME_NONE;
+    frame_width_ = frame_height_ = 0;
+    detections_.clear();
+}
+
+GstDetectionMeta *GstDetectionResults::attach_to(GstBuffer *buf) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!GST_CLOCK_TIME_IS_VALID(pts_))
+        return NULL;
+    auto *detection_meta = GST_DETECTION_META_ADD(buf);
+    if (!detection_meta)
+        return NULL;
+    detection_meta->pts = pts_;
+    detection_meta->frame_width = frame_width_;
+    detection_meta->frame_height = frame_height_;
+    g_array_append_vals(detection_meta->detections, detections_.data(), detections_.size());
+    return detection_meta;
+}
+
+GstDetectionMetaAddProbe::GstDetectionMetaAddProbe(std::shared_ptr<GstDetectionResults> results)
+        : results_(std::move(results)) {}
+
+GstPadProbeReturn GstDetectionMetaAddProbe::call(GstPad *pad, GstPadProbeInfo *info, gpointer) {
+    auto *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!buf || !results_ || gst_buffer_get_detection_meta(buf))
+        return GST_PAD_PROBE_OK;
+    // buffers are usually shared with the other tee branches
+    buf = gst_buffer_make_writable(buf);
+    GST_PAD_PROBE_INFO_DATA(info) = buf;
+    results_->attach_to(buf);
+    return GST_PAD_PROBE_OK;
+}
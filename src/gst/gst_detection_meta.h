@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <gst/gst.h>
+#include <gst/gstmeta.h>
+
+#include "gst_buffer_probe.h"
+
+/**
+ * A detected object, with its box in pixels of the frame it was detected on.
+ */
+typedef struct _GstDetectionMetaEntry {
+    gdouble x, y, width, height;
+    /** Holds the class id of the object. */
+    gint class_id;
+    /** Holds the interned class name, 0 if unknown. */
+    GQuark label;
+    gfloat confidence;
+    /** Holds the id of the track the object belongs to, -1 if untracked. */
+    gint track_id;
+} GstDetectionMetaEntry;
+
+/**
+ * Detection results of a frame, for downstream elements to consume without going
+ * through the application. Boxes follow frame rescaling done by video elements.
+ */
+typedef struct _GstDetectionMeta {
+    GstMeta meta;
+    /** Holds the PTS of the frame the detections were inferred on. */
+    GstClockTime pts;
+    /** Holds the frame size the boxes are expressed in. */
+    gint frame_width;
+    gint frame_height;
+    /** Holds GstDetectionMetaEntry elements. */
+    GArray *detections;
+} GstDetectionMeta;
+
+GType gst_detection_meta_api_get_type();
+
+const GstMetaInfo *gst_detection_meta_get_info();
+
+#define GST_DETECTION_META_ADD(buf) ((GstDetectionMeta *) gst_buffer_add_meta(buf, gst_detection_meta_get_info(), NULL))
+#define GST_DETECTION_META_GET(buf) ((GstDetectionMeta *) gst_buffer_get_meta(buf, gst_detection_meta_api_get_type()))
+#define GST_DETECTION_META_INFO (gst_detection_meta_get_info())
+#define GST_DETECTION_META_API_TYPE (gst_detection_meta_api_get_type())
+
+inline GstDetectionMeta *gst_buffer_get_detection_meta(GstBuffer *buf) {
+    return GST_DETECTION_META_GET(buf);
+}
+
+inline guint gst_detection_meta_size(const GstDetectionMeta *meta) {
+    return meta->detections->len;
+}
+
+inline const GstDetectionMetaEntry *gst_detection_meta_get(const GstDetectionMeta *meta, guint index) {
+    return &g_array_index(meta->detections, GstDetectionMetaEntry, index);
+}
+
+/**
+ * Latest detection results shared between the inference worker, which sets them,
+ * and the probes attaching them to buffers. Thread safe.
+ */
+class GstDetectionResults {
+    mutable std::mutex mutex_;
+    GstClockTime pts_ = GST_CLOCK_TIME_NONE;
+    gint frame_width_ = 0, frame_height_ = 0;
+    std::vector<GstDetectionMetaEntry> detections_;
+
+public:
+    void set(GstClockTime pts, gint frame_width, gint frame_height, std::vector<GstDetectionMetaEntry> detections);
+
+    void clear();
+
+    /// Adds a GstDetectionMeta holding the latest results to a writable buffer,
+    /// returns NULL if no results have been set.
+    GstDetectionMeta *attach_to(GstBuffer *buf) const;
+};
+
+/**
+ * A self destruct callback class that adds the latest detection results to buffers.
+ */
+class GstDetectionMetaAddProbe : public GstBufferProbe {
+    std::shared_ptr<GstDetectionResults> results_;
+
+public:
+    using MetaType = GstDetectionMeta;
+
+    explicit GstDetectionMetaAddProbe(std::shared_ptr<GstDetectionResults> results);
+
+    GstPadProbeReturn call(GstPad *pad, GstPadProbeInfo *info, gpointer) override;
+};
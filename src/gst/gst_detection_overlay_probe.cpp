@@ -0,0 +1,54 @@
+#include "gst_detection_overlay_probe.h"
+
+GstDetectionOverlayProbe::GstDetectionOverlayProbe(std::shared_ptr<GstDetectionResults> results,
+                                                   OsdRasterizerOptions options)
+        : results_(std::move(results)), rasterizer_(options) {
+    gst_video_info_init(&info_);
+}
+
+GstDetectionOverlayProbe::~GstDetectionOverlayProbe() {
+    if (caps_)
+        gst_caps_unref(caps_);
+}
+
+bool GstDetectionOverlayProbe::update_info(GstPad *pad) {
+    auto *caps = gst_pad_get_current_caps(pad);
+    if (!caps)
+        return false;
+    if (caps == caps_) {
+        gst_caps_unref(caps);
+        return supported_;
+    }
+    if (caps_)
+        gst_caps_unref(caps_);
+    caps_ = caps;
+    supported_ = gst_video_info_from_caps(&info_, caps) && OsdRasterizer::supports(GST_VIDEO_INFO_FORMAT(&info_));
+    if (!supported_) {
+        auto *caps_str = gst_caps_to_string(caps);
+        g_printerr("Unsupported caps for detection overlay: %s\n", caps_str);
+        g_free(caps_str);
+    }
+    return supported_;
+}
+
+GstPadProbeReturn GstDetectionOverlayProbe::call(GstPad *pad, GstPadProbeInfo *info, gpointer) {
+    auto *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!buf || !update_info(pad))
+        return GST_PAD_PROBE_OK;
+    // buffers may still be shared with the other tee branches
+    buf = gst_buffer_make_writable(buf);
+    GST_PAD_PROBE_INFO_DATA(info) = buf;
+
+    const GstDetectionMeta *meta = gst_buffer_get_detection_meta(buf);
+    if (!meta && results_)
+        meta = results_->attach_to(buf);
+    if (!meta || !gst_detection_meta_size(meta))
+        return GST_PAD_PROBE_OK;
+
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &info_, buf, GST_MAP_READWRITE))
+        return GST_PAD_PROBE_OK;
+    rasterizer_.draw(&frame, meta);
+    gst_video_frame_unmap(&frame);
+    return GST_PAD_PROBE_OK;
+}
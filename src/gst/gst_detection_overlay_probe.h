@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+
+#include <gst/video/video.h>
+
+#include "gst_buffer_probe.h"
+#include "gst_detection_meta.h"
+#include "utils/osd_rasterizer.h"
+
+/**
+ * A self destruct callback class that burns detections into the raw video buffers
+ * passing a pad, so that recorded or streamed outputs carry the annotations.
+ * Draws the buffer's GstDetectionMeta if it has one, the latest results otherwise.
+ */
+class GstDetectionOverlayProbe : public GstBufferProbe {
+    std::shared_ptr<GstDetectionResults> results_;
+    OsdRasterizer rasterizer_;
+    GstCaps *caps_ = NULL;
+    GstVideoInfo info_;
+    bool supported_ = false;
+
+public:
+    explicit GstDetectionOverlayProbe(std::shared_ptr<GstDetectionResults> results,
+                                      OsdRasterizerOptions options = {});
+
+    ~GstDetectionOverlayProbe() override;
+
+    GstPadProbeReturn call(GstPad *pad, GstPadProbeInfo *info, gpointer) override;
+
+private:
+    bool update_info(GstPad *pad);
+};
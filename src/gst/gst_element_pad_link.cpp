@@ -5,8 +5,8 @@ namespace detail {
             GstElement *element_1, const gchar *pad_1, GstPadType pad_1_type,
             GstElement *element_2, const gchar *pad_2, GstPadType pad_2_type,
             gboolean verbose)
-            : element_1(element_1), pad_1(pad_1), pad_1_type(pad_1_type), pad_1_filter(NULL),
-              element_2(element_2), pad_2(pad_2), pad_2_type(pad_2_type), pad_2_filter(NULL),
+            : element_1(element_1), pad_1(pad_1), pad_1_type(pad_1_type), pad_1_filter(nullptr),
+              element_2(element_2), pad_2(pad_2), pad_2_type(pad_2_type), pad_2_filter(nullptr),
               verbose(verbose) {
         srcpad = gst_element_try_get_pad(element_1, pad_1, pad_1_type);
         sinkpad = gst_element_try_get_pad(element_2, pad_2, pad_2_type);
@@ -57,20 +57,20 @@ namespace detail {
             if (!srcpad) {
                 srcpad_added_handler_id = g_signal_connect(
                         element_1, "pad-added",
-                        this->src_pad_added_callback(),
-                        NULL);
+                        src_pad_added_callback(),
+                        this);
             }
             if (!sinkpad) {
                 sinkpad_added_handler_id = g_signal_connect(
                         element_2, "pad-added",
-                        this->sink_pad_added_callback(),
-                        NULL);
+                        sink_pad_added_callback(),
+                        this);
             }
             return GST_PAD_LINK_OK;
         }
     }
 
-    void GstPadLinker::src_pad_added_handler(GstElement *src, GstPad *new_pad, gpointer) {
+    void GstPadLinker::src_pad_added_handler(GstElement *src, GstPad *new_pad) {
         if (srcpad || (pad_1_filter && !pad_1_filter(new_pad)))
             return;
         srcpad = new_pad;
@@ -83,7 +83,7 @@ namespace detail {
         delete this;
     }
 
-    void GstPadLinker::sink_pad_added_handler(GstElement *src, GstPad *new_pad, gpointer) {
+    void GstPadLinker::sink_pad_added_handler(GstElement *src, GstPad *new_pad) {
         if (sinkpad || pad_2_filter && !pad_2_filter(new_pad))
             return;
         sinkpad = new_pad;
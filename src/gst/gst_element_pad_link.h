@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include <gst/gstpad.h>
 
 #include "gst_element_get_pad.h"
@@ -7,7 +9,7 @@
 #include "std/function_ptr.h"
 
 namespace detail {
-    typedef gboolean (*pad_filter_func)(GstPad *pad);
+    typedef std::function<gboolean(GstPad *pad)> pad_filter_func;
 
     /**
      * Self destruct pad linker class. This will delete itself
@@ -17,7 +19,7 @@ namespace detail {
         GstElement *element_1, *element_2;
         const gchar *pad_1, *pad_2;
         GstPadType pad_1_type, pad_2_type;
-        pad_filter_func pad_1_filter = NULL, pad_2_filter = NULL;
+        pad_filter_func pad_1_filter, pad_2_filter;
         GstPad *srcpad = NULL, *sinkpad = NULL;
         gulong srcpad_added_handler_id = 0, sinkpad_added_handler_id = 0;
         gboolean verbose;
@@ -32,18 +34,13 @@ namespace detail {
 
         ~GstPadLinker();
 
-        inline GCallback src_pad_added_callback() {
-            return G_CALLBACK(std::function_ptr<void(GstElement *, GstPad *, gpointer)>(
-                    [=](GstElement *src, GstPad *new_pad, gpointer u_data) -> void {
-                        this->src_pad_added_handler(src, new_pad, u_data);
-                    }));
+        /// "pad-added" callbacks, to be connected with this as user_data.
+        static inline GCallback src_pad_added_callback() {
+            return G_CALLBACK(std::member_function_ptr<&GstPadLinker::src_pad_added_handler>);
         }
 
-        inline GCallback sink_pad_added_callback() {
-            return G_CALLBACK(std::function_ptr<void(GstElement *, GstPad *, gpointer)>(
-                    [=](GstElement *src, GstPad *new_pad, gpointer u_data) -> void {
-                        this->sink_pad_added_handler(src, new_pad, u_data);
-                    }));
+        static inline GCallback sink_pad_added_callback() {
+            return G_CALLBACK(std::member_function_ptr<&GstPadLinker::sink_pad_added_handler>);
         }
 
         GstPadLinkReturn link();
@@ -53,9 +50,9 @@ namespace detail {
         }
 
     private:
-        void src_pad_added_handler(GstElement *src, GstPad *new_pad, gpointer);
+        void src_pad_added_handler(GstElement *src, GstPad *new_pad);
 
-        void sink_pad_added_handler(GstElement *src, GstPad *new_pad, gpointer);
+        void sink_pad_added_handler(GstElement *src, GstPad *new_pad);
 
         GstPadLinkReturn dynamic_link() const;
     };
@@ -83,8 +80,8 @@ inline GstPadLinkReturn gst_element_pad_link(
         GstElement *element_2, const gchar *pad_2, GstPadType pad_2_type, Pad2Filter pad_2_filter,
         gboolean verbose = false) {
     auto *pad_linker = new detail::GstPadLinker(
-            element_1, pad_1, pad_1_type, std::function_ptr<gboolean(GstPad *new_pad)>(pad_1_filter),
-            element_2, pad_2, pad_2_type, std::function_ptr<gboolean(GstPad *new_pad)>(pad_2_filter),
+            element_1, pad_1, pad_1_type, detail::pad_filter_func(pad_1_filter),
+            element_2, pad_2, pad_2_type, detail::pad_filter_func(pad_2_filter),
             verbose);
     return pad_linker->link();
 }
@@ -9,6 +9,7 @@ namespace {
         frame_meta->duration = GST_CLOCK_TIME_NONE;
         frame_meta->source_frame_width = 0;
         frame_meta->source_frame_height = 0;
+        frame_meta->capture_time = GST_CLOCK_TIME_NONE;
         return TRUE;
     }
 
@@ -27,6 +28,7 @@ namespace {
         dest_frame_meta->duration = src_frame_meta->duration;
         dest_frame_meta->source_frame_width = src_frame_meta->source_frame_width;
         dest_frame_meta->source_frame_height = src_frame_meta->source_frame_height;
+        dest_frame_meta->capture_time = src_frame_meta->capture_time;
         return TRUE;
     }
 
@@ -89,6 +91,7 @@ GstPadProbeReturn GstFrameMetaAddProbe::call(GstPad *pad, GstPadProbeInfo *info,
         frame_meta->duration = GST_BUFFER_DURATION(buf);
         frame_meta->source_frame_width = width;
         frame_meta->source_frame_height = height;
+        frame_meta->capture_time = gst_util_get_timestamp();
     } else {
         // if buf is not writable, just modify it
         buf->offset = frame_count_++;
@@ -24,6 +24,8 @@ typedef struct _GstFrameMeta {
     gint source_frame_width;
     /** Holds the height of the frame. */
     gint source_frame_height;
+    /** Holds the gst_util_get_timestamp() at which the meta was attached, for latency tracing. */
+    GstClockTime capture_time;
 } GstFrameMeta;
 
 GType gst_frame_meta_api_get_type();
@@ -0,0 +1,101 @@
+#include "gst_frame_replay_source.h"
+
+#include <algorithm>
+#include <chrono>
+
+GstFrameReplaySource::GstFrameReplaySource(GstElement *app_src, std::shared_ptr<FrameReplayStore> store,
+                                           GstFrameReplaySourceOptions options)
+        : app_src_(GST_ELEMENT(gst_object_ref(app_src))), store_(std::move(store)), options_(options) {
+    auto *src = GST_APP_SRC(app_src_);
+    gst_app_src_set_caps(src, store_->caps());
+    gst_app_src_set_stream_type(src, GST_APP_STREAM_TYPE_STREAM);
+    gst_app_src_set_max_bytes(src, (guint64) std::max(options_.max_buffers(), 1u) *
+                                   GST_VIDEO_INFO_SIZE(&store_->info()));
+    g_object_set(app_src_,
+                 "format", GST_FORMAT_TIME,
+                 "is-live", FALSE,
+                 "do-timestamp", FALSE,
+                 "block", TRUE,
+                 NULL);
+}
+
+GstFrameReplaySource::~GstFrameReplaySource() {
+    stop();
+    gst_object_unref(app_src_);
+}
+
+void GstFrameReplaySource::start() {
+    if (thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    num_pushed_frames_.store(0, std::memory_order_relaxed);
+    thread_ = std::thread(&GstFrameReplaySource::run, this);
+}
+
+void GstFrameReplaySource::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+bool GstFrameReplaySource::is_running() const noexcept {
+    return thread_.joinable();
+}
+
+const FrameReplayStore &GstFrameReplaySource::store() const noexcept {
+    return *store_;
+}
+
+GstFrameReplaySourceOptions GstFrameReplaySource::options() const noexcept {
+    return options_;
+}
+
+guint64 GstFrameReplaySource::num_pushed_frames() const noexcept {
+    return num_pushed_frames_.load(std::memory_order_relaxed);
+}
+
+void GstFrameReplaySource::run() {
+    auto rate = options_.rate();
+    auto first_pts = store_->pts(0);
+    auto last = store_->size() - 1;
+    // source time of one pass, to offset the timestamps of the next one
+    auto pass_duration = (store_->pts(last) > first_pts ? store_->pts(last) - first_pts : 0) +
+                         store_->duration(last);
+    auto start_time = std::chrono::steady_clock::now();
+
+    GstClockTime pass_offset = 0;
+    do {
+        for (std::size_t i = 0; i <= last; i++) {
+            auto source_time = pass_offset + (store_->pts(i) > first_pts ? store_->pts(i) - first_pts : 0);
+            auto pts = rate > 0 ? (GstClockTime) ((double) source_time / rate) : source_time;
+            auto duration = rate > 0 ? (GstClockTime) ((double) store_->duration(i) / rate) : store_->duration(i);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                auto stopped = rate > 0
+                               ? cond_.wait_until(lock, start_time + std::chrono::nanoseconds(pts),
+                                                  [this]() { return stopping_; })
+                               : stopping_;
+                if (stopped)
+                    return;
+            }
+
+            auto *buf = store_->buffer(i);
+            GST_BUFFER_PTS(buf) = pts;
+            GST_BUFFER_DURATION(buf) = duration;
+            GST_BUFFER_OFFSET(buf) = num_pushed_frames_.load(std::memory_order_relaxed);
+            // blocks while max_buffers are queued, returns FLUSHING once the pipeline stops
+            if (gst_app_src_push_buffer(GST_APP_SRC(app_src_), buf) != GST_FLOW_OK)
+                return;
+            num_pushed_frames_.fetch_add(1, std::memory_order_relaxed);
+        }
+        pass_offset += pass_duration;
+    } while (options_.loop());
+    gst_app_src_end_of_stream(GST_APP_SRC(app_src_));
+}
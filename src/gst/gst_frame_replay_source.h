@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <gst/gst.h>
+#include <gst/app/app.h>
+
+#include "utils/frame_replay_file.h"
+
+class GstFrameReplaySourceOptions {
+public:
+    GstFrameReplaySourceOptions()
+            : rate_(1.),
+              loop_(false),
+              max_buffers_(4) {}
+
+    // setters
+    [[nodiscard]] inline GstFrameReplaySourceOptions rate(double rate) const noexcept {
+        auto r = *this;
+        r.rate_ = rate;
+        return r;
+    }
+
+    [[nodiscard]] inline GstFrameReplaySourceOptions loop(bool loop) const noexcept {
+        auto r = *this;
+        r.loop_ = loop;
+        return r;
+    }
+
+    [[nodiscard]] inline GstFrameReplaySourceOptions max_buffers(guint max_buffers) const noexcept {
+        auto r = *this;
+        r.max_buffers_ = max_buffers;
+        return r;
+    }
+
+    // getters
+    /// 1 replays in real-time, N at N times real-time, 0 (or less) as fast as downstream accepts.
+    [[nodiscard]] inline double rate() const noexcept {
+        return rate_;
+    }
+
+    [[nodiscard]] inline bool loop() const noexcept {
+        return loop_;
+    }
+
+    /// Frames queued in the appsrc before pushing blocks.
+    [[nodiscard]] inline guint max_buffers() const noexcept {
+        return max_buffers_;
+    }
+
+private:
+    double rate_;
+    bool loop_;
+    guint max_buffers_;
+};
+
+/**
+ * Pushes the frames of a FrameReplayStore into an appsrc from its own thread, paced by a
+ * steady clock at the configured rate, so that runs see the same frames at the same times
+ * without decoder or capture jitter. Timestamps are rebased to start at 0 and divided by
+ * the rate, sinks should not sync when replaying as fast as possible.
+ * Frames are pushed without copies and end with EOS unless looping.
+ */
+class GstFrameReplaySource {
+    GstElement *app_src_;
+    std::shared_ptr<FrameReplayStore> store_;
+    GstFrameReplaySourceOptions options_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopping_ = false;
+    std::atomic<guint64> num_pushed_frames_{0};
+
+    void run();
+
+public:
+    GstFrameReplaySource(GstElement *app_src, std::shared_ptr<FrameReplayStore> store,
+                         GstFrameReplaySourceOptions options = {});
+
+    GstFrameReplaySource(const GstFrameReplaySource &) = delete;
+
+    GstFrameReplaySource &operator=(const GstFrameReplaySource &) = delete;
+
+    ~GstFrameReplaySource();
+
+    /// Starts replaying from the first frame, no-op if already running.
+    void start();
+
+    /// Returns once the pushing thread exited, the appsrc must be flushing or not blocked.
+    void stop();
+
+    [[nodiscard]] bool is_running() const noexcept;
+
+    [[nodiscard]] const FrameReplayStore &store() const noexcept;
+
+    [[nodiscard]] GstFrameReplaySourceOptions options() const noexcept;
+
+    [[nodiscard]] guint64 num_pushed_frames() const noexcept;
+};
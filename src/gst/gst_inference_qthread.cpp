@@ -2,12 +2,13 @@
 
 #include <QTimer>
 
+#include "utils/latency_tracer.h"
+
 GstInferenceWorker::GstInferenceWorker(GstElement *app_sink, GstElement *app_src, GstVideoFormat format,
                                        QObject *parent)
         : QObject(parent), format_(format) {
     set_app_sink(app_sink);
     set_app_src(app_src);
-    unpaused_event_.set();
 }
 
 GstInferenceWorker::GstInferenceWorker(GstElement *app_sink, GstVideoFormat format, QObject *parent)
@@ -16,17 +17,66 @@ GstInferenceWorker::GstInferenceWorker(GstElement *app_sink, GstVideoFormat form
 GstInferenceWorker::~GstInferenceWorker() {
     if (!is_stopped())
         on_stopped();
+    disconnect_app_sink_cb();
+    clear_sample_ring();
 }
 
 void GstInferenceWorker::set_app_sink(GstElement *app_sink) {
     if (app_sink && !GST_IS_APP_SINK(app_sink))
         g_error("sink is not an appsink");
     QMutexLocker lock(&mutex_);
+    disconnect_app_sink_cb();
     app_sink_ = app_sink;
-    if (app_sink_)
-        app_sink_set_event_.set();
+    state_.assign(WORKER_STATE_AppSinkSet, app_sink_ != nullptr);
+    connect_app_sink_cb();
+}
+
+void GstInferenceWorker::connect_app_sink_cb() {
+    if (app_sink_ && sample_ring_) {
+        GstAppSinkCallbacks callbacks{};
+        callbacks.new_sample = [](GstAppSink *app_sink, gpointer user_data) -> GstFlowReturn {
+            auto *ring = static_cast<std::blocking_spsc_ring_buffer<GstSample *> *>(user_data);
+            GstSample *sample = gst_app_sink_pull_sample(app_sink);
+            if (!sample)
+                return GST_FLOW_OK;
+            if (auto dropped = ring->push(sample))
+                gst_sample_unref(dropped.value());
+            return GST_FLOW_OK;
+        };
+        gst_app_sink_set_callbacks(GST_APP_SINK(app_sink_), &callbacks, sample_ring_.get(), NULL);
+    }
+}
+
+void GstInferenceWorker::disconnect_app_sink_cb() {
+    if (app_sink_ && sample_ring_) {
+        GstAppSinkCallbacks callbacks{};
+        gst_app_sink_set_callbacks(GST_APP_SINK(app_sink_), &callbacks, NULL, NULL);
+    }
+}
+
+void GstInferenceWorker::set_sample_ring_size(std::size_t size) {
+    QMutexLocker lock(&mutex_);
+    disconnect_app_sink_cb();
+    clear_sample_ring();
+    if (size)
+        sample_ring_ = std::make_unique<std::blocking_spsc_ring_buffer<GstSample *>>(size);
     else
-        app_sink_set_event_.clear();
+        sample_ring_.reset();
+    connect_app_sink_cb();
+}
+
+void GstInferenceWorker::clear_sample_ring() {
+    if (sample_ring_) {
+        while (auto sample = sample_ring_->try_pop())
+            gst_sample_unref(sample.value());
+    }
+}
+
+GstSample *GstInferenceWorker::pull_sample() {
+    if (sample_ring_)
+        return sample_ring_->pop_for(std::chrono::nanoseconds(pull_sample_timeout_)).value_or(NULL);
+    QMutexLocker lock(&mutex_);
+    return gst_app_sink_try_pull_sample(GST_APP_SINK(app_sink_), pull_sample_timeout_);
 }
 
 void GstInferenceWorker::set_app_src(GstElement *app_src) {
@@ -35,35 +85,29 @@ void GstInferenceWorker::set_app_src(GstElement *app_src) {
     QMutexLocker lock(&mutex_);
     disconnect_app_src_cb();
     app_src_ = app_src;
-    if (app_src_)
-        app_src_set_event_.set();
-    else
-        app_src_set_event_.clear();
+    state_.assign(WORKER_STATE_AppSrcSet, app_src_ != nullptr);
     connect_app_src_cb();
 }
 
 void GstInferenceWorker::connect_app_src_cb() {
-    if (app_src_set_event_.isSet()) {
+    if (has_src()) {
         QMutexLocker lock(&mutex_);
         gboolean app_src_emit_signals;
         g_object_get(G_OBJECT(app_src_), "emit-signals", &app_src_emit_signals, NULL);
         if (app_src_emit_signals) {
+            // this as user_data, so that every instance gets its own callbacks
             app_src_cb_handlers_[0] = g_signal_connect(
-                    app_src_, "need-data", G_CALLBACK(std::function_ptr<void(GstElement *, guint, gpointer)>(
-                    [this](GstElement *pipeline, guint size, gpointer user_data) {
-                        app_src_need_data_event_.set();
-                    })), NULL);
+                    app_src_, "need-data",
+                    G_CALLBACK(std::member_function_ptr<&GstInferenceWorker::on_app_src_need_data>), this);
             app_src_cb_handlers_[1] = g_signal_connect(
-                    app_src_, "enough-data", G_CALLBACK(std::function_ptr<void(GstElement *, guint, gpointer)>(
-                    [this](GstElement *pipeline, guint size, gpointer user_data) {
-                        app_src_need_data_event_.clear();
-                    })), NULL);
+                    app_src_, "enough-data",
+                    G_CALLBACK(std::member_function_ptr<&GstInferenceWorker::on_app_src_enough_data>), this);
         }
     }
 }
 
 void GstInferenceWorker::disconnect_app_src_cb() {
-    if (app_src_set_event_.isSet()) {
+    if (has_src()) {
         QMutexLocker lock(&mutex_);
         for (auto &app_src_cb_handler: app_src_cb_handlers_) {
             if (app_src_cb_handler) {
@@ -74,6 +118,14 @@ void GstInferenceWorker::disconnect_app_src_cb() {
     }
 }
 
+void GstInferenceWorker::on_app_src_need_data(GstAppSrc *, guint) {
+    state_.set(WORKER_STATE_AppSrcNeedData);
+}
+
+void GstInferenceWorker::on_app_src_enough_data(GstAppSrc *) {
+    state_.clear(WORKER_STATE_AppSrcNeedData);
+}
+
 void GstInferenceWorker::set_format(GstVideoFormat format) {
     format_ = format;
 }
@@ -82,56 +134,96 @@ void GstInferenceWorker::set_pull_sample_timeout(GstClockTime timeout) {
     pull_sample_timeout_ = timeout;
 }
 
+void GstInferenceWorker::set_cpu_affinity(const std::vector<int> &cpus) {
+    QMutexLocker lock(&mutex_);
+    cpu_affinity_ = cpus;
+}
+
+std::vector<int> GstInferenceWorker::cpu_affinity() {
+    QMutexLocker lock(&mutex_);
+    return cpu_affinity_;
+}
+
 unsigned long GstInferenceWorker::num_processed_samples() const {
     return num_processed_samples_;
 }
 
+void GstInferenceWorker::set_frame_gate_options(FrameDifferenceGateOptions options) {
+    QMutexLocker lock(&mutex_);
+    frame_gate_options_ = options;
+    state_.set(WORKER_STATE_FrameGateOptionsChanged);
+}
+
+FrameDifferenceGateOptions GstInferenceWorker::frame_gate_options() {
+    QMutexLocker lock(&mutex_);
+    return frame_gate_options_;
+}
+
+unsigned long GstInferenceWorker::num_gated_samples() const {
+    return frame_gate_.num_hits();
+}
+
+double GstInferenceWorker::frame_gate_hit_rate() const {
+    return frame_gate_.hit_rate();
+}
+
+void GstInferenceWorker::reset_frame_gate() {
+    state_.set(WORKER_STATE_FrameGateResetRequested);
+}
+
+void GstInferenceWorker::apply_frame_gate_changes() {
+    QMutexLocker lock(&mutex_);
+    if (state_.test(WORKER_STATE_FrameGateOptionsChanged)) {
+        state_.clear(WORKER_STATE_FrameGateOptionsChanged);
+        frame_gate_.set_options(frame_gate_options_);
+        state_.assign(WORKER_STATE_FrameGateEnabled, frame_gate_options_.enabled());
+    }
+    if (state_.test(WORKER_STATE_FrameGateResetRequested)) {
+        state_.clear(WORKER_STATE_FrameGateResetRequested);
+        frame_gate_.reset();
+    }
+}
+
 bool GstInferenceWorker::has_sink() {
-    return app_sink_set_event_.isSet();
+    return state_.test(WORKER_STATE_AppSinkSet);
 }
 
 bool GstInferenceWorker::has_src() {
-    return app_src_set_event_.isSet();
+    return state_.test(WORKER_STATE_AppSrcSet);
 }
 
 bool GstInferenceWorker::is_started() {
-    return started_event_.isSet();
+    return state_.test(WORKER_STATE_Started);
 }
 
 void GstInferenceWorker::on_started() {
-    started_event_.set();
+    state_.set(WORKER_STATE_Started);
     QMetaObject::invokeMethod(qobject_cast<GstInferenceWorker *>(this), &GstInferenceWorker::run, Qt::DirectConnection);
 }
 
 bool GstInferenceWorker::is_paused() {
-    return !unpaused_event_.isSet();
+    return !state_.test(WORKER_STATE_Unpaused);
 }
 
 void GstInferenceWorker::on_paused(bool state) {
-    if (state)
-        unpaused_event_.clear();
-    else
-        unpaused_event_.set();
+    state_.assign(WORKER_STATE_Unpaused, !state);
 }
 
 void GstInferenceWorker::on_pause_toggled() {
-    if (!unpaused_event_.isSet())
-        unpaused_event_.set();
-    else
-        unpaused_event_.clear();
+    state_.toggle(WORKER_STATE_Unpaused);
 }
 
 bool GstInferenceWorker::is_stopped() {
-    return stopped_event_.isSet();
+    return state_.test(WORKER_STATE_Stopped);
 }
 
 void GstInferenceWorker::on_stopped() {
-    stopped_event_.set();
-    unpaused_event_.set();
-    app_sink_set_event_.set();
     disconnect_app_src_cb();
-    app_src_need_data_event_.set();
-    started_event_.set();
+    // release every wait of run() at once
+    state_.set(WORKER_STATE_Stopped | WORKER_STATE_Unpaused | WORKER_STATE_AppSinkSet |
+               WORKER_STATE_AppSrcNeedData | WORKER_STATE_Started);
+    if (sample_ring_)
+        sample_ring_->close();
     disconnect();
 }
 
@@ -139,55 +231,84 @@ bool GstInferenceWorker::should_abort() {
     return is_stopped() || QThread::currentThread()->isInterruptionRequested();
 }
 
+void GstInferenceWorker::process_sample(GstSample *sample) {
+    auto infer_sample = GstInferenceSample(sample).to(format_);
+    if (!infer_sample.map_successful())
+        return;
+    LatencyTracer::trace(LatencyTracer::STAGE_AppSinkPull, infer_sample.capture_time());
+    bool gated = false;
+    cv::Point2d shift;
+    // the mutex is only taken when options changed or a reset was requested
+    auto state = state_.load();
+    if (state & (WORKER_STATE_FrameGateOptionsChanged | WORKER_STATE_FrameGateResetRequested)) {
+        apply_frame_gate_changes();
+        state = state_.load();
+    }
+    if (state & WORKER_STATE_FrameGateEnabled) {
+        gated = frame_gate_.test(infer_sample.get_image());
+        shift = frame_gate_.shift();
+    }
+    auto out_infer_sample = gated ? reuse(infer_sample, shift) : forward(infer_sample);
+    num_processed_samples_++;
+    if (has_src()) {
+        if (!out_infer_sample.has_value()) {
+            g_printerr("forward doesn't return anything to push to appsrc\n");
+            return;
+        }
+        if (out_infer_sample->caps())
+            gst_app_src_set_caps(GST_APP_SRC(app_src_), out_infer_sample->caps());
+        GstBuffer *out_buf = out_infer_sample->buffer();
+        if (out_buf) {
+            // samples made with from_tensor()/from_mat() already carry the input metadata
+            if (gst_buffer_is_writable(out_buf) && !GST_BUFFER_PTS_IS_VALID(out_buf))
+                gst_buffer_copy_into(out_buf, infer_sample.buffer(), GST_BUFFER_COPY_METADATA, 0, 0);
+            out_buf->dts = GST_CLOCK_TIME_NONE;
+            {
+                QMutexLocker lock(&mutex_);
+                if (gst_app_src_push_sample(GST_APP_SRC(app_src_), out_infer_sample->sample()) != GST_FLOW_OK)
+                    g_printerr("Failed to push sample to appsrc\n");
+            }
+        }
+    }
+}
+
 void GstInferenceWorker::run() {
-    started_event_.wait();
+    state_.wait(WORKER_STATE_Started);
+    if (auto cpus = cpu_affinity(); !cpus.empty()) {
+        if (!std::set_current_thread_affinity(cpus))
+            g_printerr("Failed to set inference thread affinity\n");
+        std::set_current_thread_numa_local();
+    }
     if (!should_abort())
         setup();
     while (true) {
-        unpaused_event_.wait();
-        app_sink_set_event_.wait();
-        if (app_src_set_event_.isSet() && app_src_cb_handlers_[0])
-            app_src_need_data_event_.wait();
+        auto ready_mask = WORKER_STATE_Unpaused | WORKER_STATE_AppSinkSet;
+        if (has_src() && app_src_cb_handlers_[0])
+            ready_mask |= WORKER_STATE_AppSrcNeedData;
+        state_.wait(ready_mask);
         if (should_abort())
             break;
         update();
-        GstSample *sample = NULL;
-        {
-            QMutexLocker lock(&mutex_);
-            sample = gst_app_sink_try_pull_sample(GST_APP_SINK(app_sink_), pull_sample_timeout_);
-        }
+        GstSample *sample = pull_sample();
         if (sample) {
-            auto infer_sample = GstInferenceSample(sample).to(format_);
-            if (!infer_sample.map_successful())
-                continue;
-            auto out_infer_sample = forward(infer_sample);
-            num_processed_samples_++;
-            if (app_src_set_event_.isSet()) {
-                if (!out_infer_sample.has_value()) {
-                    g_printerr("forward doesn't return anything to push to appsrc\n");
-                    continue;
-                }
-                if (out_infer_sample->caps())
-                    gst_app_src_set_caps(GST_APP_SRC(app_src_), out_infer_sample->caps());
-                GstBuffer *out_buf = out_infer_sample->buffer();
-                if (out_buf) {
-                    if (gst_buffer_is_writable(out_buf))
-                        gst_buffer_copy_into(out_buf, infer_sample.buffer(), GST_BUFFER_COPY_METADATA, 0, 0);
-                    out_buf->dts = GST_CLOCK_TIME_NONE;
-                    {
-                        QMutexLocker lock(&mutex_);
-                        if (gst_app_src_push_sample(GST_APP_SRC(app_src_), out_infer_sample->sample()) != GST_FLOW_OK)
-                            g_printerr("Failed to push sample to appsrc\n");
-                    }
+            process_sample(sample);
+        } else if (gst_app_sink_is_eos(GST_APP_SINK(app_sink_))) {
+            // pop_for() may have timed out right before the last samples were pushed to the ring,
+            // appsink only reports eos once its new-sample callbacks have returned
+            if (sample_ring_) {
+                while (!should_abort()) {
+                    auto last_sample = sample_ring_->try_pop();
+                    if (!last_sample)
+                        break;
+                    process_sample(last_sample.value());
                 }
             }
-        } else if (gst_app_sink_is_eos(GST_APP_SINK(app_sink_))) {
-            unpaused_event_.clear();
-            if (app_src_set_event_.isSet()) {
+            state_.clear(WORKER_STATE_Unpaused);
+            if (has_src()) {
                 QMutexLocker lock(&mutex_);
                 gst_app_src_end_of_stream(GST_APP_SRC(app_src_));
-                emit eos();
             }
+            emit eos();
         }
     }
     cleanup();
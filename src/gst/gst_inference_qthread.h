@@ -9,10 +9,15 @@
 
 #include <opencv2/core.hpp>
 
-#include "std/threading/event.h"
+#include "std/threading/affinity.h"
+#include "std/function_ptr.h"
+#include "std/threading/event_flags.h"
+#include "std/threading/spsc_ring_buffer.h"
 #include "std/exception.h"
 
+#include "gst_buffer.h"
 #include "gst_inference_sample.h"
+#include "utils/frame_difference_gate.h"
 
 #include <QException>
 #include <QImage>
@@ -20,11 +25,23 @@
 #include <QMutexLocker>
 #include <QThread>
 #include <QSharedPointer>
-#include "qt/threading/Event"
 
 class GstInferenceWorker : public QObject {
 Q_OBJECT
 protected:
+    enum WorkerStateFlag : std::event_flags::mask_type {
+        WORKER_STATE_Started = 1 << 0,
+        WORKER_STATE_Unpaused = 1 << 1,
+        WORKER_STATE_Stopped = 1 << 2,
+        WORKER_STATE_AppSinkSet = 1 << 3,
+        WORKER_STATE_AppSrcSet = 1 << 4,
+        WORKER_STATE_AppSrcNeedData = 1 << 5,
+        WORKER_STATE_FrameGateEnabled = 1 << 6,
+        // frame_gate_options_ or a reset are pending, applied by run() before the next sample
+        WORKER_STATE_FrameGateOptionsChanged = 1 << 7,
+        WORKER_STATE_FrameGateResetRequested = 1 << 8,
+    };
+
     GstElement *app_sink_ = nullptr;
     GstElement *app_src_ = nullptr;
     std::array<gulong, 3> app_src_cb_handlers_ = {0, 0, 0};
@@ -32,13 +49,16 @@ protected:
     unsigned long num_processed_samples_ = 0;
 
     QRecursiveMutex mutex_;
-    Event app_sink_set_event_{};
-    Event app_src_set_event_{};
-    Event app_src_need_data_event_{};
-    Event started_event_{};
-    Event unpaused_event_{};
-    Event stopped_event_{};
+    // polled by run() on every sample, a single load when nothing has to wait
+    std::event_flags state_{WORKER_STATE_Unpaused};
     GstClockTime pull_sample_timeout_ = 100000000;
+    std::unique_ptr<std::blocking_spsc_ring_buffer<GstSample *>> sample_ring_;
+    // only used by run(), options are handed over through frame_gate_options_
+    FrameDifferenceGate frame_gate_;
+    FrameDifferenceGateOptions frame_gate_options_;
+    std::vector<int> cpu_affinity_;
+    // for forward() implementations that copy their output frames, see GstInferenceSample::copy_from_mat()
+    GstFrameBufferPool output_pool_;
 
 public:
     explicit GstInferenceWorker(
@@ -57,8 +77,34 @@ public:
 
     void set_pull_sample_timeout(GstClockTime timeout);
 
+    /**
+     * Hand samples over from the appsink streaming thread through a lock-free ring
+     * of the given size instead of pulling them from the appsink in the worker.
+     * The oldest sample is dropped when the ring is full. 0 disables the ring.
+     * Must be called before the thread is started.
+     */
+    void set_sample_ring_size(std::size_t size);
+
+    /**
+     * Pin the worker thread to the given cores and make it allocate NUMA-local memory.
+     * Applied when the thread starts running, before setup(). Empty leaves it unpinned.
+     */
+    void set_cpu_affinity(const std::vector<int> &cpus);
+
+    [[nodiscard]] std::vector<int> cpu_affinity();
+
     [[nodiscard]] unsigned long num_processed_samples() const;
 
+    /// Results of the last inferred sample are reused for near-static samples,
+    /// see reuse(). Disabled by default.
+    void set_frame_gate_options(FrameDifferenceGateOptions options);
+
+    [[nodiscard]] FrameDifferenceGateOptions frame_gate_options();
+
+    [[nodiscard]] unsigned long num_gated_samples() const;
+
+    [[nodiscard]] double frame_gate_hit_rate() const;
+
     bool has_sink();
 
     bool has_src();
@@ -71,6 +117,7 @@ public:
 
 signals:
 
+    /// Every sample before the end of stream of the appsink has been processed.
     void eos();
 
     void finished();
@@ -92,9 +139,28 @@ private:
 
     void disconnect_app_src_cb();
 
+    void on_app_src_need_data(GstAppSrc *app_src, guint length);
+
+    void on_app_src_enough_data(GstAppSrc *app_src);
+
+    void connect_app_sink_cb();
+
+    void disconnect_app_sink_cb();
+
+    void clear_sample_ring();
+
+    GstSample *pull_sample();
+
+    void process_sample(GstSample *sample);
+
+    void apply_frame_gate_changes();
+
 protected:
     bool should_abort();
 
+    /// Forces the next sample to be inferred, e.g. after the model has changed.
+    void reset_frame_gate();
+
     // these methods are to be implemented by subclasses
     virtual void setup() {
     }
@@ -106,6 +172,13 @@ protected:
         throw std::not_implemented_error();
     }
 
+    /// Called instead of forward() for samples the frame gate considers static,
+    /// shift is the estimated translation since the last inferred sample.
+    /// Subclasses supporting the frame gate should re-emit their previous results.
+    virtual std::optional<GstInferenceSample> reuse(const GstInferenceSample &sample, const cv::Point2d &shift) {
+        return forward(sample);
+    }
+
     virtual void cleanup() {
     }
 };
@@ -1,11 +1,25 @@
 #include "gst_inference_sample.h"
 
 #include <gst/video/video-converter.h>
+#include <gst/video/gstvideometa.h>
 
-#include "std/function_ptr.h"
-
+#include "gst_buffer.h"
 #include "utils/video_format.h"
 
+namespace {
+    /// Copies the metas of src to dest, except the video meta as dest describes its own layout.
+    inline void copy_metas_except_video(GstBuffer *dest, GstBuffer *src) {
+        gpointer state = NULL;
+        GstMeta *meta;
+        while ((meta = gst_buffer_iterate_meta(src, &state))) {
+            if (meta->info->api == GST_VIDEO_META_API_TYPE || !meta->info->transform_func)
+                continue;
+            GstMetaTransformCopy copy_data = {FALSE, 0, (gsize) -1};
+            meta->info->transform_func(dest, meta, src, _gst_meta_transform_copy, &copy_data);
+        }
+    }
+}
+
 GstInferenceSample::GstInferenceSample(GstSample *sample, gboolean unref)
         : sample_(sample), unref_(unref) {
     if (sample_) {
@@ -119,6 +133,12 @@ gint GstInferenceSample::source_height() const {
     return frame_meta_->source_frame_height;
 }
 
+GstClockTime GstInferenceSample::capture_time() const noexcept {
+    if (frame_meta_)
+        return frame_meta_->capture_time;
+    return GST_CLOCK_TIME_NONE;
+}
+
 GstInferenceSample GstInferenceSample::to(GstCaps *to_caps) const {
     if (!sample_)
         return *this;
@@ -159,10 +179,11 @@ cv::Mat GstInferenceSample::get_image() const {
 QImage GstInferenceSample::get_qimage() const {
     if (map_successful()) {
         gst_sample_ref(sample_);
+        // the image keeps its own reference to the sample, independent of this object
         auto img = QImage((unsigned char *) data(), width_, height_, gst_video_format_to_qimage_format(format_),
-                          std::function_ptr<void(void *)>([this](void *data) {
-                              gst_sample_unref(sample_);
-                          }));
+                          [](void *sample) {
+                              gst_sample_unref(GST_SAMPLE(sample));
+                          }, sample_);
         return img;
     }
     return {};
@@ -190,11 +211,76 @@ at::Tensor GstInferenceSample::get_tensor() const {
         gst_sample_ref(sample_);
         // TODO: strides
         auto tensor = at::from_blob((unsigned char *) data(), {height_, width_, channels}, {},
-                                    std::function_ptr<void(void *)>([this](void *data) {
-                                        gst_sample_unref(sample_);
-                                    }),
+                                    [sample = sample_](void *) {
+                                        gst_sample_unref(sample);
+                                    },
                                     at::TensorOptions().dtype(at::kChar));
         return tensor;
     }
     return {};
 }
+
+GstInferenceSample GstInferenceSample::from_tensor(const at::Tensor &tensor,
+                                                   GstVideoFormat format,
+                                                   const GstInferenceSample &like) {
+    auto *buf = gst_buffer_new_wrapped_tensor(tensor, format);
+    return from_buffer(buf, (gint) tensor.size(1), (gint) tensor.size(0), format, like);
+}
+
+GstInferenceSample GstInferenceSample::from_mat(const cv::Mat &mat,
+                                                GstVideoFormat format,
+                                                const GstInferenceSample &like) {
+    auto *buf = gst_buffer_new_wrapped_mat(mat, format);
+    return from_buffer(buf, mat.cols, mat.rows, format, like);
+}
+
+GstInferenceSample GstInferenceSample::copy_from_mat(const cv::Mat &mat,
+                                                     GstVideoFormat format,
+                                                     GstFrameBufferPool &pool,
+                                                     const GstInferenceSample &like) {
+    auto *buf = pool.copy_from_mat(mat, format);
+    if (!buf)
+        return {};
+    return from_buffer(buf, mat.cols, mat.rows, format, like);
+}
+
+GstInferenceSample GstInferenceSample::copy_from_tensor(const at::Tensor &tensor,
+                                                        GstVideoFormat format,
+                                                        GstFrameBufferPool &pool,
+                                                        const GstInferenceSample &like) {
+    TORCH_CHECK(tensor.scalar_type() == at::kByte && (tensor.dim() == 2 || tensor.dim() == 3),
+                "expected a uint8 HW or HWC tensor, got ", tensor.scalar_type(), " ", tensor.sizes());
+    auto channels = tensor.dim() == 2 ? 1 : tensor.size(2);
+    TORCH_CHECK(channels == GST_VIDEO_FORMAT_INFO_PSTRIDE(gst_video_format_get_info(format), 0),
+                "a tensor of ", channels, " channels cannot be copied as ", gst_video_format_to_string(format));
+    auto cpu_tensor = tensor.to(at::kCPU).contiguous();
+    auto *buf = pool.copy_from_contiguous(cpu_tensor.data_ptr(), (gint) cpu_tensor.size(1),
+                                          (gint) cpu_tensor.size(0), format);
+    if (!buf)
+        return {};
+    return from_buffer(buf, (gint) cpu_tensor.size(1), (gint) cpu_tensor.size(0), format, like);
+}
+
+GstInferenceSample GstInferenceSample::from_buffer(GstBuffer *buf, gint width, gint height, GstVideoFormat format,
+                                                   const GstInferenceSample &like) {
+    GstCaps *caps;
+    if (like.sample()) {
+        gst_buffer_copy_into(buf, like.buffer(),
+                             (GstBufferCopyFlags) (GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
+        copy_metas_except_video(buf, like.buffer());
+        caps = gst_caps_copy(like.caps());
+        gst_caps_set_simple(caps,
+                            "format", G_TYPE_STRING, gst_video_format_to_string(format),
+                            "width", G_TYPE_INT, width,
+                            "height", G_TYPE_INT, height,
+                            NULL);
+    } else {
+        GstVideoInfo info;
+        gst_video_info_set_format(&info, format, width, height);
+        caps = gst_video_info_to_caps(&info);
+    }
+    auto sample = GstInferenceSample(buf, caps, like.sample() ? like.segment() : NULL, NULL);
+    gst_caps_unref(caps);
+    gst_buffer_unref(buf);
+    return sample;
+}
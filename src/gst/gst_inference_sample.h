@@ -15,6 +15,8 @@
 
 #define slots Q_SLOTS
 
+class GstFrameBufferPool;
+
 class GstInferenceSample {
     GstSample *sample_ = NULL;
     gboolean unref_ = TRUE;
@@ -72,6 +74,9 @@ public:
 
     [[nodiscard]] gint source_height() const;
 
+    /// Time the frame was stamped by GstFrameMetaAddProbe, GST_CLOCK_TIME_NONE if it has no GstFrameMeta.
+    [[nodiscard]] GstClockTime capture_time() const noexcept;
+
     [[nodiscard]] GstInferenceSample to(GstCaps *to_caps) const;
 
     [[nodiscard]] GstInferenceSample to(GstVideoFormat format) const;
@@ -81,6 +86,43 @@ public:
     [[nodiscard]] QImage get_qimage() const;
 
     [[nodiscard]] at::Tensor get_tensor() const;
+
+    /**
+     * Output sample sharing the storage of a uint8 HW or HWC cpu tensor, which the
+     * buffer keeps alive until it is released downstream. Rows may be padded, the
+     * strides are described by a GstVideoMeta.
+     * Timestamps, flags and metas (including GstFrameMeta) are copied from like,
+     * as are its caps and segment with the new format and size.
+     */
+    [[nodiscard]] static GstInferenceSample from_tensor(const at::Tensor &tensor,
+                                                        GstVideoFormat format,
+                                                        const GstInferenceSample &like = {});
+
+    /// Same as from_tensor() for a cv::Mat of any step.
+    [[nodiscard]] static GstInferenceSample from_mat(const cv::Mat &mat,
+                                                     GstVideoFormat format,
+                                                     const GstInferenceSample &like = {});
+
+    /**
+     * Output sample holding a copy of mat in a buffer of pool, for producers that overwrite
+     * their storage with the next frame and so cannot hand it over with from_mat().
+     * Metadata is taken from like as in from_tensor(). Empty if the pool has no buffer.
+     */
+    [[nodiscard]] static GstInferenceSample copy_from_mat(const cv::Mat &mat,
+                                                          GstVideoFormat format,
+                                                          GstFrameBufferPool &pool,
+                                                          const GstInferenceSample &like = {});
+
+    /// Same as copy_from_mat() for a uint8 HW or HWC tensor on any device.
+    [[nodiscard]] static GstInferenceSample copy_from_tensor(const at::Tensor &tensor,
+                                                             GstVideoFormat format,
+                                                             GstFrameBufferPool &pool,
+                                                             const GstInferenceSample &like = {});
+
+private:
+    /// Wraps buf (transfer full) with the metadata of like.
+    static GstInferenceSample from_buffer(GstBuffer *buf, gint width, gint height, GstVideoFormat format,
+                                          const GstInferenceSample &like);
 };
 
 Q_DECLARE_METATYPE(GstInferenceSample)
@@ -73,16 +73,13 @@ void GstInferenceThread::connect_app_src_cb() {
         gboolean app_src_emit_signals;
         g_object_get(G_OBJECT(app_src_), "emit-signals", &app_src_emit_signals, NULL);
         if (app_src_emit_signals) {
+            // this as user_data, so that every instance gets its own callbacks
             app_src_cb_handlers_[0] = g_signal_connect(
-                    app_src_, "need-data", G_CALLBACK(std::function_ptr<void(GstElement *, guint, gpointer)>(
-                    [this](GstElement *pipeline, guint size, gpointer user_data) {
-                        app_src_need_data_event_.set();
-                    })), NULL);
+                    app_src_, "need-data",
+                    G_CALLBACK(std::member_function_ptr<&GstInferenceThread::on_app_src_need_data>), this);
             app_src_cb_handlers_[1] = g_signal_connect(
-                    app_src_, "enough-data", G_CALLBACK(std::function_ptr<void(GstElement *, guint, gpointer)>(
-                    [this](GstElement *pipeline, guint size, gpointer user_data) {
-                        app_src_need_data_event_.clear();
-                    })), NULL);
+                    app_src_, "enough-data",
+                    G_CALLBACK(std::member_function_ptr<&GstInferenceThread::on_app_src_enough_data>), this);
         }
     }
 }
@@ -99,6 +96,14 @@ void GstInferenceThread::disconnect_app_src_cb() {
     }
 }
 
+void GstInferenceThread::on_app_src_need_data(GstAppSrc *, guint) {
+    app_src_need_data_event_.set();
+}
+
+void GstInferenceThread::on_app_src_enough_data(GstAppSrc *) {
+    app_src_need_data_event_.clear();
+}
+
 void GstInferenceThread::set_format(GstVideoFormat format) {
     format_ = format;
 }
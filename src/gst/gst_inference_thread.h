@@ -9,6 +9,7 @@
 
 #include <opencv2/core.hpp>
 
+#include "std/function_ptr.h"
 #include "std/threading/event.h"
 #include "std/exception.h"
 
@@ -83,6 +84,10 @@ private:
 
     void disconnect_app_src_cb();
 
+    void on_app_src_need_data(GstAppSrc *app_src, guint length);
+
+    void on_app_src_enough_data(GstAppSrc *app_src);
+
 protected:
     // these methods are to be implemented by subclasses
     virtual void setup() {
@@ -47,6 +47,11 @@
 //    };
 //}
 
+/**
+ * Add a probe calling cb(pad, info, user_data) on a static pad of element.
+ * cb is copied into the probe, so that several probes with the same callback type
+ * keep their own captures. destroy_data is called on user_data when the probe is removed.
+ */
 template<typename Callback_Type>
 gulong gst_element_pad_add_probe(
         GstElement *element,
@@ -55,17 +60,31 @@ gulong gst_element_pad_add_probe(
         Callback_Type &&cb,
         gpointer user_data = NULL,
         GDestroyNotify destroy_data = NULL) {
+    struct probe_data {
+        std::decay_t<Callback_Type> cb;
+        gpointer user_data;
+        GDestroyNotify destroy_data;
+
+        ~probe_data() {
+            if (destroy_data)
+                destroy_data(user_data);
+        }
+    };
     GstPad *pad;
     pad = gst_element_get_static_pad(element, padname);
     auto id = gst_pad_add_probe(
             pad, mask,
-            std::function_ptr<GstPadProbeReturn(GstPad *, GstPadProbeInfo *, gpointer)>(cb),
-            user_data, destroy_data);
+            [](GstPad *pad, GstPadProbeInfo *info, gpointer data) -> GstPadProbeReturn {
+                auto *probe = static_cast<probe_data *>(data);
+                return probe->cb(pad, info, probe->user_data);
+            },
+            new probe_data{std::forward<Callback_Type>(cb), user_data, destroy_data},
+            [](gpointer data) { delete static_cast<probe_data *>(data); });
     gst_object_unref(pad);
     return id;
 }
 
-void gst_element_pad_remove_probe(
+inline void gst_element_pad_remove_probe(
         GstElement *element,
         const char *padname,
         gulong id) {
@@ -5,16 +5,25 @@ GstSelfDestructObject::GstSelfDestructObject() {
 }
 
 GstSelfDestructObject::~GstSelfDestructObject() {
-    g_list_foreach(lifecycle_binders, std::function_ptr<void(gpointer, gpointer)>([this](gpointer obj, gpointer) {
-        g_object_remove_toggle_ref(G_OBJECT(obj), self_destruct_callback(), NULL);
-    }), NULL);
+    for (GList *it = lifecycle_binders; it; it = it->next)
+        g_object_remove_toggle_ref(G_OBJECT(it->data), self_destruct_callback(), this);
     g_list_free(lifecycle_binders);
 }
 
+void GstSelfDestructObject::self_destruct_func(gpointer data, GObject *, gboolean) {
+    auto *self = static_cast<GstSelfDestructObject *>(data);
+    g_rec_mutex_lock(&self->lock);
+    self->binds_count -= 1;
+    gboolean to_be_destroyed = self->binds_count == 0;
+    g_rec_mutex_unlock(&self->lock);
+    if (to_be_destroyed)
+        delete self;
+}
+
 void GstSelfDestructObject::bind_lifecycle(gpointer obj) {
     if (obj) {
         g_rec_mutex_lock(&lock);
-        g_object_add_toggle_ref(G_OBJECT(obj), self_destruct_callback(), NULL);
+        g_object_add_toggle_ref(G_OBJECT(obj), self_destruct_callback(), this);
         lifecycle_binders = g_list_append(lifecycle_binders, obj);
         binds_count += 1;
         g_rec_mutex_unlock(&lock);
@@ -26,7 +35,7 @@ void GstSelfDestructObject::bind_lifecycle_many(gpointer obj, ...) {
     va_start(args, obj);
     while (obj) {
         g_rec_mutex_lock(&lock);
-        g_object_add_toggle_ref(G_OBJECT(obj), self_destruct_callback(), NULL);
+        g_object_add_toggle_ref(G_OBJECT(obj), self_destruct_callback(), this);
         lifecycle_binders = g_list_append(lifecycle_binders, obj);
         binds_count += 1;
         g_rec_mutex_unlock(&lock);
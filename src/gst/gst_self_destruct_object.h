@@ -8,19 +8,13 @@ class GstSelfDestructObject {
     GRecMutex lock{};
     GList *lifecycle_binders = NULL;
     uint binds_count = 0;
-    const GToggleNotify self_destruct_func = std::function_ptr<void(gpointer, GObject *, gboolean)>(
-            [this](gpointer, GObject *, gboolean) {
-                g_rec_mutex_lock(&lock);
-                binds_count -= 1;
-                gboolean to_be_destroyed = binds_count == 0;
-                g_rec_mutex_unlock(&lock);
-                if (to_be_destroyed)
-                    delete this;
-            });
+
+    /// Toggle notify of every bound object, called with this as data.
+    static void self_destruct_func(gpointer data, GObject *, gboolean);
 
 protected:
-    inline GToggleNotify self_destruct_callback() {
-        return self_destruct_func;
+    static inline GToggleNotify self_destruct_callback() {
+        return &GstSelfDestructObject::self_destruct_func;
     }
 
 public:
@@ -0,0 +1,110 @@
+#include "frame_difference_gate.h"
+
+#include <cmath>
+#include <limits>
+
+#include <opencv2/imgproc.hpp>
+
+FrameDifferenceGate::FrameDifferenceGate(FrameDifferenceGateOptions options)
+        : options_(options) {}
+
+FrameDifferenceGateOptions FrameDifferenceGate::options() const noexcept {
+    return options_;
+}
+
+void FrameDifferenceGate::set_options(FrameDifferenceGateOptions options) {
+    if (options.thumbnail_width() != options_.thumbnail_width())
+        reset();
+    options_ = options;
+}
+
+cv::Mat FrameDifferenceGate::thumbnail(const cv::Mat &image) const {
+    auto width = std::min(options_.thumbnail_width(), image.cols);
+    auto height = std::max(1, (int) std::round((double) image.rows * width / image.cols));
+    cv::Mat resized, gray, output;
+    // resize first so that color conversion only touches a few pixels
+    cv::resize(image, resized, {width, height}, 0, 0, cv::INTER_AREA);
+    switch (resized.channels()) {
+        case 3:
+            cv::cvtColor(resized, gray, cv::COLOR_RGB2GRAY);
+            break;
+        case 4:
+            cv::cvtColor(resized, gray, cv::COLOR_RGBA2GRAY);
+            break;
+        default:
+            gray = resized;
+    }
+    gray.convertTo(output, CV_32F, 1. / 255.);
+    return output;
+}
+
+bool FrameDifferenceGate::test(const cv::Mat &image) {
+    shift_ = {};
+    if (!options_.enabled() || image.empty())
+        return false;
+    num_queries_++;
+
+    auto current = thumbnail(image);
+    if (reference_.empty() || reference_.size() != current.size() || image.size() != reference_source_size_ ||
+        consecutive_skips_ >= options_.max_consecutive_skips()) {
+        reference_ = current;
+        reference_source_size_ = image.size();
+        consecutive_skips_ = 0;
+        return false;
+    }
+
+    cv::Rect valid_region(0, 0, current.cols, current.rows);
+    cv::Point2d shift;
+    cv::Mat aligned = current;
+    if (options_.motion_compensation()) {
+        shift = cv::phaseCorrelate(reference_, current);
+        auto dx = (int) std::round(shift.x), dy = (int) std::round(shift.y);
+        // pixels shifted in from outside the frame are not comparable
+        valid_region &= cv::Rect(-dx, -dy, current.cols, current.rows);
+        cv::Mat translation = (cv::Mat_<double>(2, 3) << 1, 0, -shift.x, 0, 1, -shift.y);
+        cv::warpAffine(current, aligned, translation, current.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    }
+
+    auto difference = valid_region.area() > 0
+                      ? cv::norm(aligned(valid_region), reference_(valid_region), cv::NORM_L1) / valid_region.area()
+                      : std::numeric_limits<double>::infinity();
+    if (difference >= options_.threshold()) {
+        reference_ = current;
+        consecutive_skips_ = 0;
+        return false;
+    }
+
+    auto scale = (double) image.cols / current.cols;
+    shift_ = shift * scale;
+    consecutive_skips_++;
+    num_hits_++;
+    return true;
+}
+
+cv::Point2d FrameDifferenceGate::shift() const noexcept {
+    return shift_;
+}
+
+unsigned long FrameDifferenceGate::num_queries() const noexcept {
+    return num_queries_;
+}
+
+unsigned long FrameDifferenceGate::num_hits() const noexcept {
+    return num_hits_;
+}
+
+double FrameDifferenceGate::hit_rate() const noexcept {
+    auto num_queries = num_queries_.load();
+    return num_queries ? (double) num_hits_.load() / num_queries : 0.;
+}
+
+void FrameDifferenceGate::reset() {
+    reference_.release();
+    shift_ = {};
+    consecutive_skips_ = 0;
+}
+
+void FrameDifferenceGate::reset_stats() noexcept {
+    num_queries_ = 0;
+    num_hits_ = 0;
+}
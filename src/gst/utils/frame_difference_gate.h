@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+
+#include <opencv2/core.hpp>
+
+class FrameDifferenceGateOptions {
+public:
+    FrameDifferenceGateOptions()
+            : threshold_(0.),
+              thumbnail_width_(64),
+              motion_compensation_(false),
+              max_consecutive_skips_(30) {}
+
+    // setters
+    [[nodiscard]] inline FrameDifferenceGateOptions threshold(double threshold) const noexcept {
+        auto r = *this;
+        r.threshold_ = threshold;
+        return r;
+    }
+
+    [[nodiscard]] inline FrameDifferenceGateOptions thumbnail_width(int thumbnail_width) const noexcept {
+        auto r = *this;
+        r.thumbnail_width_ = thumbnail_width;
+        return r;
+    }
+
+    [[nodiscard]] inline FrameDifferenceGateOptions motion_compensation(bool motion_compensation) const noexcept {
+        auto r = *this;
+        r.motion_compensation_ = motion_compensation;
+        return r;
+    }
+
+    [[nodiscard]] inline FrameDifferenceGateOptions max_consecutive_skips(unsigned int max_consecutive_skips) const noexcept {
+        auto r = *this;
+        r.max_consecutive_skips_ = max_consecutive_skips;
+        return r;
+    }
+
+    // getters
+    /// Mean absolute difference of normalized grayscale thumbnails below which
+    /// a frame is considered static. The gate is disabled when non-positive.
+    [[nodiscard]] inline double threshold() const noexcept {
+        return threshold_;
+    }
+
+    [[nodiscard]] inline int thumbnail_width() const noexcept {
+        return thumbnail_width_;
+    }
+
+    [[nodiscard]] inline bool motion_compensation() const noexcept {
+        return motion_compensation_;
+    }
+
+    [[nodiscard]] inline unsigned int max_consecutive_skips() const noexcept {
+        return max_consecutive_skips_;
+    }
+
+    [[nodiscard]] inline bool enabled() const noexcept {
+        return threshold_ > 0.;
+    }
+
+private:
+    double threshold_;
+    int thumbnail_width_;
+    bool motion_compensation_;
+    unsigned int max_consecutive_skips_;
+};
+
+/**
+ * Cheap gate deciding whether a frame is close enough to the last inferred
+ * frame for its results to be reused.
+ * Frames are compared as small grayscale thumbnails, optionally after
+ * compensating a global translation estimated by phase correlation.
+ */
+class FrameDifferenceGate {
+    FrameDifferenceGateOptions options_;
+    cv::Mat reference_;
+    cv::Size reference_source_size_;
+    cv::Point2d shift_;
+    unsigned int consecutive_skips_ = 0;
+    std::atomic_ulong num_queries_{0};
+    std::atomic_ulong num_hits_{0};
+
+public:
+    explicit FrameDifferenceGate(FrameDifferenceGateOptions options = {});
+
+    [[nodiscard]] FrameDifferenceGateOptions options() const noexcept;
+
+    void set_options(FrameDifferenceGateOptions options);
+
+    /**
+     * Returns true if the results of the reference frame can be reused for image.
+     * Otherwise, image becomes the new reference, as it is expected to be inferred.
+     */
+    bool test(const cv::Mat &image);
+
+    /// Translation of the last tested frame relative to the reference, in source pixels.
+    [[nodiscard]] cv::Point2d shift() const noexcept;
+
+    [[nodiscard]] unsigned long num_queries() const noexcept;
+
+    [[nodiscard]] unsigned long num_hits() const noexcept;
+
+    [[nodiscard]] double hit_rate() const noexcept;
+
+    void reset();
+
+    void reset_stats() noexcept;
+
+private:
+    [[nodiscard]] cv::Mat thumbnail(const cv::Mat &image) const;
+};
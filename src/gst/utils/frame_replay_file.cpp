@@ -0,0 +1,315 @@
+#include "frame_replay_file.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+namespace {
+    static_assert(sizeof(FrameReplayHeader) == 40);
+
+    constexpr guint64 DATA_ALIGNMENT = 4096;
+    constexpr guint64 RECORD_ALIGNMENT = 64;
+
+    inline guint64 align_up(guint64 size, guint64 alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    inline guint64 read_le64(const guint8 *data) {
+        guint64 value;
+        std::memcpy(&value, data, sizeof(value));
+        return GUINT64_FROM_LE(value);
+    }
+
+    inline void write_le64(guint8 *data, guint64 value) {
+        value = GUINT64_TO_LE(value);
+        std::memcpy(data, &value, sizeof(value));
+    }
+
+    inline bool is_image_file(const std::filesystem::path &path) {
+        auto ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" ||
+               ext == ".ppm" || ext == ".tif" || ext == ".tiff" || ext == ".webp";
+    }
+
+    inline bool is_number(const std::string &str) {
+        return !str.empty() && std::all_of(str.begin(), str.end(), [](unsigned char c) { return std::isdigit(c); });
+    }
+}
+
+// ---------------------
+// FrameReplayStore
+// ---------------------
+FrameReplayStore::~FrameReplayStore() {
+    if (caps_)
+        gst_caps_unref(caps_);
+}
+
+std::shared_ptr<FrameReplayStore> FrameReplayStore::open(const std::string &path, double fps) {
+    std::shared_ptr<FrameReplayStore> store(new FrameReplayStore());
+    std::error_code ec;
+    auto ok = std::filesystem::is_directory(path, ec) ? store->load_directory(path, fps)
+                                                      : store->open_container(path);
+    if (!ok)
+        return nullptr;
+    if (store->empty()) {
+        g_printerr("No frames to replay in %s\n", path.c_str());
+        return nullptr;
+    }
+    return store;
+}
+
+bool FrameReplayStore::open_container(const std::string &filepath) {
+    auto fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        g_printerr("Failed to open %s\n", filepath.c_str());
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (guint64) st.st_size < sizeof(FrameReplayHeader)) {
+        ::close(fd);
+        g_printerr("%s is not a frame container\n", filepath.c_str());
+        return false;
+    }
+    auto file_size = (gsize) st.st_size;
+    auto *addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        g_printerr("Failed to map %s\n", filepath.c_str());
+        return false;
+    }
+    // frames are read in order, possibly several times
+    madvise(addr, file_size, MADV_WILLNEED);
+    mapping_ = std::shared_ptr<const guint8>(static_cast<const guint8 *>(addr), [file_size](const guint8 *data) {
+        munmap(const_cast<guint8 *>(data), file_size);
+    });
+
+    FrameReplayHeader header{};
+    std::memcpy(&header, mapping_.get(), sizeof(header));
+    auto caps_length = GUINT32_FROM_LE(header.caps_length);
+    auto frame_size = GUINT64_FROM_LE(header.frame_size);
+    auto data_offset = GUINT64_FROM_LE(header.data_offset);
+    record_size_ = GUINT64_FROM_LE(header.record_size);
+    if (std::memcmp(header.magic, FrameReplayHeader::MAGIC, sizeof(header.magic)) != 0 ||
+        GUINT32_FROM_LE(header.version) != FrameReplayHeader::VERSION ||
+        data_offset < sizeof(header) + caps_length + 1 || data_offset > file_size ||
+        record_size_ < FrameReplayHeader::RECORD_HEADER_SIZE + frame_size ||
+        mapping_.get()[sizeof(header) + caps_length] != '\0') {
+        g_printerr("%s is not a frame container of version %u\n", filepath.c_str(), FrameReplayHeader::VERSION);
+        return false;
+    }
+    caps_ = gst_caps_from_string(reinterpret_cast<const gchar *>(mapping_.get() + sizeof(header)));
+    if (!caps_ || !gst_video_info_from_caps(&info_, caps_) || GST_VIDEO_INFO_SIZE(&info_) != frame_size) {
+        g_printerr("Invalid caps in frame container %s\n", filepath.c_str());
+        return false;
+    }
+
+    records_ = mapping_.get() + data_offset;
+    frame_offset_ = FrameReplayHeader::RECORD_HEADER_SIZE;
+    auto num_frames = (file_size - data_offset) / record_size_;
+    pts_.reserve(num_frames);
+    durations_.reserve(num_frames);
+    for (gsize i = 0; i < num_frames; i++) {
+        const auto *record = records_ + i * record_size_;
+        pts_.push_back(read_le64(record));
+        durations_.push_back(read_le64(record + 8));
+    }
+    for (gsize i = 0; i < num_frames; i++) {
+        if (GST_CLOCK_TIME_IS_VALID(durations_[i]))
+            continue;
+        durations_[i] = i + 1 < num_frames && pts_[i + 1] > pts_[i] ? pts_[i + 1] - pts_[i]
+                                                                    : (i ? durations_[i - 1] : 0);
+    }
+    return true;
+}
+
+bool FrameReplayStore::load_directory(const std::string &dirpath, double fps) {
+    std::vector<std::filesystem::path> filepaths;
+    for (const auto &entry: std::filesystem::directory_iterator(dirpath)) {
+        if (entry.is_regular_file() && is_image_file(entry.path()))
+            filepaths.push_back(entry.path());
+    }
+    std::sort(filepaths.begin(), filepaths.end());
+    if (filepaths.empty())
+        return true;
+
+    auto first = cv::imread(filepaths.front().string(), cv::IMREAD_COLOR);
+    if (first.empty()) {
+        g_printerr("Failed to read %s\n", filepaths.front().c_str());
+        return false;
+    }
+    fps = fps > 0 ? fps : 30.;
+    gst_video_info_set_format(&info_, GST_VIDEO_FORMAT_BGR, first.cols, first.rows);
+    gst_util_double_to_fraction(fps, &GST_VIDEO_INFO_FPS_N(&info_), &GST_VIDEO_INFO_FPS_D(&info_));
+    caps_ = gst_video_info_to_caps(&info_);
+
+    // frames are stored back to back in the layout of info_, as in a container without record headers
+    record_size_ = GST_VIDEO_INFO_SIZE(&info_);
+    auto *frames = new guint8[record_size_ * filepaths.size()];
+    mapping_ = std::shared_ptr<const guint8>(frames, std::default_delete<guint8[]>());
+    records_ = frames;
+
+    auto timestamps_from_names = std::all_of(filepaths.begin(), filepaths.end(), [](const auto &p) {
+        return is_number(p.stem().string());
+    });
+    auto frame_duration = (GstClockTime) std::llround((double) GST_SECOND / fps);
+    auto stride = GST_VIDEO_INFO_PLANE_STRIDE(&info_, 0);
+    for (const auto &filepath: filepaths) {
+        auto image = pts_.empty() ? first : cv::imread(filepath.string(), cv::IMREAD_COLOR);
+        if (image.size() != first.size()) {
+            g_printerr("Skipping %s of a different size than the first image\n", filepath.c_str());
+            continue;
+        }
+        cv::Mat slot(image.rows, image.cols, CV_8UC3, frames + pts_.size() * record_size_, stride);
+        image.copyTo(slot);
+        pts_.push_back(timestamps_from_names ? std::stoull(filepath.stem().string())
+                                             : pts_.size() * frame_duration);
+    }
+    for (std::size_t i = 0; i < pts_.size(); i++)
+        durations_.push_back(i + 1 < pts_.size() && pts_[i + 1] > pts_[i] ? pts_[i + 1] - pts_[i]
+                                                                           : frame_duration);
+    return true;
+}
+
+std::size_t FrameReplayStore::size() const noexcept {
+    return pts_.size();
+}
+
+bool FrameReplayStore::empty() const noexcept {
+    return pts_.empty();
+}
+
+GstCaps *FrameReplayStore::caps() const noexcept {
+    return caps_;
+}
+
+const GstVideoInfo &FrameReplayStore::info() const noexcept {
+    return info_;
+}
+
+GstClockTime FrameReplayStore::pts(std::size_t index) const {
+    return pts_.at(index);
+}
+
+GstClockTime FrameReplayStore::duration(std::size_t index) const {
+    return durations_.at(index);
+}
+
+GstBuffer *FrameReplayStore::buffer(std::size_t index) const {
+    g_return_val_if_fail(index < size(), NULL);
+    auto *data = const_cast<guint8 *>(records_ + index * record_size_ + frame_offset_);
+    auto frame_size = GST_VIDEO_INFO_SIZE(&info_);
+    return gst_buffer_new_wrapped_full(
+            GST_MEMORY_FLAG_READONLY, data, frame_size, 0, frame_size,
+            new std::shared_ptr<const guint8>(mapping_),
+            [](gpointer holder) { delete static_cast<std::shared_ptr<const guint8> *>(holder); });
+}
+
+// ---------------------
+// FrameReplayWriter
+// ---------------------
+FrameReplayWriter::FrameReplayWriter(const std::string &filepath)
+        : file_(std::fopen(filepath.c_str(), "wb")) {
+    if (!file_)
+        g_printerr("Failed to open %s\n", filepath.c_str());
+}
+
+FrameReplayWriter::~FrameReplayWriter() {
+    close();
+}
+
+bool FrameReplayWriter::is_open() const noexcept {
+    return file_ != nullptr;
+}
+
+std::size_t FrameReplayWriter::size() const noexcept {
+    return num_frames_;
+}
+
+bool FrameReplayWriter::write_header(GstCaps *caps) {
+    if (!gst_video_info_from_caps(&info_, caps))
+        return false;
+    auto *caps_str = gst_caps_to_string(caps);
+    auto caps_length = (guint32) std::strlen(caps_str);
+    FrameReplayHeader header{};
+    std::memcpy(header.magic, FrameReplayHeader::MAGIC, sizeof(header.magic));
+    header.version = GUINT32_TO_LE(FrameReplayHeader::VERSION);
+    header.caps_length = GUINT32_TO_LE(caps_length);
+    header.frame_size = GUINT64_TO_LE((guint64) GST_VIDEO_INFO_SIZE(&info_));
+    auto record_size = align_up(FrameReplayHeader::RECORD_HEADER_SIZE + GST_VIDEO_INFO_SIZE(&info_),
+                                RECORD_ALIGNMENT);
+    header.record_size = GUINT64_TO_LE(record_size);
+    auto data_offset = align_up(sizeof(header) + caps_length + 1, DATA_ALIGNMENT);
+    header.data_offset = GUINT64_TO_LE(data_offset);
+
+    std::vector<guint8> prefix(data_offset, 0);
+    std::memcpy(prefix.data(), &header, sizeof(header));
+    std::memcpy(prefix.data() + sizeof(header), caps_str, caps_length);
+    g_free(caps_str);
+    if (std::fwrite(prefix.data(), 1, prefix.size(), file_) != prefix.size())
+        return false;
+    caps_ = gst_caps_ref(caps);
+    record_.assign(record_size, 0);
+    return true;
+}
+
+bool FrameReplayWriter::write(GstBuffer *buf, GstCaps *caps) {
+    if (!file_ || !buf || !caps)
+        return false;
+    if (!caps_) {
+        if (!write_header(caps)) {
+            g_printerr("Failed to write the frame container header\n");
+            close();
+            return false;
+        }
+    } else if (caps != caps_ && !gst_caps_is_equal(caps, caps_)) {
+        return false;
+    }
+
+    // buffers may carry a GstVideoMeta with padded strides, records use the default layout
+    GstVideoFrame src, dst;
+    if (!gst_video_frame_map(&src, &info_, buf, GST_MAP_READ))
+        return false;
+    auto *record_buf = gst_buffer_new_wrapped_full(
+            (GstMemoryFlags) 0, record_.data() + FrameReplayHeader::RECORD_HEADER_SIZE,
+            GST_VIDEO_INFO_SIZE(&info_), 0, GST_VIDEO_INFO_SIZE(&info_), NULL, NULL);
+    auto copied = gst_video_frame_map(&dst, &info_, record_buf, GST_MAP_WRITE);
+    if (copied) {
+        copied = gst_video_frame_copy(&dst, &src);
+        gst_video_frame_unmap(&dst);
+    }
+    gst_video_frame_unmap(&src);
+    gst_buffer_unref(record_buf);
+    if (!copied)
+        return false;
+
+    write_le64(record_.data(), GST_BUFFER_PTS(buf));
+    write_le64(record_.data() + 8, GST_BUFFER_DURATION(buf));
+    if (std::fwrite(record_.data(), 1, record_.size(), file_) != record_.size()) {
+        g_printerr("Failed to write frame %zu of the frame container\n", num_frames_);
+        close();
+        return false;
+    }
+    num_frames_++;
+    return true;
+}
+
+void FrameReplayWriter::close() {
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    if (caps_) {
+        gst_caps_unref(caps_);
+        caps_ = NULL;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+/**
+ * Raw frame container, written by FrameReplayWriter and memory mapped by FrameReplayStore.
+ * All fields are little endian:
+ *   header   FrameReplayHeader
+ *   caps     caps string, NUL terminated, zero padded up to data_offset (a multiple of 4096)
+ *   records  pts and duration in a 64 bytes record header, then the frame laid out as the
+ *            default GstVideoInfo of caps, every record padded up to record_size (a multiple of 64)
+ * The number of frames follows from the file size, so a truncated recording stays readable.
+ */
+struct FrameReplayHeader {
+    static constexpr char MAGIC[4] = {'L', 'T', 'R', 'F'};
+    static constexpr guint32 VERSION = 1;
+    static constexpr guint64 RECORD_HEADER_SIZE = 64;
+
+    char magic[4];
+    guint32 version;
+    guint32 caps_length;
+    guint32 reserved;
+    guint64 frame_size;
+    guint64 record_size;
+    guint64 data_offset;
+};
+
+/**
+ * Pre-decoded frames to replay, either memory mapped from a FrameReplayHeader container
+ * or decoded once from a directory of images.
+ * Buffers share the mapped or decoded frame data, which is kept alive by them, and are read only.
+ */
+class FrameReplayStore {
+    GstCaps *caps_ = NULL;
+    GstVideoInfo info_{};
+    std::vector<GstClockTime> pts_;
+    std::vector<GstClockTime> durations_;
+    // mapped container, or decoded images laid out as records without headers
+    std::shared_ptr<const guint8> mapping_;
+    const guint8 *records_ = nullptr;
+    guint64 record_size_ = 0;
+    guint64 frame_offset_ = 0;
+
+    FrameReplayStore() = default;
+
+    bool open_container(const std::string &filepath);
+
+    bool load_directory(const std::string &dirpath, double fps);
+
+public:
+    FrameReplayStore(const FrameReplayStore &) = delete;
+
+    FrameReplayStore &operator=(const FrameReplayStore &) = delete;
+
+    ~FrameReplayStore();
+
+    /// Opens a container file, or decodes every image of a directory in file name order.
+    /// Image file names that are numbers are taken as pts in nanoseconds, others are
+    /// timestamped at fps. Returns nullptr on failure.
+    static std::shared_ptr<FrameReplayStore> open(const std::string &path, double fps = 30.);
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    /// Caps of every frame, transfer none.
+    [[nodiscard]] GstCaps *caps() const noexcept;
+
+    [[nodiscard]] const GstVideoInfo &info() const noexcept;
+
+    [[nodiscard]] GstClockTime pts(std::size_t index) const;
+
+    [[nodiscard]] GstClockTime duration(std::size_t index) const;
+
+    /// Zero-copy buffer of the frame at index, without timestamps. Transfer full.
+    [[nodiscard]] GstBuffer *buffer(std::size_t index) const;
+};
+
+/**
+ * Appends raw video buffers to a FrameReplayHeader container.
+ * The caps of the first buffer are those of the container, buffers of other caps are rejected.
+ */
+class FrameReplayWriter {
+    std::FILE *file_ = nullptr;
+    GstCaps *caps_ = NULL;
+    GstVideoInfo info_{};
+    std::vector<guint8> record_;
+    std::size_t num_frames_ = 0;
+
+    bool write_header(GstCaps *caps);
+
+public:
+    explicit FrameReplayWriter(const std::string &filepath);
+
+    FrameReplayWriter(const FrameReplayWriter &) = delete;
+
+    FrameReplayWriter &operator=(const FrameReplayWriter &) = delete;
+
+    ~FrameReplayWriter();
+
+    [[nodiscard]] bool is_open() const noexcept;
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    bool write(GstBuffer *buf, GstCaps *caps);
+
+    void close();
+};
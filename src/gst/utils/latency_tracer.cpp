@@ -0,0 +1,176 @@
+#include "latency_tracer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+int LatencyHistogram::bucket_index(guint64 us) noexcept {
+    if (us < SUB_BUCKETS)
+        return (int) us;
+    auto msb = 63 - __builtin_clzll(us);
+    auto sub = (int) (us >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return std::min((msb - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub, NUM_BUCKETS - 1);
+}
+
+guint64 LatencyHistogram::bucket_upper_bound(int index) noexcept {
+    if (index < SUB_BUCKETS)
+        return (guint64) index + 1;
+    auto msb = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    auto sub = (guint64) (index % SUB_BUCKETS);
+    return ((SUB_BUCKETS + sub + 1) << (msb - SUB_BUCKET_BITS));
+}
+
+void LatencyHistogram::record(GstClockTime latency) noexcept {
+    auto us = latency / GST_USECOND;
+    counts_[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    auto prev_max = max_.load(std::memory_order_relaxed);
+    while (us > prev_max && !max_.compare_exchange_weak(prev_max, us, std::memory_order_relaxed));
+}
+
+GstClockTime LatencyHistogram::quantile(double q) const noexcept {
+    guint64 total = 0;
+    for (const auto &c: counts_)
+        total += c.load(std::memory_order_relaxed);
+    if (!total)
+        return GST_CLOCK_TIME_NONE;
+    auto rank = std::max<guint64>((guint64) std::ceil(std::clamp(q, 0., 1.) * (double) total), 1);
+    guint64 cumulative = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        cumulative += counts_[i].load(std::memory_order_relaxed);
+        if (cumulative >= rank)
+            return std::min(bucket_upper_bound(i), max_.load(std::memory_order_relaxed)) * GST_USECOND;
+    }
+    return max();
+}
+
+guint64 LatencyHistogram::count() const noexcept {
+    return count_.load(std::memory_order_relaxed);
+}
+
+GstClockTime LatencyHistogram::sum() const noexcept {
+    return sum_.load(std::memory_order_relaxed) * GST_USECOND;
+}
+
+GstClockTime LatencyHistogram::max() const noexcept {
+    return max_.load(std::memory_order_relaxed) * GST_USECOND;
+}
+
+void LatencyHistogram::reset() noexcept {
+    for (auto &c: counts_)
+        c.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+LatencyTracer::LatencyTracer(std::string export_filepath, std::chrono::milliseconds export_interval)
+        : export_filepath_(std::move(export_filepath)), export_interval_(export_interval) {
+    capture_times_.fill({GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE});
+    if (!export_filepath_.empty())
+        export_thread_ = std::thread(&LatencyTracer::export_loop, this);
+}
+
+LatencyTracer::~LatencyTracer() {
+    {
+        std::lock_guard<std::mutex> lock(export_mutex_);
+        stopping_ = true;
+    }
+    export_cond_.notify_all();
+    if (export_thread_.joinable())
+        export_thread_.join();
+}
+
+void LatencyTracer::configure(std::shared_ptr<LatencyTracer> tracer) {
+    LatencyTracer::instance_ = std::move(tracer);
+}
+
+void LatencyTracer::export_loop() {
+    std::unique_lock<std::mutex> lock(export_mutex_);
+    while (!export_cond_.wait_for(lock, export_interval_, [this]() { return stopping_; })) {
+        if (!dump(export_filepath_))
+            g_printerr("Failed to write latency histograms to %s\n", export_filepath_.c_str());
+    }
+    // last snapshot on shutdown
+    dump(export_filepath_);
+}
+
+void LatencyTracer::record(Stage stage, GstClockTime capture_time) noexcept {
+    if (!GST_CLOCK_TIME_IS_VALID(capture_time))
+        return;
+    auto now = gst_util_get_timestamp();
+    histograms_[stage].record(now > capture_time ? now - capture_time : 0);
+}
+
+void LatencyTracer::remember(GstClockTime pts, GstClockTime capture_time) {
+    if (!GST_CLOCK_TIME_IS_VALID(pts) || !GST_CLOCK_TIME_IS_VALID(capture_time))
+        return;
+    std::lock_guard<std::mutex> lock(capture_times_mutex_);
+    capture_times_[next_capture_slot_] = {pts, capture_time};
+    next_capture_slot_ = (next_capture_slot_ + 1) % NUM_CAPTURE_SLOTS;
+}
+
+void LatencyTracer::record_by_pts(Stage stage, GstClockTime pts) {
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return;
+    auto capture_time = GST_CLOCK_TIME_NONE;
+    {
+        std::lock_guard<std::mutex> lock(capture_times_mutex_);
+        for (const auto &[slot_pts, slot_capture_time]: capture_times_) {
+            if (slot_pts == pts) {
+                capture_time = slot_capture_time;
+                break;
+            }
+        }
+    }
+    record(stage, capture_time);
+}
+
+const LatencyHistogram &LatencyTracer::histogram(Stage stage) const noexcept {
+    return histograms_[stage];
+}
+
+std::string LatencyTracer::to_prometheus() const {
+    static constexpr double QUANTILES[] = {0.5, 0.95, 0.99};
+    auto seconds = [](GstClockTime t) { return (double) t / GST_SECOND; };
+    std::ostringstream ss;
+    ss << "# HELP lantorch_latency_seconds Age of the frame at each pipeline stage since it was stamped.\n"
+       << "# TYPE lantorch_latency_seconds summary\n";
+    for (int s = 0; s < NUM_STAGES; s++) {
+        const auto &histogram = histograms_[s];
+        if (!histogram.count())
+            continue;
+        for (auto q: QUANTILES) {
+            ss << "lantorch_latency_seconds{stage=\"" << STAGE_NAMES[s] << "\",quantile=\"" << q << "\"} "
+               << seconds(histogram.quantile(q)) << "\n";
+        }
+        ss << "lantorch_latency_seconds_sum{stage=\"" << STAGE_NAMES[s] << "\"} " << seconds(histogram.sum()) << "\n"
+           << "lantorch_latency_seconds_count{stage=\"" << STAGE_NAMES[s] << "\"} " << histogram.count() << "\n";
+    }
+    ss << "# HELP lantorch_latency_max_seconds Maximum age of the frame at each pipeline stage.\n"
+       << "# TYPE lantorch_latency_max_seconds gauge\n";
+    for (int s = 0; s < NUM_STAGES; s++) {
+        if (histograms_[s].count())
+            ss << "lantorch_latency_max_seconds{stage=\"" << STAGE_NAMES[s] << "\"} "
+               << seconds(histograms_[s].max()) << "\n";
+    }
+    return ss.str();
+}
+
+bool LatencyTracer::dump(const std::string &filepath) const {
+    auto tmp_filepath = filepath + ".tmp";
+    auto *f = std::fopen(tmp_filepath.c_str(), "w");
+    if (!f)
+        return false;
+    auto text = to_prometheus();
+    auto ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = std::fclose(f) == 0 && ok;
+    return ok && std::rename(tmp_filepath.c_str(), filepath.c_str()) == 0;
+}
+
+void LatencyTracer::reset() noexcept {
+    for (auto &histogram: histograms_)
+        histogram.reset();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <gst/gst.h>
+
+/**
+ * Lock-free log-linear histogram of latencies in microseconds, with 16 sub-buckets
+ * per power of two (relative error under 7%) up to about 38 hours.
+ * Recording is a couple of relaxed atomic increments and can be done from any thread.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int NUM_BUCKETS = (38 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+private:
+    std::array<std::atomic<guint64>, NUM_BUCKETS> counts_{};
+    std::atomic<guint64> count_{0};
+    std::atomic<guint64> sum_{0};
+    std::atomic<guint64> max_{0};
+
+    static int bucket_index(guint64 us) noexcept;
+
+    static guint64 bucket_upper_bound(int index) noexcept;
+
+public:
+    LatencyHistogram() = default;
+
+    LatencyHistogram(const LatencyHistogram &) = delete;
+
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    void record(GstClockTime latency) noexcept;
+
+    /// Upper bound of the bucket holding quantile q in [0, 1], GST_CLOCK_TIME_NONE if empty.
+    [[nodiscard]] GstClockTime quantile(double q) const noexcept;
+
+    [[nodiscard]] guint64 count() const noexcept;
+
+    [[nodiscard]] GstClockTime sum() const noexcept;
+
+    [[nodiscard]] GstClockTime max() const noexcept;
+
+    void reset() noexcept;
+};
+
+/**
+ * Glass-to-overlay latency tracer.
+ * Frames are stamped with gst_util_get_timestamp() when GstFrameMetaAddProbe attaches
+ * their GstFrameMeta, and every stage records the age of the frame it is handling.
+ * Results shown on screen are looked up by pts, as the overlay no longer has the buffer.
+ * Histograms are periodically written to a file in the Prometheus text format, which
+ * node_exporter's textfile collector (or a plain scrape of the file) can serve.
+ * Disabled unless configure() has been called, in which case stages cost a null check.
+ */
+class LatencyTracer {
+public:
+    enum Stage {
+        STAGE_AppSinkPull,  // sample pulled by the inference worker
+        STAGE_Forward,      // model forward returned
+        STAGE_Emit,         // result signals delivered
+        STAGE_Overlay,      // boxes of the frame requested on screen
+        NUM_STAGES,
+    };
+
+    static constexpr const char *STAGE_NAMES[NUM_STAGES] = {"appsink_pull", "forward", "emit", "overlay"};
+
+private:
+    static inline std::shared_ptr<LatencyTracer> instance_;
+
+    static constexpr std::size_t NUM_CAPTURE_SLOTS = 256;
+
+    std::array<LatencyHistogram, NUM_STAGES> histograms_;
+    std::mutex capture_times_mutex_;
+    std::array<std::pair<GstClockTime, GstClockTime>, NUM_CAPTURE_SLOTS> capture_times_;
+    std::size_t next_capture_slot_ = 0;
+
+    std::string export_filepath_;
+    std::chrono::milliseconds export_interval_;
+    std::thread export_thread_;
+    std::mutex export_mutex_;
+    std::condition_variable export_cond_;
+    bool stopping_ = false;
+
+    void export_loop();
+
+public:
+    /// Writes the histograms to export_filepath every export_interval, if not empty.
+    explicit LatencyTracer(std::string export_filepath = "",
+                           std::chrono::milliseconds export_interval = std::chrono::seconds(5));
+
+    ~LatencyTracer();
+
+    /// Installs the process-wide tracer before any stage runs, a null tracer disables tracing.
+    /// The last snapshot is written when the tracer is destroyed.
+    static void configure(std::shared_ptr<LatencyTracer> tracer);
+
+    static inline std::shared_ptr<LatencyTracer> instance() {
+        return LatencyTracer::instance_;
+    }
+
+    /// Records now - capture_time into the stage histogram, ignores invalid capture times.
+    void record(Stage stage, GstClockTime capture_time) noexcept;
+
+    /// Remembers the capture time of the frame at pts for later lookups by pts.
+    void remember(GstClockTime pts, GstClockTime capture_time);
+
+    /// Records stage for the frame at pts, if its capture time has been remembered.
+    void record_by_pts(Stage stage, GstClockTime pts);
+
+    [[nodiscard]] const LatencyHistogram &histogram(Stage stage) const noexcept;
+
+    /// p50/p95/p99 of every stage in the Prometheus text exposition format.
+    [[nodiscard]] std::string to_prometheus() const;
+
+    /// Writes to_prometheus() to filepath through a temporary file, so scrapers never read a partial file.
+    bool dump(const std::string &filepath) const;
+
+    void reset() noexcept;
+
+    /// Records now - capture_time at stage on the process-wide tracer, if any.
+    static inline void trace(Stage stage, GstClockTime capture_time) noexcept {
+        if (auto *tracer = LatencyTracer::instance_.get())
+            tracer->record(stage, capture_time);
+    }
+};
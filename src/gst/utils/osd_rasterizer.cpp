@@ -0,0 +1,267 @@
+#include "osd_rasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <opencv2/imgproc.hpp>
+
+namespace {
+    constexpr std::size_t MAX_CACHED_LABELS = 256;
+
+    // seaborn deep
+    constexpr std::array<std::array<guint8, 3>, 10> PALETTE = {{
+            {76, 114, 176}, {221, 132, 82}, {85, 168, 104}, {196, 78, 82}, {129, 114, 179},
+            {147, 120, 96}, {218, 139, 195}, {140, 140, 140}, {204, 185, 116}, {100, 181, 205},
+    }};
+
+    /// Component values of an RGB color in the order of the format components.
+    struct Color {
+        guint8 comp[GST_VIDEO_MAX_COMPONENTS] = {0, 0, 0, 255};
+    };
+
+    inline Color to_color(const GstVideoFormatInfo *finfo, const std::array<guint8, 3> &rgb) {
+        Color color;
+        double r = rgb[0], g = rgb[1], b = rgb[2];
+        if (GST_VIDEO_FORMAT_INFO_IS_YUV(finfo) || GST_VIDEO_FORMAT_INFO_IS_GRAY(finfo)) {
+            // BT.601 limited range
+            color.comp[0] = (guint8) std::lround(16. + (65.481 * r + 128.553 * g + 24.966 * b) / 255.);
+            color.comp[1] = (guint8) std::lround(128. + (-37.797 * r - 74.203 * g + 112. * b) / 255.);
+            color.comp[2] = (guint8) std::lround(128. + (112. * r - 93.786 * g - 18.214 * b) / 255.);
+        } else {
+            color.comp[0] = rgb[0];
+            color.comp[1] = rgb[1];
+            color.comp[2] = rgb[2];
+        }
+        return color;
+    }
+
+    inline bool is_bright(const std::array<guint8, 3> &rgb) {
+        return 0.299 * rgb[0] + 0.587 * rgb[1] + 0.114 * rgb[2] > 150.;
+    }
+
+    /// Mask of text with margin blank columns on each side. The height only depends on the font,
+    /// so masks of different texts line up when put side by side.
+    inline cv::Mat render_text(const std::string &text, const OsdRasterizerOptions &options, int margin) {
+        int baseline = 0;
+        auto size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, options.font_scale(),
+                                    options.font_thickness(), &baseline);
+        cv::Mat mask = cv::Mat::zeros(size.height + baseline + 2, size.width + 2 * margin, CV_8UC1);
+        cv::putText(mask, text, {margin, size.height + 1}, cv::FONT_HERSHEY_SIMPLEX, options.font_scale(),
+                    cv::Scalar(255), options.font_thickness(), cv::LINE_8);
+        return mask;
+    }
+
+    /// True if all components are interleaved in a single plane of 4-byte pixels.
+    inline bool is_packed_word(const GstVideoFrame *frame) {
+        return GST_VIDEO_FRAME_N_PLANES(frame) == 1 && GST_VIDEO_FRAME_COMP_PSTRIDE(frame, 0) == 4 &&
+               GST_VIDEO_FORMAT_INFO_W_SUB(frame->info.finfo, 1) == 0;
+    }
+
+    /// The 4-byte pixel of color in a packed word format, with an opaque alpha if any.
+    inline guint32 packed_pixel(const GstVideoFrame *frame, const Color &color) {
+        guint8 bytes[4] = {255, 255, 255, 255};
+        for (guint c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS(frame); c++)
+            bytes[GST_VIDEO_FRAME_COMP_POFFSET(frame, c)] = color.comp[c];
+        guint32 pixel;
+        std::memcpy(&pixel, bytes, sizeof(pixel));
+        return pixel;
+    }
+
+    /// Fills [x0, x1) x [y0, y1), in frame pixels, clipped to the frame.
+    inline void fill_rect(GstVideoFrame *frame, const Color &color, int x0, int y0, int x1, int y1) {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, (int) GST_VIDEO_FRAME_WIDTH(frame));
+        y1 = std::min(y1, (int) GST_VIDEO_FRAME_HEIGHT(frame));
+        if (x0 >= x1 || y0 >= y1)
+            return;
+        auto *finfo = frame->info.finfo;
+
+        if (is_packed_word(frame)) {
+            // whole pixels at once, the row loop is a plain vectorizable 32-bit fill
+            auto pixel = packed_pixel(frame, color);
+            auto *data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+            auto stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+            for (int y = y0; y < y1; y++) {
+                auto *row = data + (gsize) y * stride + (gsize) x0 * 4;
+                for (int x = 0; x < x1 - x0; x++)
+                    std::memcpy(row + (gsize) x * 4, &pixel, 4);
+            }
+            return;
+        }
+
+        for (guint c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS(frame); c++) {
+            auto plane = GST_VIDEO_FRAME_COMP_PLANE(frame, c);
+            auto *data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, plane) + GST_VIDEO_FRAME_COMP_POFFSET(frame, c);
+            auto stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane);
+            auto pstride = GST_VIDEO_FRAME_COMP_PSTRIDE(frame, c);
+            // subsampled components cover the chroma samples the rect touches
+            auto cx0 = x0 >> GST_VIDEO_FORMAT_INFO_W_SUB(finfo, c), cx1 = GST_VIDEO_FORMAT_INFO_SCALE_WIDTH(finfo, c, x1);
+            auto cy0 = y0 >> GST_VIDEO_FORMAT_INFO_H_SUB(finfo, c), cy1 = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(finfo, c, y1);
+            auto value = color.comp[c];
+            for (int y = cy0; y < cy1; y++) {
+                auto *row = data + (gsize) y * stride;
+                if (pstride == 1) {
+                    std::memset(row + cx0, value, cx1 - cx0);
+                } else {
+                    for (int x = cx0; x < cx1; x++)
+                        row[(gsize) x * pstride] = value;
+                }
+            }
+        }
+    }
+
+    /// Sets the pixels where mask is non-zero, mask top-left at (x, y) in frame pixels.
+    /// Pixels are written straight into the planes, one run of set mask pixels at a time.
+    inline void fill_mask(GstVideoFrame *frame, const Color &color, const cv::Mat &mask, int x, int y) {
+        auto mx0 = std::max(0, -x), mx1 = std::min(mask.cols, (int) GST_VIDEO_FRAME_WIDTH(frame) - x);
+        auto my0 = std::max(0, -y), my1 = std::min(mask.rows, (int) GST_VIDEO_FRAME_HEIGHT(frame) - y);
+        if (mx0 >= mx1 || my0 >= my1)
+            return;
+        auto *finfo = frame->info.finfo;
+
+        if (is_packed_word(frame)) {
+            auto pixel = packed_pixel(frame, color);
+            auto *data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+            auto stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+            for (int my = my0; my < my1; my++) {
+                const auto *mask_row = mask.ptr<guint8>(my);
+                auto *row = data + (gsize) (y + my) * stride + (gsize) x * 4;
+                for (int mx = mx0; mx < mx1; mx++) {
+                    if (mask_row[mx])
+                        std::memcpy(row + (gsize) mx * 4, &pixel, 4);
+                }
+            }
+            return;
+        }
+
+        for (guint c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS(frame); c++) {
+            auto plane = GST_VIDEO_FRAME_COMP_PLANE(frame, c);
+            auto *data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, plane) + GST_VIDEO_FRAME_COMP_POFFSET(frame, c);
+            auto stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane);
+            auto pstride = GST_VIDEO_FRAME_COMP_PSTRIDE(frame, c);
+            auto w_sub = GST_VIDEO_FORMAT_INFO_W_SUB(finfo, c), h_sub = GST_VIDEO_FORMAT_INFO_H_SUB(finfo, c);
+            auto value = color.comp[c];
+            for (int my = my0; my < my1; my++) {
+                const auto *mask_row = mask.ptr<guint8>(my);
+                auto *row = data + (gsize) ((y + my) >> h_sub) * stride;
+                for (int mx = mx0; mx < mx1;) {
+                    if (!mask_row[mx]) {
+                        mx++;
+                        continue;
+                    }
+                    auto run_end = mx + 1;
+                    while (run_end < mx1 && mask_row[run_end])
+                        run_end++;
+                    // subsampled components take the chroma samples the run touches
+                    auto cx0 = (x + mx) >> w_sub, cx1 = ((x + run_end - 1) >> w_sub) + 1;
+                    if (pstride == 1) {
+                        std::memset(row + cx0, value, cx1 - cx0);
+                    } else {
+                        for (int cx = cx0; cx < cx1; cx++)
+                            row[(gsize) cx * pstride] = value;
+                    }
+                    mx = run_end;
+                }
+            }
+        }
+    }
+}
+
+OsdRasterizer::OsdRasterizer(OsdRasterizerOptions options)
+        : options_(options) {}
+
+OsdRasterizerOptions OsdRasterizer::options() const noexcept {
+    return options_;
+}
+
+void OsdRasterizer::set_options(OsdRasterizerOptions options) {
+    if (options.font_scale() != options_.font_scale() || options.font_thickness() != options_.font_thickness()) {
+        label_masks_.clear();
+        glyph_masks_.fill(cv::Mat());
+    }
+    options_ = options;
+}
+
+bool OsdRasterizer::supports(GstVideoFormat format) {
+    auto *finfo = gst_video_format_get_info(format);
+    if (!finfo || format == GST_VIDEO_FORMAT_UNKNOWN || format == GST_VIDEO_FORMAT_ENCODED)
+        return false;
+    if (GST_VIDEO_FORMAT_INFO_HAS_PALETTE(finfo) || GST_VIDEO_FORMAT_INFO_IS_TILED(finfo) ||
+        GST_VIDEO_FORMAT_INFO_IS_COMPLEX(finfo))
+        return false;
+    for (guint c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS(finfo); c++) {
+        if (GST_VIDEO_FORMAT_INFO_DEPTH(finfo, c) != 8 || GST_VIDEO_FORMAT_INFO_SHIFT(finfo, c) != 0)
+            return false;
+    }
+    return true;
+}
+
+const cv::Mat &OsdRasterizer::label_mask(const std::string &text) {
+    auto it = label_masks_.find(text);
+    if (it != label_masks_.end())
+        return it->second;
+    if (label_masks_.size() >= MAX_CACHED_LABELS)
+        label_masks_.clear();
+    return label_masks_.emplace(text, render_text(text, options_, 1)).first->second;
+}
+
+const cv::Mat &OsdRasterizer::glyph_mask(char c) {
+    auto &mask = glyph_masks_[(unsigned char) c % glyph_masks_.size()];
+    if (mask.empty())
+        mask = render_text(std::string(1, c), options_, 0);
+    return mask;
+}
+
+void OsdRasterizer::draw(GstVideoFrame *frame, const GstDetectionMeta *meta) {
+    if (!meta || !supports(GST_VIDEO_FRAME_FORMAT(frame)))
+        return;
+    auto *finfo = frame->info.finfo;
+    auto sx = meta->frame_width > 0 ? (double) GST_VIDEO_FRAME_WIDTH(frame) / meta->frame_width : 1.;
+    auto sy = meta->frame_height > 0 ? (double) GST_VIDEO_FRAME_HEIGHT(frame) / meta->frame_height : 1.;
+    auto lw = std::max(options_.line_width(), 1);
+    char confidence_str[16];
+
+    for (guint i = 0; i < gst_detection_meta_size(meta); i++) {
+        const auto *det = gst_detection_meta_get(meta, i);
+        auto x0 = (int) std::lround(det->x * sx), y0 = (int) std::lround(det->y * sy);
+        auto x1 = (int) std::lround((det->x + det->width) * sx), y1 = (int) std::lround((det->y + det->height) * sy);
+        const auto &rgb = PALETTE[(std::size_t) std::max(det->class_id, 0) % PALETTE.size()];
+        auto color = to_color(finfo, rgb);
+
+        fill_rect(frame, color, x0, y0, x1, y0 + lw);
+        fill_rect(frame, color, x0, y1 - lw, x1, y1);
+        fill_rect(frame, color, x0, y0 + lw, x0 + lw, y1 - lw);
+        fill_rect(frame, color, x1 - lw, y0 + lw, x1, y1 - lw);
+
+        if (!options_.draw_labels())
+            continue;
+        // the label is cached as a whole, the confidence, which changes every frame, glyph by glyph
+        const auto &mask = label_mask(det->label ? g_quark_to_string(det->label) : std::to_string(det->class_id));
+        auto width = mask.cols;
+        int confidence_len = 0;
+        if (options_.draw_confidence()) {
+            confidence_len = std::snprintf(confidence_str, sizeof(confidence_str), " %.2f", det->confidence);
+            confidence_len = std::clamp(confidence_len, 0, (int) sizeof(confidence_str) - 1);
+            for (int c = 0; c < confidence_len; c++)
+                width += glyph_mask(confidence_str[c]).cols;
+        }
+        // above the box, or inside it at the top of the frame
+        auto ly = y0 - mask.rows >= 0 ? y0 - mask.rows : y0;
+        fill_rect(frame, color, x0, ly, x0 + width, ly + mask.rows);
+        auto text_color = to_color(finfo, is_bright(rgb) ? std::array<guint8, 3>{0, 0, 0}
+                                                         : std::array<guint8, 3>{255, 255, 255});
+        fill_mask(frame, text_color, mask, x0, ly);
+        // glyphs start in the blank right margin of the label, which is kept after the last one
+        auto gx = x0 + mask.cols - 1;
+        for (int c = 0; c < confidence_len; c++) {
+            const auto &glyph = glyph_mask(confidence_str[c]);
+            fill_mask(frame, text_color, glyph, gx, ly);
+            gx += glyph.cols;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <unordered_map>
+
+#include <gst/video/video.h>
+
+#include <opencv2/core.hpp>
+
+#include "../gst_detection_meta.h"
+
+class OsdRasterizerOptions {
+public:
+    OsdRasterizerOptions()
+            : line_width_(2),
+              draw_labels_(true),
+              draw_confidence_(true),
+              font_scale_(0.5),
+              font_thickness_(1) {}
+
+    // setters
+    [[nodiscard]] inline OsdRasterizerOptions line_width(int line_width) const noexcept {
+        auto r = *this;
+        r.line_width_ = line_width;
+        return r;
+    }
+
+    [[nodiscard]] inline OsdRasterizerOptions draw_labels(bool draw_labels) const noexcept {
+        auto r = *this;
+        r.draw_labels_ = draw_labels;
+        return r;
+    }
+
+    [[nodiscard]] inline OsdRasterizerOptions draw_confidence(bool draw_confidence) const noexcept {
+        auto r = *this;
+        r.draw_confidence_ = draw_confidence;
+        return r;
+    }
+
+    [[nodiscard]] inline OsdRasterizerOptions font_scale(double font_scale) const noexcept {
+        auto r = *this;
+        r.font_scale_ = font_scale;
+        return r;
+    }
+
+    [[nodiscard]] inline OsdRasterizerOptions font_thickness(int font_thickness) const noexcept {
+        auto r = *this;
+        r.font_thickness_ = font_thickness;
+        return r;
+    }
+
+    // getters
+    [[nodiscard]] inline int line_width() const noexcept {
+        return line_width_;
+    }
+
+    [[nodiscard]] inline bool draw_labels() const noexcept {
+        return draw_labels_;
+    }
+
+    [[nodiscard]] inline bool draw_confidence() const noexcept {
+        return draw_confidence_;
+    }
+
+    /// Scale of OpenCV's Hershey simplex font.
+    [[nodiscard]] inline double font_scale() const noexcept {
+        return font_scale_;
+    }
+
+    [[nodiscard]] inline int font_thickness() const noexcept {
+        return font_thickness_;
+    }
+
+private:
+    int line_width_;
+    bool draw_labels_;
+    bool draw_confidence_;
+    double font_scale_;
+    int font_thickness_;
+};
+
+/**
+ * Draws detection boxes and labels directly into raw video frames on the CPU,
+ * for recorded or streamed outputs that have no Qt overlay.
+ * Works on any 8-bit planar or packed RGB/YUV/GRAY format (RGBA, NV12, I420, ...).
+ * Only box outlines and label patches are touched, 4-byte packed formats are
+ * filled a pixel word at a time. Label names and the characters of confidences are
+ * cached as separate glyph masks, composed at draw time.
+ * Not thread safe, meant to be used from a single streaming thread.
+ */
+class OsdRasterizer {
+    OsdRasterizerOptions options_;
+    std::unordered_map<std::string, cv::Mat> label_masks_;
+    // indexed by character, confidences only use a few of them
+    std::array<cv::Mat, 128> glyph_masks_;
+
+public:
+    explicit OsdRasterizer(OsdRasterizerOptions options = {});
+
+    [[nodiscard]] OsdRasterizerOptions options() const noexcept;
+
+    void set_options(OsdRasterizerOptions options);
+
+    [[nodiscard]] static bool supports(GstVideoFormat format);
+
+    /// Boxes are rescaled from the meta frame size to the frame size.
+    void draw(GstVideoFrame *frame, const GstDetectionMeta *meta);
+
+private:
+    const cv::Mat &label_mask(const std::string &text);
+
+    const cv::Mat &glyph_mask(char c);
+};
@@ -24,6 +24,8 @@ void GraphicsViewOverlayedTrait::initOpenGLViewport() {
         auto *viewport = new QOpenGLWidget(graphics_view_);
         viewport->setAttribute(Qt::WA_AlwaysStackOnTop);
         graphics_view_->setViewport(viewport);
+        // the scene background clears the whole framebuffer, items outside of dirty regions would be lost
+        graphics_view_->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
     }
 }
 
@@ -92,32 +92,110 @@ QColor DetectionBoundingBox::color() const noexcept {
 }
 
 void DetectionBoundingBox::setLabelId(int label_id) {
+    if (label_id == label_id_)
+        return;
+    // the id is only drawn when there is no label
+    if (label_.isEmpty())
+        invalidateDescription();
     label_id_ = label_id;
 }
 
 void DetectionBoundingBox::setLabel(const QString &label) {
+    if (label == label_)
+        return;
+    invalidateDescription();
     label_ = label;
 }
 
 void DetectionBoundingBox::setConfidence(double confidence) {
+    if (confidence == confidence_)
+        return;
+    if (showsConfidence())
+        invalidateDescription();
     confidence_ = confidence;
 }
 
 void DetectionBoundingBox::setBBox(const QRectF &bbox) {
+    if (bbox == bbox_)
+        return;
+    if (bbox.size() != bbox_.size())
+        prepareGeometryChange();
     bbox_ = bbox;
     setPos(bbox.topLeft());
 }
 
 void DetectionBoundingBox::setColor(const QColor &color) {
+    if (color == color_)
+        return;
     color_ = color;
+    update();
+}
+
+void DetectionBoundingBox::invalidateGeometry() {
+    prepareGeometryChange();
+}
+
+bool DetectionBoundingBox::showsDescription() const {
+    return options_.show_description() == DetectionBoundingBoxOptions::Always ||
+           (on_focus_ && options_.show_description() == DetectionBoundingBoxOptions::OnFocus);
+}
+
+bool DetectionBoundingBox::showsConfidence() const {
+    return showsDescription() &&
+           (options_.show_confidence() == DetectionBoundingBoxOptions::Always ||
+            (on_focus_ && options_.show_confidence() == DetectionBoundingBoxOptions::OnFocus));
+}
+
+QFont DetectionBoundingBox::descriptionFont() const {
+    return {options_.font_family(), on_focus_ ? options_.focus_font_point_size() : options_.font_point_size()};
+}
+
+void DetectionBoundingBox::updateDescription() const {
+    if (description_valid_)
+        return;
+    description_ = label_.isEmpty() ? QString::fromStdString(fmt::format("[{}]", label_id_)) : label_;
+    if (showsConfidence())
+        description_.append(QString::fromStdString(fmt::format(" ({:.02f}%)", confidence_ * 100)));
+    auto font = descriptionFont();
+    auto fm = QFontMetricsF(font, view());
+    description_size_ = {fm.width(description_) + font.pointSizeF(), fm.height()};
+    description_valid_ = true;
+}
+
+void DetectionBoundingBox::invalidateDescription() {
+    // the description may be wider than the box
+    if (showsDescription())
+        prepareGeometryChange();
+    description_valid_ = false;
+}
+
+void DetectionBoundingBox::setOnFocus(bool on_focus) {
+    if (on_focus == on_focus_)
+        return;
+    prepareGeometryChange();
+    on_focus_ = on_focus;
+    description_valid_ = false;
 }
 
 QRectF DetectionBoundingBox::boundingRect() const {
-    return {0, 0, bbox_.width(), bbox_.height()};
+    auto rect = QRectF{0, 0, bbox_.width(), bbox_.height()};
+    auto scale = view() ? inverse_render_scale() : 1.;
+    auto line_width = isOnFocus() ? options_.focus_line_width() : options_.line_width();
+    auto margin = (options_.cosmetic() ? line_width * scale : line_width) / 2 + scale;
+    auto bounds = rect.adjusted(-margin, -margin, margin, margin);
+    if (showsDescription()) {
+        // drawn above the box, or below its top edge when it would be out of frame
+        updateDescription();
+        auto text_width = description_size_.width() * scale;
+        auto text_height = (description_size_.height() + line_width / 2) * scale;
+        bounds |= QRectF{rect.width() / 2 - text_width / 2, -text_height, text_width, 2 * text_height}
+                .adjusted(-scale, -scale, scale, scale);
+    }
+    return bounds;
 }
 
 QPainterPath DetectionBoundingBox::shape() const {
-    auto rel_bbox = boundingRect();
+    auto rel_bbox = QRectF{0, 0, bbox_.width(), bbox_.height()};
 
     QPainterPath path;
     if (options_.shape() == DetectionBoundingBoxOptions::Rect) {
@@ -133,7 +211,7 @@ QPainterPath DetectionBoundingBox::shape() const {
 }
 
 void DetectionBoundingBox::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *widget) {
-    auto rel_bbox = boundingRect();
+    auto rel_bbox = QRectF{0, 0, bbox_.width(), bbox_.height()};
 
     bool is_on_focus = isOnFocus();
     auto pen = QPen(color_, is_on_focus ? options_.focus_line_width() : options_.line_width());
@@ -162,10 +240,9 @@ void DetectionBoundingBox::paint(QPainter *painter, const QStyleOptionGraphicsIt
         painter->drawEllipse(rel_bbox);
     }
 
-    if (options_.show_description() == DetectionBoundingBoxOptions::Always ||
-        (is_on_focus && options_.show_description() == DetectionBoundingBoxOptions::OnFocus)) {
-        auto font = QFont(options_.font_family(),
-                          is_on_focus ? options_.focus_font_point_size() : options_.font_point_size());
+    if (showsDescription()) {
+        auto font = descriptionFont();
+        updateDescription();
 
         painter->save();
         auto trans = painter->transform();
@@ -173,39 +250,29 @@ void DetectionBoundingBox::paint(QPainter *painter, const QStyleOptionGraphicsIt
         auto scale = pop_scale(trans);
         painter->setTransform(trans);
         {
-            QString desc = label_.isEmpty() ? QString::fromStdString(fmt::format("[{}]", label_id_)) : label_;
-            if (options_.show_confidence() == DetectionBoundingBoxOptions::Always ||
-                (is_on_focus && options_.show_confidence() == DetectionBoundingBoxOptions::OnFocus))
-                desc.append(QString::fromStdString(fmt::format(" ({:.02f}%)", confidence_ * 100)));
-
-            auto fm = QFontMetricsF(font, view());
-            auto text_width = fm.width(desc);
-            auto text_height = fm.height();
+            auto text_width = description_size_.width();
+            auto text_height = description_size_.height();
 
             bool out_of_frame = y() - (text_height + pen.widthF() / 2) * scale < 0;
             auto text_y = out_of_frame ? pen.widthF() / 2 : -text_height - pen.widthF() / 2;
-            auto text_rect = QRectF{-(text_width + font.pointSizeF()) / 2, text_y,
-                                    text_width + font.pointSizeF(), text_height};
+            auto text_rect = QRectF{-text_width / 2, text_y, text_width, text_height};
             if (options_.boxed_description()) {
                 painter->fillRect(text_rect, QBrush(color_));
             }
 
             painter->setPen(options_.boxed_description() ? QPen(invertColor(color_, true)) : pen);
             painter->setFont(font);
-            painter->drawText(text_rect, desc, Qt::AlignCenter | Qt::AlignTop);
+            painter->drawText(text_rect, description_, Qt::AlignCenter | Qt::AlignTop);
         }
         painter->restore();
     }
 }
 
 void DetectionBoundingBox::hoverEnterEvent(QGraphicsSceneHoverEvent *event) {
-    on_focus_ = true;
-    view()->update();
+    setOnFocus(true);
 }
 
 void DetectionBoundingBox::hoverLeaveEvent(QGraphicsSceneHoverEvent *event) {
-    if (!isSelected()) {
-        on_focus_ = false;
-        view()->update();
-    }
+    if (!isSelected())
+        setOnFocus(false);
 }
@@ -224,6 +224,23 @@ class DetectionBoundingBox : public MediaOverlayingGraphicsItem {
     bool on_focus_ = false;
     DetectionBoundingBoxOptions options_;
 
+    // text drawn above the box and its size in view pixels, computed when first painted or bounded
+    mutable QString description_;
+    mutable QSizeF description_size_;
+    mutable bool description_valid_ = false;
+
+    [[nodiscard]] bool showsDescription() const;
+
+    [[nodiscard]] bool showsConfidence() const;
+
+    [[nodiscard]] QFont descriptionFont() const;
+
+    void updateDescription() const;
+
+    void invalidateDescription();
+
+    void setOnFocus(bool on_focus);
+
 public:
     explicit DetectionBoundingBox(DetectionBoundingBoxOptions options = {},
                                   QGraphicsItem *parent = nullptr);
@@ -272,6 +289,8 @@ public:
 
     [[nodiscard]] QColor color() const noexcept;
 
+    // setters leave the item untouched when the value does not change
+
     void setLabelId(int label_id);
 
     void setLabel(const QString &label);
@@ -282,6 +301,9 @@ public:
 
     void setColor(const QColor &color);
 
+    /// To be called when the render scale of the media changes, as the bounds depend on it.
+    void invalidateGeometry();
+
     [[nodiscard]] inline QSizeF size() const {
         return bbox_.size();
     }
@@ -9,11 +9,16 @@ MediaWidget *MediaOverlayingGraphicsTrait::overlayed_media_widget() const {
     return qobject_cast<MediaWidget *>(overlayed_object());
 }
 
+double MediaOverlayingGraphicsTrait::inverse_render_scale() const {
+    auto render_scale = overlayed_media_widget()->render_scale();
+    auto s = std::min(render_scale.width(), render_scale.height());
+    return s > 0 ? 1 / s : 1;
+}
+
 double MediaOverlayingGraphicsTrait::pop_scale(QTransform &transform) const {
     auto dx = transform.m13(), dy = transform.m23();
     transform.translate(-dx, -dy);
-    auto render_scale = overlayed_media_widget()->render_scale();
-    auto s = 1 / std::min(render_scale.width(), render_scale.height());
+    auto s = inverse_render_scale();
     transform.scale(s, s);
     transform.translate(dx, dy);
     return s;
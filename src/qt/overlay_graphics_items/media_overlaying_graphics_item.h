@@ -12,6 +12,9 @@ public:
     [[nodiscard]] MediaWidget *overlayed_media_widget() const;
 
 protected:
+    /// Scale from view pixels to item units, 1 while the media is not rendered.
+    [[nodiscard]] double inverse_render_scale() const;
+
     double pop_scale(QTransform &transform) const;
 };
 
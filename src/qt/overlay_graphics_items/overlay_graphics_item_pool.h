@@ -2,6 +2,7 @@
 
 #include <QException>
 #include <QPointer>
+#include <algorithm>
 #include <utility>
 
 #include "OverlayGraphicsItem"
@@ -72,6 +73,7 @@ public:
             }
         } else {
             items_.resize(n);
+            n_active_items_ = std::min(n_active_items_, n);
         }
     }
 
@@ -88,6 +90,7 @@ public:
             for (auto i = 0; i < items_.size() - n; i++) {
                 items_.removeLast();
             }
+            n_active_items_ = std::min(n_active_items_, (int) items_.size());
         }
     }
 
@@ -103,36 +106,16 @@ public:
 
     QList<QSharedPointer<ItemType>> request(int n) {
         checkAvailable(n);
-        for (auto i = 0; i < n; i++) {
-            items_[i]->setVisible(true);
-        }
-        if (n < n_active_items_) {
-            for (auto iter = items_.begin() + n;
-                 iter != items_.begin() + n_active_items_;
-                 iter = std::next(iter)) {
-                (*iter)->setVisible(false);
-            }
-        }
-        n_active_items_ = n;
+        setNumActiveItems(n);
         return items_.mid(0, n);
     }
 
     template<typename UpdateFunc>
     QList<QSharedPointer<ItemType>> submit(int n, UpdateFunc f) {
         checkAvailable(n);
-        for (auto i = 0; i < n; i++) {
-            auto item = items_[i];
-            f(i, item);
-            item->setVisible(true);
-        }
-        if (n < n_active_items_) {
-            for (auto iter = items_.begin() + n;
-                 iter != items_.begin() + n_active_items_;
-                 iter = std::next(iter)) {
-                (*iter)->setVisible(false);
-            }
-        }
-        n_active_items_ = n;
+        for (auto i = 0; i < n; i++)
+            f(i, items_[i]);
+        setNumActiveItems(n);
         return items_.mid(0, n);
     }
 
@@ -148,6 +131,16 @@ public:
     }
 
 protected:
+    /// Shows or hides only the items between the previous and new number of active items,
+    /// the others keep their visibility.
+    inline void setNumActiveItems(int n) {
+        for (auto i = n_active_items_; i < n; i++)
+            items_[i]->setVisible(true);
+        for (auto i = n; i < n_active_items_; i++)
+            items_[i]->setVisible(false);
+        n_active_items_ = n;
+    }
+
     inline void checkAvailable(int n) {
         if (n > items_.size())
             throw InsufficientPoolSizeException(
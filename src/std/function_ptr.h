@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <type_traits>
 #include <utility>
 #include <new>
@@ -24,8 +25,75 @@ namespace std {
         }
     }
 
+    /// Converts a callable to a plain function pointer.
+    /// The callable is stored in a static slot shared by every call with the same
+    /// callable type and N, so a later call replaces whatever an earlier one captured.
+    /// Only use it for callables whose captures are the same for the whole process,
+    /// prefer member_function_ptr or user_data_function for per-instance callbacks.
     template<typename Fn, int N = 0, typename Callable>
     Fn *function_ptr(Callable &&c) {
         return detail::_function_ptr<N>(std::forward<Callable>(c), (Fn *) nullptr);
     }
+
+    namespace detail {
+        template<auto Method, typename = decltype(Method)>
+        struct member_trampoline;
+
+        template<auto Method, typename T, typename Ret, typename... Args>
+        struct member_trampoline<Method, Ret (T::*)(Args...)> {
+            static Ret call(Args... args, void *user_data) {
+                return (static_cast<T *>(user_data)->*Method)(std::forward<Args>(args)...);
+            }
+        };
+
+        template<auto Method, typename T, typename Ret, typename... Args>
+        struct member_trampoline<Method, Ret (T::*)(Args...) noexcept> {
+            static Ret call(Args... args, void *user_data) {
+                return (static_cast<T *>(user_data)->*Method)(std::forward<Args>(args)...);
+            }
+        };
+    }
+
+    /// Plain function pointer for C callbacks taking user_data as last argument,
+    /// that forwards the other arguments to Method of the object passed as user_data.
+    /// e.g. g_signal_connect(obj, "pad-added", G_CALLBACK(std::member_function_ptr<&Foo::on_pad_added>), foo)
+    /// calls foo->on_pad_added(element, pad).
+    template<auto Method>
+    inline constexpr auto member_function_ptr = &detail::member_trampoline<Method>::call;
+
+    template<typename Fn>
+    class user_data_function;
+
+    /// Heap allocated callable for C callbacks taking user_data as last argument.
+    /// Pass call as the callback, the object as user_data and destroy as its destroy notify:
+    ///   auto *fn = new std::user_data_function<void(GstPad *)>([this](GstPad *pad) { ... });
+    ///   gst_pad_add_probe(pad, mask, fn->callback(), fn, fn->destroy_notify());
+    /// Every registration owns its captures, so any number of instances can coexist.
+    template<typename Ret, typename... Args>
+    class user_data_function<Ret(Args...)> {
+        std::function<Ret(Args...)> fn_;
+
+    public:
+        using callback_type = Ret (*)(Args..., void *);
+        using destroy_notify_type = void (*)(void *);
+
+        template<typename Callable>
+        explicit user_data_function(Callable &&fn) : fn_(std::forward<Callable>(fn)) {}
+
+        static Ret call(Args... args, void *user_data) {
+            return static_cast<user_data_function *>(user_data)->fn_(std::forward<Args>(args)...);
+        }
+
+        static void destroy(void *user_data) {
+            delete static_cast<user_data_function *>(user_data);
+        }
+
+        [[nodiscard]] static constexpr callback_type callback() noexcept {
+            return &user_data_function::call;
+        }
+
+        [[nodiscard]] static constexpr destroy_notify_type destroy_notify() noexcept {
+            return &user_data_function::destroy;
+        }
+    };
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace std {
@@ -28,6 +29,17 @@ namespace std {
         }
     };
 
+    /// 64 bits FNV-1a, stable across runs unlike std::hash, for keys that are persisted.
+    inline std::uint64_t fnv1a_64(const void *data, std::size_t size,
+                                  std::uint64_t hash = 0xcbf29ce484222325ull) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
     template<typename T>
     struct static_hash : __hash_enum<T> {
     };
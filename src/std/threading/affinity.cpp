@@ -0,0 +1,102 @@
+#include "affinity.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MPOL_LOCAL
+#define MPOL_LOCAL 4
+#endif
+#endif
+
+namespace std {
+    namespace {
+        inline int parse_cpu_id(const std::string &str, const std::string &cpu_list) {
+            std::size_t pos = 0;
+            int cpu = -1;
+            try {
+                cpu = std::stoi(str, &pos);
+            } catch (const std::logic_error &) {
+                pos = 0;
+            }
+            if (pos == 0 || pos != str.size() || cpu < 0)
+                throw std::invalid_argument("invalid cpu list \"" + cpu_list + "\"");
+            return cpu;
+        }
+
+#ifdef __linux__
+
+        inline bool to_cpu_set(const std::vector<int> &cpus, cpu_set_t &cpu_set) {
+            CPU_ZERO(&cpu_set);
+            for (auto cpu: cpus) {
+                if (cpu >= CPU_SETSIZE)
+                    return false;
+                CPU_SET(cpu, &cpu_set);
+            }
+            return true;
+        }
+
+#endif
+    }
+
+    std::vector<int> parse_cpu_list(const std::string &cpu_list) {
+        std::vector<int> cpus;
+        std::stringstream ss(cpu_list);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            item.erase(std::remove_if(item.begin(), item.end(), ::isspace), item.end());
+            if (item.empty())
+                continue;
+            auto dash = item.find('-');
+            if (dash == std::string::npos) {
+                cpus.push_back(parse_cpu_id(item, cpu_list));
+                continue;
+            }
+            auto first = parse_cpu_id(item.substr(0, dash), cpu_list);
+            auto last = parse_cpu_id(item.substr(dash + 1), cpu_list);
+            if (last < first)
+                throw std::invalid_argument("invalid cpu list \"" + cpu_list + "\"");
+            for (auto cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        }
+        std::sort(cpus.begin(), cpus.end());
+        cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+        return cpus;
+    }
+
+    bool set_current_thread_affinity(const std::vector<int> &cpus) {
+#ifdef __linux__
+        return set_thread_affinity(pthread_self(), cpus);
+#else
+        return cpus.empty();
+#endif
+    }
+
+    bool set_thread_affinity(std::thread::native_handle_type handle, const std::vector<int> &cpus) {
+        if (cpus.empty())
+            return true;
+#ifdef __linux__
+        cpu_set_t cpu_set;
+        if (!to_cpu_set(cpus, cpu_set))
+            return false;
+        return pthread_setaffinity_np(handle, sizeof(cpu_set), &cpu_set) == 0;
+#else
+        return false;
+#endif
+    }
+
+    bool set_current_thread_numa_local() {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+        return syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) == 0;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace std {
+/// Parses a Linux style cpu list such as "0-3,8,10-11" into sorted unique core ids.
+/// An empty string gives an empty list, throws std::invalid_argument on malformed input.
+    std::vector<int> parse_cpu_list(const std::string &cpu_list);
+
+/// Pins the calling thread to the given cores, an empty list is a no-op.
+/// Returns false if the affinity could not be set or is not supported on this platform.
+    bool set_current_thread_affinity(const std::vector<int> &cpus);
+
+    bool set_thread_affinity(std::thread::native_handle_type handle, const std::vector<int> &cpus);
+
+/// Makes the calling thread allocate memory on the NUMA node it is running on,
+/// overriding any inherited policy (e.g. numactl --interleave). Combined with a
+/// single-socket affinity, pages first touched by this thread stay socket-local.
+    bool set_current_thread_numa_local();
+}
@@ -25,6 +25,8 @@
 #include <chrono>
 #include <deque>
 #include <algorithm>
+#include <mutex>
+#include <ostream>
 
 namespace std {
 
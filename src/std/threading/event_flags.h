@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#ifdef __linux__
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+
+#endif
+
+namespace std {
+/// A word of up to 32 event flags, like as many std::event sharing one atomic.
+/// Testing flags is a single load and setting them a single read-modify-write,
+/// a waiter only sleeps (on a futex on Linux, a condition variable elsewhere)
+/// while the flags it waits for are not all set, and setters only issue a wake-up
+/// when someone is actually sleeping.
+/// The state word lives on its own cache line so that polling it does not
+/// contend with neighbouring members.
+    class event_flags {
+    public:
+        using mask_type = std::uint32_t;
+
+    private:
+        static constexpr std::size_t cache_line_size_ = 64;
+
+        alignas(cache_line_size_) std::atomic<mask_type> state_;
+        std::atomic<std::uint32_t> num_waiters_{0};
+#ifndef __linux__
+        std::mutex lock_;
+        std::condition_variable cond_;
+#endif
+        // keep whatever follows off the state cache line
+        alignas(cache_line_size_) char padding_[1] = {};
+
+        inline void wake() {
+            // pairs with the fence in sleep(): either the waiter sees the new state
+            // or we see it registered
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (num_waiters_.load(std::memory_order_relaxed) == 0)
+                return;
+#ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&state_),
+                    FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+            std::lock_guard<std::mutex> lock_guard(lock_);
+            cond_.notify_all();
+#endif
+        }
+
+        /// Sleeps while the state is still expected, returns false on timeout.
+        inline bool sleep(mask_type expected, const std::chrono::nanoseconds *timeout) {
+            num_waiters_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool timed_out = false;
+            if (state_.load(std::memory_order_relaxed) == expected) {
+#ifdef __linux__
+                struct timespec ts{};
+                if (timeout) {
+                    ts.tv_sec = static_cast<time_t>(timeout->count() / 1000000000);
+                    ts.tv_nsec = static_cast<long>(timeout->count() % 1000000000);
+                }
+                // returns immediately if the state changed in the meantime
+                timed_out = syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&state_),
+                                    FUTEX_WAIT_PRIVATE, expected, timeout ? &ts : nullptr, nullptr, 0) == -1 &&
+                            errno == ETIMEDOUT;
+#else
+                std::unique_lock<std::mutex> unique_lock(lock_);
+                auto changed = [&]() { return state_.load(std::memory_order_relaxed) != expected; };
+                if (timeout)
+                    timed_out = !cond_.wait_for(unique_lock, *timeout, changed);
+                else
+                    cond_.wait(unique_lock, changed);
+#endif
+            }
+            num_waiters_.fetch_sub(1, std::memory_order_relaxed);
+            return !timed_out;
+        }
+
+    public:
+        explicit event_flags(mask_type initial = 0) : state_(initial) {
+            static_assert(sizeof(std::atomic<mask_type>) == sizeof(std::uint32_t),
+                          "event_flags requires a lock-free 32-bit atomic");
+        }
+
+        event_flags(const event_flags &) = delete;
+
+        event_flags &operator=(const event_flags &) = delete;
+
+        [[nodiscard]] inline mask_type load(std::memory_order order = std::memory_order_acquire) const noexcept {
+            return state_.load(order);
+        }
+
+        /// True if all flags of mask are set. Relaxed by default, pass an acquire order
+        /// when the caller reads data published before the flags were set.
+        [[nodiscard]] inline bool test(mask_type mask,
+                                       std::memory_order order = std::memory_order_relaxed) const noexcept {
+            return (state_.load(order) & mask) == mask;
+        }
+
+        [[nodiscard]] inline bool test_any(mask_type mask,
+                                           std::memory_order order = std::memory_order_relaxed) const noexcept {
+            return (state_.load(order) & mask) != 0;
+        }
+
+        inline void set(mask_type mask) {
+            auto old = state_.fetch_or(mask, std::memory_order_release);
+            if ((old & mask) != mask)
+                wake();
+        }
+
+        inline void clear(mask_type mask) noexcept {
+            state_.fetch_and(~mask, std::memory_order_release);
+        }
+
+        /// Sets the flags of mask if set_state, clears them otherwise.
+        inline void assign(mask_type mask, bool set_state) {
+            if (set_state)
+                set(mask);
+            else
+                clear(mask);
+        }
+
+        /// Flips the flags of mask and returns the previous state.
+        inline mask_type toggle(mask_type mask) {
+            auto old = state_.fetch_xor(mask, std::memory_order_acq_rel);
+            if (~old & mask)
+                wake();
+            return old;
+        }
+
+        /// Blocks until all flags of mask are set.
+        inline void wait(mask_type mask) {
+            auto state = state_.load(std::memory_order_acquire);
+            while ((state & mask) != mask) {
+                sleep(state, nullptr);
+                state = state_.load(std::memory_order_acquire);
+            }
+        }
+
+        /// Blocks until all flags of mask are set or timeout expires, returns whether they are set.
+        template<typename _Rep, typename _Period>
+        inline bool wait_for(mask_type mask, const chrono::duration<_Rep, _Period> &timeout) {
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            auto state = state_.load(std::memory_order_acquire);
+            while ((state & mask) != mask) {
+                auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        deadline - std::chrono::steady_clock::now());
+                if (remaining.count() <= 0 || !sleep(state, &remaining))
+                    return test(mask, std::memory_order_acquire);
+                state = state_.load(std::memory_order_acquire);
+            }
+            return true;
+        }
+    };
+}
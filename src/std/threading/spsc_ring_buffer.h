@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+namespace std {
+/// Bounded single-producer/single-consumer ring buffer.
+/// Indices live on separate cache lines, each side keeps a cached copy of the
+/// other side's index so that the shared lines are only touched when needed.
+/// Producer operations are wait-free. Consumer operations are lock-free, they only
+/// retry when the item being read was overwritten by push() in the meantime.
+/// Items are stored in atomic slots, hence T must be trivially copyable
+/// (typically a pointer such as GstSample*, whose ownership moves with the item).
+    template<typename T>
+    class spsc_ring_buffer {
+        static_assert(std::is_trivially_copyable_v<T>, "spsc_ring_buffer requires a trivially copyable type");
+
+        static constexpr std::size_t cache_line_size_ = 64;
+
+        static constexpr std::size_t round_up_pow2(std::size_t n) {
+            std::size_t r = 1;
+            while (r < n)
+                r <<= 1;
+            return r;
+        }
+
+        const std::size_t capacity_;
+        const std::size_t mask_;
+        std::unique_ptr<std::atomic<T>[]> slots_;
+
+        // producer side
+        alignas(cache_line_size_) std::atomic<std::size_t> head_{0};
+        std::size_t cached_tail_ = 0;
+        // consumer side
+        alignas(cache_line_size_) std::atomic<std::size_t> tail_{0};
+        std::size_t cached_head_ = 0;
+
+    public:
+        using value_type = T;
+
+        /// Capacity is rounded up to the next power of two.
+        explicit spsc_ring_buffer(std::size_t capacity)
+                : capacity_(round_up_pow2(capacity ? capacity : 1)),
+                  mask_(capacity_ - 1),
+                  slots_(new std::atomic<T>[capacity_]) {}
+
+        spsc_ring_buffer(const spsc_ring_buffer &) = delete;
+
+        spsc_ring_buffer &operator=(const spsc_ring_buffer &) = delete;
+
+        [[nodiscard]] inline std::size_t capacity() const noexcept {
+            return capacity_;
+        }
+
+        /// Approximate when called concurrently with the other side.
+        [[nodiscard]] inline std::size_t size() const noexcept {
+            auto tail = tail_.load(std::memory_order_acquire);
+            auto head = head_.load(std::memory_order_acquire);
+            return head - tail;
+        }
+
+        [[nodiscard]] inline bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        /// Producer only. Returns false without pushing when full.
+        inline bool try_push(const T &value) noexcept {
+            auto head = head_.load(std::memory_order_relaxed);
+            if (head - cached_tail_ >= capacity_) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head - cached_tail_ >= capacity_)
+                    return false;
+            }
+            slots_[head & mask_].store(value, std::memory_order_relaxed);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// Producer only. Overwrites the oldest item when full and returns it,
+        /// so that the caller can release whatever it owns.
+        inline std::optional<T> push(const T &value) noexcept {
+            std::optional<T> dropped;
+            auto head = head_.load(std::memory_order_relaxed);
+            if (head - cached_tail_ >= capacity_) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head - cached_tail_ >= capacity_) {
+                    auto tail = cached_tail_;
+                    auto oldest = slots_[tail & mask_].load(std::memory_order_relaxed);
+                    // on failure the consumer has just taken it and there is room now
+                    if (tail_.compare_exchange_strong(tail, tail + 1,
+                                                      std::memory_order_acq_rel, std::memory_order_acquire)) {
+                        dropped = oldest;
+                        tail++;
+                    }
+                    cached_tail_ = tail;
+                }
+            }
+            slots_[head & mask_].store(value, std::memory_order_relaxed);
+            head_.store(head + 1, std::memory_order_release);
+            return dropped;
+        }
+
+        /// Consumer only. Returns std::nullopt when empty.
+        inline std::optional<T> try_pop() noexcept {
+            auto tail = tail_.load(std::memory_order_acquire);
+            while (true) {
+                // tail may have been moved past the cached head by push()
+                if (tail >= cached_head_) {
+                    cached_head_ = head_.load(std::memory_order_acquire);
+                    if (tail == cached_head_)
+                        return std::nullopt;
+                }
+                auto value = slots_[tail & mask_].load(std::memory_order_relaxed);
+                // fails only if the producer overwrote this item, tail is reloaded then
+                if (tail_.compare_exchange_weak(tail, tail + 1,
+                                                std::memory_order_acq_rel, std::memory_order_acquire))
+                    return value;
+            }
+        }
+    };
+
+/// Adapter of spsc_ring_buffer whose consumer can block on an empty buffer.
+/// The producer only touches the mutex when the consumer is actually waiting.
+    template<typename T>
+    class blocking_spsc_ring_buffer {
+        spsc_ring_buffer<T> buffer_;
+        std::mutex lock_;
+        std::condition_variable cond_;
+        std::atomic_bool waiting_{false};
+        std::atomic_bool closed_{false};
+
+        inline void notify() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock_guard(lock_);
+                cond_.notify_one();
+            }
+        }
+
+        template<typename Predicate>
+        inline std::optional<T> wait_pop(Predicate &&wait) {
+            // items usually arrive shortly, yield a few times before going to sleep
+            for (int i = 0; i < 16; i++) {
+                if (auto value = buffer_.try_pop())
+                    return value;
+                std::this_thread::yield();
+            }
+            std::unique_lock<std::mutex> unique_lock(lock_);
+            waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::optional<T> value;
+            wait(unique_lock, [&]() {
+                value = buffer_.try_pop();
+                return value.has_value() || closed_.load(std::memory_order_acquire);
+            });
+            waiting_.store(false, std::memory_order_relaxed);
+            return value;
+        }
+
+    public:
+        using value_type = T;
+
+        explicit blocking_spsc_ring_buffer(std::size_t capacity) : buffer_(capacity) {}
+
+        [[nodiscard]] inline std::size_t capacity() const noexcept {
+            return buffer_.capacity();
+        }
+
+        [[nodiscard]] inline std::size_t size() const noexcept {
+            return buffer_.size();
+        }
+
+        [[nodiscard]] inline bool empty() const noexcept {
+            return buffer_.empty();
+        }
+
+        [[nodiscard]] inline bool is_closed() const noexcept {
+            return closed_.load(std::memory_order_acquire);
+        }
+
+        /// Wakes up the consumer, pop() returns std::nullopt once the buffer is drained.
+        inline void close() {
+            closed_.store(true, std::memory_order_release);
+            std::lock_guard<std::mutex> lock_guard(lock_);
+            cond_.notify_all();
+        }
+
+        inline bool try_push(const T &value) {
+            if (!buffer_.try_push(value))
+                return false;
+            notify();
+            return true;
+        }
+
+        inline std::optional<T> push(const T &value) {
+            auto dropped = buffer_.push(value);
+            notify();
+            return dropped;
+        }
+
+        inline std::optional<T> try_pop() noexcept {
+            return buffer_.try_pop();
+        }
+
+        /// Blocks until an item is available or the buffer is closed.
+        inline std::optional<T> pop() {
+            return wait_pop([this](std::unique_lock<std::mutex> &lock, auto &&pred) {
+                cond_.wait(lock, pred);
+            });
+        }
+
+        template<typename _Rep, typename _Period>
+        inline std::optional<T> pop_for(const chrono::duration<_Rep, _Period> &timeout) {
+            return wait_pop([this, &timeout](std::unique_lock<std::mutex> &lock, auto &&pred) {
+                cond_.wait_for(lock, timeout, pred);
+            });
+        }
+    };
+}
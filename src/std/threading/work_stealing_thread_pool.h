@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace std {
+/// Thread pool in which every worker owns a task deque.
+/// Workers pop their own tasks LIFO and steal from the front of the others' deques
+/// when they run out. Tasks submitted from a worker go to its own deque, other
+/// threads distribute them round-robin.
+/// Threads waiting on a parallel_for() help executing pending tasks, so nested
+/// parallelism does not deadlock.
+    class work_stealing_thread_pool {
+        struct task_queue {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<task_queue>> queues_;
+        std::vector<std::thread> threads_;
+        std::mutex wake_lock_;
+        std::condition_variable wake_cond_;
+        std::atomic_size_t num_pending_{0};
+        std::atomic_size_t next_queue_{0};
+        std::atomic_bool stopping_{false};
+
+        static inline thread_local work_stealing_thread_pool *current_pool_ = nullptr;
+        static inline thread_local std::size_t current_index_ = 0;
+
+        inline void push(std::function<void()> task) {
+            auto index = current_pool_ == this
+                         ? current_index_
+                         : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+            {
+                std::lock_guard<std::mutex> lock_guard(queues_[index]->lock);
+                queues_[index]->tasks.push_back(std::move(task));
+            }
+            num_pending_.fetch_add(1, std::memory_order_release);
+            std::lock_guard<std::mutex> lock_guard(wake_lock_);
+            wake_cond_.notify_one();
+        }
+
+        inline bool pop(std::size_t index, std::function<void()> &task) {
+            auto &queue = *queues_[index];
+            std::lock_guard<std::mutex> lock_guard(queue.lock);
+            if (queue.tasks.empty())
+                return false;
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+
+        inline bool steal(std::size_t thief, std::function<void()> &task) {
+            for (std::size_t i = 1; i <= queues_.size(); i++) {
+                auto &queue = *queues_[(thief + i) % queues_.size()];
+                std::unique_lock<std::mutex> lock(queue.lock, std::try_to_lock);
+                if (!lock.owns_lock() || queue.tasks.empty())
+                    continue;
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+            return false;
+        }
+
+        inline void worker_loop(std::size_t index) {
+            current_pool_ = this;
+            current_index_ = index;
+            while (true) {
+                if (run_pending_task())
+                    continue;
+                std::unique_lock<std::mutex> lock(wake_lock_);
+                wake_cond_.wait(lock, [this]() {
+                    return stopping_.load(std::memory_order_acquire) ||
+                           num_pending_.load(std::memory_order_acquire) > 0;
+                });
+                if (stopping_.load(std::memory_order_acquire) && num_pending_.load(std::memory_order_acquire) == 0)
+                    return;
+            }
+        }
+
+    public:
+        /// A pool of 0 threads runs every task in the calling thread.
+        explicit work_stealing_thread_pool(std::size_t num_threads = std::thread::hardware_concurrency()) {
+            queues_.reserve(std::max<std::size_t>(num_threads, 1));
+            for (std::size_t i = 0; i < std::max<std::size_t>(num_threads, 1); i++)
+                queues_.emplace_back(std::make_unique<task_queue>());
+            threads_.reserve(num_threads);
+            for (std::size_t i = 0; i < num_threads; i++)
+                threads_.emplace_back(&work_stealing_thread_pool::worker_loop, this, i);
+        }
+
+        work_stealing_thread_pool(const work_stealing_thread_pool &) = delete;
+
+        work_stealing_thread_pool &operator=(const work_stealing_thread_pool &) = delete;
+
+        ~work_stealing_thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock_guard(wake_lock_);
+                stopping_.store(true, std::memory_order_release);
+            }
+            wake_cond_.notify_all();
+            for (auto &thread: threads_)
+                thread.join();
+        }
+
+        [[nodiscard]] inline std::size_t num_threads() const noexcept {
+            return threads_.size();
+        }
+
+        /// Applies fn to every thread of the pool, e.g. to set their affinity.
+        template<typename F>
+        inline void for_each_thread(F &&fn) {
+            for (auto &thread: threads_)
+                fn(thread);
+        }
+
+        /// Runs one pending task in the calling thread, returns false if there was none.
+        inline bool run_pending_task() {
+            std::function<void()> task;
+            auto index = current_pool_ == this ? current_index_ : 0;
+            if (!(current_pool_ == this && pop(index, task)) && !steal(index, task))
+                return false;
+            num_pending_.fetch_sub(1, std::memory_order_acq_rel);
+            task();
+            return true;
+        }
+
+        template<typename F, typename... Args>
+        inline auto submit(F &&fn, Args &&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+            using result_type = std::invoke_result_t<F, Args...>;
+            auto task = std::make_shared<std::packaged_task<result_type()>>(
+                    std::bind(std::forward<F>(fn), std::forward<Args>(args)...));
+            auto future = task->get_future();
+            if (threads_.empty())
+                (*task)();
+            else
+                push([task]() { (*task)(); });
+            return future;
+        }
+
+        /// Calls fn(i) for every i in [begin, end), in chunks of at least grain_size
+        /// indices. The calling thread takes part and returns once all calls are done,
+        /// rethrowing the first exception raised by fn.
+        template<typename F>
+        inline void parallel_for(std::size_t begin, std::size_t end, F &&fn, std::size_t grain_size = 1) {
+            if (end <= begin)
+                return;
+            grain_size = std::max<std::size_t>(grain_size, 1);
+            auto num_chunks = std::min((end - begin + grain_size - 1) / grain_size, threads_.size() + 1);
+            if (num_chunks <= 1) {
+                for (auto i = begin; i < end; i++)
+                    fn(i);
+                return;
+            }
+
+            auto chunk_size = (end - begin + num_chunks - 1) / num_chunks;
+            std::atomic_size_t num_remaining{num_chunks};
+            std::exception_ptr exception;
+            std::mutex exception_lock;
+            auto run_chunk = [&](std::size_t chunk) {
+                try {
+                    auto chunk_end = std::min(end, begin + (chunk + 1) * chunk_size);
+                    for (auto i = begin + chunk * chunk_size; i < chunk_end; i++)
+                        fn(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock_guard(exception_lock);
+                    if (!exception)
+                        exception = std::current_exception();
+                }
+                num_remaining.fetch_sub(1, std::memory_order_acq_rel);
+            };
+            for (std::size_t chunk = 1; chunk < num_chunks; chunk++)
+                push([&run_chunk, chunk]() { run_chunk(chunk); });
+            run_chunk(0);
+            while (num_remaining.load(std::memory_order_acquire) > 0) {
+                if (!run_pending_task())
+                    std::this_thread::yield();
+            }
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+    };
+
+/// Runs fn(i) for i in [begin, end) on pool, or serially if pool is null.
+    template<typename F>
+    inline void parallel_for(work_stealing_thread_pool *pool,
+                             std::size_t begin, std::size_t end, F &&fn, std::size_t grain_size = 1) {
+        if (pool) {
+            pool->parallel_for(begin, end, std::forward<F>(fn), grain_size);
+        } else {
+            for (auto i = begin; i < end; i++)
+                fn(i);
+        }
+    }
+}
@@ -38,6 +38,8 @@ namespace YAML {
                 node["label"] = rhs.label;
             node["confidence"] = rhs.confidence;
             node["bbox"] = convert<cv::Rect2d>::encode(rhs.bbox);
+            if (rhs.track_id >= 0)
+                node["track_id"] = rhs.track_id;
             return node;
         }
 
@@ -48,6 +50,7 @@ namespace YAML {
             rhs.label = node["label"].as<std::string>("");
             rhs.confidence = node["confidence"].as<float>();
             rhs.bbox = node["bbox"].as<cv::Rect2d>();
+            rhs.track_id = node["track_id"].as<int>(-1);
             return true;
         }
     };
@@ -0,0 +1,386 @@
+/**
+ * Offline detection over many recorded files, for throughput rather than latency.
+ * Up to --jobs files are decoded concurrently, each by its own pipeline built from
+ * app.batch.decode_description with no display branch and no frame dropping.
+ * Decoded frames of all files are gathered into batches for a single shared
+ * Yolo<LibTorch>. Detections of every file are appended to a detection log of its own,
+ * <output>/<index>_<stem>.ltdl, and <output>/files.txt maps the indices to the input paths.
+ *
+ *  lantorch_batch [--config ../resources/configs.yaml] [--output detections]
+ *                 [--jobs N] [--batch-size B] [--verbose] file|directory...
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+#include <gst/gst.h>
+#include <gst/app/app.h>
+#include <gst/video/video.h>
+
+#include <opencv2/core.hpp>
+
+#undef slots
+
+#include <torch/cuda.h>
+
+#define slots Q_SLOTS
+
+#include "app/app_config.h"
+#include "app/app_thread_pool.h"
+#include "app/dnn/yolo_inference_worker_factory.h"
+#include "dnn/detection_log.h"
+#include "dnn/ultralytics/yolo.h"
+#include "std/threading/blocking_collection.h"
+
+namespace {
+    struct BatchArgs {
+        std::string config_filepath = "../resources/configs.yaml";
+        std::string output_dirpath = "detections";
+        std::vector<std::string> input_paths;
+        unsigned int jobs = 0;
+        unsigned int batch_size = 0;
+        bool verbose = false;
+    };
+
+    void print_usage(const char *prog) {
+        std::cerr << "usage: " << prog << " [--config configs.yaml] [--output directory]"
+                  << " [--jobs N] [--batch-size B] [--verbose] file|directory...\n"
+                  << "  directories are searched recursively for video files\n"
+                  << "  --output  directory of the detection logs, one per input file\n";
+    }
+
+    bool parse_args(int argc, char *argv[], BatchArgs &args) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char * { return i + 1 < argc ? argv[++i] : nullptr; };
+            const char *value = nullptr;
+            if (arg == "--config" && (value = next())) {
+                args.config_filepath = value;
+            } else if (arg == "--output" && (value = next())) {
+                args.output_dirpath = value;
+            } else if (arg == "--jobs" && (value = next())) {
+                args.jobs = std::stoul(value);
+            } else if (arg == "--batch-size" && (value = next())) {
+                args.batch_size = std::stoul(value);
+            } else if (arg == "--verbose") {
+                args.verbose = true;
+            } else if (!arg.empty() && arg[0] != '-') {
+                args.input_paths.push_back(arg);
+            } else {
+                return false;
+            }
+        }
+        return !args.input_paths.empty();
+    }
+
+    bool is_video_file(const std::filesystem::path &path) {
+        auto ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        return ext == ".mp4" || ext == ".mkv" || ext == ".mov" || ext == ".avi" || ext == ".webm" ||
+               ext == ".ts" || ext == ".m4v" || ext == ".mpg" || ext == ".mpeg";
+    }
+
+    std::vector<std::string> collect_input_files(const std::vector<std::string> &input_paths) {
+        std::vector<std::string> filepaths;
+        for (const auto &input_path: input_paths) {
+            if (!std::filesystem::is_directory(input_path)) {
+                filepaths.push_back(input_path);
+                continue;
+            }
+            for (const auto &entry: std::filesystem::recursive_directory_iterator(input_path)) {
+                if (entry.is_regular_file() && is_video_file(entry.path()))
+                    filepaths.push_back(entry.path().string());
+            }
+        }
+        std::sort(filepaths.begin(), filepaths.end());
+        filepaths.erase(std::unique(filepaths.begin(), filepaths.end()), filepaths.end());
+        return filepaths;
+    }
+
+    std::string detection_log_filepath(const std::string &output_dirpath, std::size_t file_index,
+                                       const std::string &input_filepath) {
+        auto stem = std::filesystem::path(input_filepath).stem().string();
+        return (std::filesystem::path(output_dirpath) / fmt::format("{:05d}_{}.ltdl", file_index, stem)).string();
+    }
+
+    /// A decoded frame, mapped until it has been inferred.
+    /// A frame with nothing mapped marks the end of its file.
+    struct DecodedFrame {
+        std::size_t file_index = 0;
+        guint64 frame_index = 0;
+        GstClockTime pts = GST_CLOCK_TIME_NONE;
+        GstVideoFrame frame{};
+        cv::Mat mat;
+
+        ~DecodedFrame() {
+            if (frame.buffer)
+                gst_video_frame_unmap(&frame);
+        }
+    };
+
+    using FrameQueue = std::BlockingQueue<DecodedFrame *>;
+
+    struct FileStats {
+        std::atomic<guint64> num_frames{0};
+        std::atomic_bool failed{false};
+    };
+
+    /// Decodes files[next_file++] until none is left, pushing every frame into queue.
+    void decode_files(const std::vector<std::string> &filepaths,
+                      std::atomic_size_t &next_file,
+                      const std::string &description_format,
+                      FrameQueue &queue,
+                      std::vector<FileStats> &stats) {
+        for (auto i = next_file++; i < filepaths.size(); i = next_file++) {
+            auto description = fmt::format(description_format, fmt::arg("filepath", filepaths[i]));
+            GError *error = NULL;
+            auto *pipeline = gst_parse_launch(description.c_str(), &error);
+            auto *app_sink = pipeline ? gst_bin_get_by_name(GST_BIN(pipeline), "batch_sink") : NULL;
+            if (error || !app_sink ||
+                gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+                g_printerr("Failed to decode %s: %s\n", filepaths[i].c_str(),
+                           error ? error->message : "no batch_sink or state change failure");
+                g_clear_error(&error);
+                stats[i].failed = true;
+                if (app_sink)
+                    gst_object_unref(app_sink);
+                if (pipeline) {
+                    gst_element_set_state(pipeline, GST_STATE_NULL);
+                    gst_object_unref(pipeline);
+                }
+                continue;
+            }
+
+            GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+            GstCaps *caps = NULL;
+            GstVideoInfo info;
+            gst_video_info_init(&info);
+            guint64 frame_index = 0;
+            while (true) {
+                // errors do not end the appsink stream, so poll the bus between pulls
+                if (GstMessage *message = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR)) {
+                    gst_message_parse_error(message, &error, NULL);
+                    g_printerr("Error decoding %s: %s\n", filepaths[i].c_str(), error ? error->message : "unknown");
+                    g_clear_error(&error);
+                    gst_message_unref(message);
+                    stats[i].failed = true;
+                    break;
+                }
+                auto *sample = gst_app_sink_try_pull_sample(GST_APP_SINK(app_sink), 100 * GST_MSECOND);
+                if (!sample) {
+                    if (gst_app_sink_is_eos(GST_APP_SINK(app_sink)))
+                        break;
+                    continue;
+                }
+                auto *sample_caps = gst_sample_get_caps(sample);
+                if (sample_caps != caps) {
+                    gst_caps_replace(&caps, sample_caps);
+                    gst_video_info_from_caps(&info, caps);
+                }
+                // the mapped frame keeps a reference to the buffer
+                GstVideoFrame video_frame;
+                auto mapped = gst_video_frame_map(&video_frame, &info, gst_sample_get_buffer(sample), GST_MAP_READ);
+                gst_sample_unref(sample);
+                if (!mapped)
+                    continue;
+                auto *frame = new DecodedFrame();
+                frame->file_index = i;
+                frame->frame_index = frame_index++;
+                frame->pts = GST_BUFFER_PTS(video_frame.buffer);
+                frame->frame = video_frame;
+                frame->mat = cv::Mat(GST_VIDEO_FRAME_HEIGHT(&frame->frame), GST_VIDEO_FRAME_WIDTH(&frame->frame),
+                                     CV_8UC3, GST_VIDEO_FRAME_PLANE_DATA(&frame->frame, 0),
+                                     GST_VIDEO_FRAME_PLANE_STRIDE(&frame->frame, 0));
+                stats[i].num_frames++;
+                // blocks while the model is behind, which back-pressures the decoder
+                queue.add(frame);
+            }
+            // behind every frame of the file, as a single decoder handles it
+            auto *end_of_file = new DecodedFrame();
+            end_of_file->file_index = i;
+            queue.add(end_of_file);
+            gst_caps_replace(&caps, NULL);
+            gst_object_unref(bus);
+            gst_object_unref(app_sink);
+            gst_element_set_state(pipeline, GST_STATE_NULL);
+            gst_object_unref(pipeline);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BatchArgs args;
+    if (!parse_args(argc, argv, args)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    auto configs = AppConfig::load(args.config_filepath);
+    AppThreadPool::configure(configs["app"]["threading"]);
+    gst_init(&argc, &argv);
+
+    auto batch_config = configs["app"]["batch"];
+    auto jobs = args.jobs ? args.jobs : batch_config["jobs"].as<unsigned int>(0);
+    if (!jobs)
+        jobs = std::max(std::thread::hardware_concurrency() / 2, 1u);
+    auto batch_size = std::max(args.batch_size ? args.batch_size : batch_config["batch_size"].as<unsigned int>(8), 1u);
+    auto batch_timeout = std::chrono::milliseconds(batch_config["batch_timeout"].as<int>(10));
+    auto description_format = batch_config["decode_description"].as<std::string>();
+
+    auto filepaths = collect_input_files(args.input_paths);
+    if (filepaths.empty()) {
+        std::cerr << "no input files\n";
+        return 1;
+    }
+
+    /* Model */
+    auto yolo_infer_config = configs["app"]["dnn"]["yolo_infer"];
+    auto device = yolo_infer_config["device"].as<at::Device>(torch::cuda::is_available() ? at::kCUDA : at::kCPU);
+    auto dtype = yolo_infer_config["dtype"].as<at::ScalarType>(at::kFloat);
+    auto options = yolo_options_from_config(yolo_infer_config["yolo_options"]);
+    ultralytics::YoloLibTorch model(
+            yolo_infer_config["model_filepath"].as<AppConfig::crel_path>().string(),
+            yolo_infer_config["classes_filepath"].IsDefined()
+            ? yolo_infer_config["classes_filepath"].as<AppConfig::crel_path>().string() : "",
+            options, device);
+    model.to(device, dtype);
+    model.eval();
+    model.set_thread_pool(AppThreadPool::instance());
+    {
+        // specialize the graph for full batches before the clock starts
+        at::NoGradGuard no_grad;
+        auto dummy_input = at::zeros({static_cast<int64_t>(batch_size), 3, options.input_height(), options.input_width()},
+                                     at::TensorOptions(device).dtype(dtype));
+        for (int i = 0; i < 2; i++)
+            model.forward(dummy_input);
+    }
+
+    std::error_code error_code;
+    std::filesystem::create_directories(args.output_dirpath, error_code);
+    auto *files_list = std::fopen((std::filesystem::path(args.output_dirpath) / "files.txt").string().c_str(), "w");
+    if (!files_list) {
+        std::cerr << "failed to write to " << args.output_dirpath << "\n";
+        return 1;
+    }
+    for (std::size_t i = 0; i < filepaths.size(); i++)
+        fmt::print(files_list, "{}\t{}\n", i, filepaths[i]);
+    std::fclose(files_list);
+    auto classes_names = model.classes_names();
+    std::vector<std::string> class_names(classes_names.begin(), classes_names.end());
+    // opened on the first frame of a file and closed at its end, so only files in flight hold a writer
+    std::vector<std::unique_ptr<DetectionLogWriter>> detection_logs(filepaths.size());
+    std::size_t num_failed_logs = 0;
+
+    /* Decoders */
+    auto start_time = std::chrono::steady_clock::now();
+    FrameQueue queue(std::max<std::size_t>(batch_size * 2, batch_config["queue_size"].as<std::size_t>(0)));
+    std::vector<FileStats> stats(filepaths.size());
+    std::atomic_size_t next_file{0};
+    std::vector<std::thread> decoders;
+    for (unsigned int j = 0; j < std::min<std::size_t>(jobs, filepaths.size()); j++)
+        decoders.emplace_back(decode_files, std::cref(filepaths), std::ref(next_file),
+                              std::cref(description_format), std::ref(queue), std::ref(stats));
+    std::thread decoders_joiner([&decoders, &queue]() {
+        for (auto &decoder: decoders)
+            decoder.join();
+        queue.complete_adding();
+    });
+
+    /* Inference */
+    std::vector<DecodedFrame *> batch;
+    std::vector<cv::Mat> inputs;
+    guint64 num_frames = 0, num_detections = 0, num_batches = 0;
+    DecodedFrame *frame = nullptr;
+    at::NoGradGuard no_grad;
+    std::vector<std::size_t> ended_files;
+    while (queue.take(frame) == std::BlockingCollectionStatus::Ok) {
+        batch.clear();
+        ended_files.clear();
+        // fill the batch with what the decoders produce meanwhile
+        auto deadline = std::chrono::steady_clock::now() + batch_timeout;
+        while (true) {
+            if (frame->frame.buffer) {
+                batch.push_back(frame);
+            } else {
+                ended_files.push_back(frame->file_index);
+                delete frame;
+            }
+            if (batch.size() >= batch_size)
+                break;
+            auto remaining = deadline - std::chrono::steady_clock::now();
+            if (remaining <= remaining.zero() ||
+                queue.try_take(frame, remaining) != std::BlockingCollectionStatus::Ok)
+                break;
+        }
+
+        if (!batch.empty()) {
+            inputs.clear();
+            for (auto *f: batch)
+                inputs.push_back(f->mat);
+            auto detections = model.forward_batch(inputs);
+            for (std::size_t b = 0; b < batch.size(); b++) {
+                auto file_index = batch[b]->file_index;
+                auto &detection_log = detection_logs[file_index];
+                if (!detection_log) {
+                    detection_log = std::make_unique<DetectionLogWriter>(
+                            detection_log_filepath(args.output_dirpath, file_index, filepaths[file_index]),
+                            class_names);
+                    if (!detection_log->is_open())
+                        num_failed_logs++;
+                }
+                if (detection_log->is_open())
+                    detection_log->append(batch[b]->frame_index,
+                                          GST_CLOCK_TIME_IS_VALID(batch[b]->pts)
+                                          ? batch[b]->pts : DetectionLogWriter::PTS_NONE,
+                                          detections[b]);
+                num_detections += detections[b].size();
+                delete batch[b];
+            }
+        }
+        // the end of a file is taken after all of its frames, which are in this batch at the latest
+        for (auto file_index: ended_files) {
+            if (detection_logs[file_index]) {
+                detection_logs[file_index]->close();
+                detection_logs[file_index].reset();
+            }
+        }
+        if (batch.empty())
+            continue;
+        num_frames += batch.size();
+        num_batches++;
+        if (args.verbose && num_batches % 100 == 0) {
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            std::cerr << fmt::format("{} frames, {:.1f} fps, {} files started\n",
+                                     num_frames, (double) num_frames / seconds,
+                                     std::min(next_file.load(), filepaths.size()));
+        }
+    }
+    decoders_joiner.join();
+    for (auto &detection_log: detection_logs) {
+        if (detection_log)
+            detection_log->close();
+    }
+
+    /* Report */
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    std::size_t num_failed = 0;
+    for (const auto &file_stats: stats)
+        num_failed += file_stats.failed;
+    std::cout << fmt::format(
+            R"({{"files": {}, "failed_files": {}, "failed_logs": {}, "frames": {}, "detections": {}, )"
+            R"("batches": {}, "mean_batch_size": {:.2f}, "seconds": {:.3f}, "fps": {:.2f}}})",
+            filepaths.size(), num_failed, num_failed_logs, num_frames, num_detections, num_batches,
+            num_batches ? (double) num_frames / (double) num_batches : 0.,
+            seconds, seconds > 0 ? (double) num_frames / seconds : 0.) << std::endl;
+    return num_failed || num_failed_logs ? 2 : 0;
+}
@@ -0,0 +1,326 @@
+/**
+ * Headless decode -> infer -> postprocess benchmark.
+ * Builds the stem_bin of the config with its display sink replaced by a fakesink,
+ * runs the YoloInferenceWorker over the input file as fast as possible and prints
+ * throughput, per-stage latency percentiles, CPU usage and peak RSS as JSON.
+ *
+ * With --replay, pre-decoded frames are pushed through the replay stem instead, at --rate
+ * times real-time (0 for as fast as possible), which takes decoding out of the measurement.
+ * --record-frames writes the decoded frames of a run into a container that --replay accepts.
+ *
+ *  lantorch_bench [--config ../resources/configs.yaml] [--input file.mp4]
+ *                 [--replay frames.ltrf|dir] [--rate R] [--record-frames frames.ltrf]
+ *                 [--output result.json] [--max-frames N] [--drop] [--verbose]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+
+#include <sys/resource.h>
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+#include <gst/gst.h>
+#include <gst/app/app.h>
+
+#include <QCoreApplication>
+#include <QTimer>
+
+#undef slots
+
+#include <torch/cuda.h>
+
+#define slots Q_SLOTS
+
+#include "app/app_config.h"
+#include "app/app_thread_pool.h"
+#include "app/dnn/yolo_inference_worker_factory.h"
+#include "app/gst/gst_pipeline_manager.h"
+#include "gst/gst_buffer_probe.h"
+#include "gst/utils/frame_replay_file.h"
+#include "gst/utils/latency_tracer.h"
+
+namespace {
+    struct BenchArgs {
+        std::string config_filepath = "../resources/configs.yaml";
+        std::string input_filepath;
+        std::string replay_path;
+        double replay_rate = 0.;
+        std::string record_frames_filepath;
+        std::string output_filepath;
+        unsigned long max_frames = 0;
+        bool drop = false;
+        bool verbose = false;
+    };
+
+    void print_usage(const char *prog) {
+        std::cerr << "usage: " << prog << " [--config configs.yaml] [--input file]"
+                  << " [--replay container|dir] [--rate R] [--record-frames container]"
+                  << " [--output result.json] [--max-frames N] [--drop] [--verbose]\n"
+                  << "  --rate  replay speed, 1 for real-time, 0 (default) for as fast as possible\n"
+                  << "  --drop  let the appsink and the sample ring of the config drop frames the model"
+                  << " cannot keep up with, by default every decoded frame is inferred\n";
+    }
+
+    bool parse_args(int argc, char *argv[], BenchArgs &args) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char * { return i + 1 < argc ? argv[++i] : nullptr; };
+            const char *value = nullptr;
+            if (arg == "--config" && (value = next())) {
+                args.config_filepath = value;
+            } else if (arg == "--input" && (value = next())) {
+                args.input_filepath = value;
+            } else if (arg == "--replay" && (value = next())) {
+                args.replay_path = value;
+            } else if (arg == "--rate" && (value = next())) {
+                args.replay_rate = std::stod(value);
+            } else if (arg == "--record-frames" && (value = next())) {
+                args.record_frames_filepath = value;
+            } else if (arg == "--output" && (value = next())) {
+                args.output_filepath = value;
+            } else if (arg == "--max-frames" && (value = next())) {
+                args.max_frames = std::stoul(value);
+            } else if (arg == "--drop") {
+                args.drop = true;
+            } else if (arg == "--verbose") {
+                args.verbose = true;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Replaces the display sink with a fakesink and the filesrc location with input_filepath.
+    std::string headless_stem_bin_description(std::string description, const std::string &input_filepath) {
+        description = std::regex_replace(description, std::regex(R"(qwidget5videosink[^!]*)"),
+                                         "fakesink name=display_sink sync=false ");
+        if (!input_filepath.empty())
+            description = std::regex_replace(description, std::regex(R"(filesrc\s+location=\S+)"),
+                                             "filesrc location=\"" + input_filepath + "\"");
+        return description;
+    }
+
+    std::string json_escape(const std::string &str) {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (auto c: str) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    double cpu_seconds(const struct rusage &usage) {
+        return (double) usage.ru_utime.tv_sec + (double) usage.ru_utime.tv_usec / 1e6 +
+               (double) usage.ru_stime.tv_sec + (double) usage.ru_stime.tv_usec / 1e6;
+    }
+
+    std::string latency_json(const LatencyTracer &tracer) {
+        std::string json = "{";
+        for (int s = 0; s < LatencyTracer::NUM_STAGES; s++) {
+            const auto &histogram = tracer.histogram(static_cast<LatencyTracer::Stage>(s));
+            if (!histogram.count())
+                continue;
+            auto ms = [](GstClockTime t) { return (double) t / GST_MSECOND; };
+            json += fmt::format(R"({}"{}": {{"p50": {:.3f}, "p95": {:.3f}, "p99": {:.3f}, "max": {:.3f}, "count": {}}})",
+                                json.size() > 1 ? ", " : "", LatencyTracer::STAGE_NAMES[s],
+                                ms(histogram.quantile(0.5)), ms(histogram.quantile(0.95)),
+                                ms(histogram.quantile(0.99)), ms(histogram.max()), histogram.count());
+        }
+        return json + "}";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BenchArgs args;
+    if (!parse_args(argc, argv, args)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    auto configs = AppConfig::load(args.config_filepath);
+    AppThreadPool::configure(configs["app"]["threading"]);
+    auto tracer = std::make_shared<LatencyTracer>();
+    LatencyTracer::configure(tracer);
+
+    gst_init(&argc, &argv);
+    QCoreApplication app(argc, argv);
+
+    auto stem_bin_config = configs["app"]["gst"]["pipeline"]["stem_bin"];
+    stem_bin_config["description"] = headless_stem_bin_description(
+            stem_bin_config["description"].as<std::string>(), args.input_filepath);
+    auto replay_config = configs["app"]["gst"]["pipeline"]["replay"];
+    if (!args.replay_path.empty()) {
+        replay_config["source"] = args.replay_path;
+        replay_config["rate"] = args.replay_rate;
+        replay_config["loop"] = false;
+    }
+    if (!replay_config["source"].as<std::string>("").empty())
+        replay_config["description"] = headless_stem_bin_description(
+                replay_config["description"].as<std::string>(), "");
+    auto yolo_infer_config = configs["app"]["dnn"]["yolo_infer"];
+    yolo_infer_config["verbose"] = args.verbose;
+
+    /* Pipeline */
+    GstPipelineManager pipeline;
+    pipeline.add_inference_bin("yolo_infer");
+    auto *app_sink = pipeline.get_element("yolo_infer_sink");
+    if (!app_sink) {
+        std::cerr << "yolo_infer_sink not found in inference_bin description\n";
+        return 1;
+    }
+    // as fast as possible, and every frame unless dropping is requested
+    g_object_set(app_sink, "sync", FALSE, NULL);
+    if (!args.drop)
+        g_object_set(app_sink, "drop", FALSE, "max-buffers", 4, NULL);
+
+    std::atomic_ulong num_decoded_frames{0};
+    if (auto *display_sink = pipeline.get_element("display_sink")) {
+        auto *display_probe = new GstBufferProbe();
+        display_probe->set_callback_func([&num_decoded_frames](GstPad *, GstPadProbeInfo *, gpointer) {
+            num_decoded_frames.fetch_add(1, std::memory_order_relaxed);
+            return GST_PAD_PROBE_OK;
+        });
+        display_probe->add_on(display_sink, "sink");
+    }
+
+    std::unique_ptr<FrameReplayWriter> frame_writer;
+    if (!args.record_frames_filepath.empty()) {
+        frame_writer = std::make_unique<FrameReplayWriter>(args.record_frames_filepath);
+        auto *converter = pipeline.get_element("converter");
+        if (!frame_writer->is_open() || !converter) {
+            std::cerr << "failed to record frames at converter to " << args.record_frames_filepath << "\n";
+            return 1;
+        }
+        auto *record_probe = new GstBufferProbe();
+        record_probe->set_callback_func([writer = frame_writer.get()](GstPad *pad, GstPadProbeInfo *info, gpointer) {
+            auto *caps = gst_pad_get_current_caps(pad);
+            writer->write(GST_PAD_PROBE_INFO_BUFFER(info), caps);
+            if (caps)
+                gst_caps_unref(caps);
+            return GST_PAD_PROBE_OK;
+        });
+        record_probe->add_on(converter, "src");
+        gst_object_unref(converter);
+    }
+
+    /* Worker */
+    GstInferenceQThread yolo_infer_thread;
+    auto fallback_device = torch::cuda::is_available() ? at::kCUDA : at::kCPU;
+    auto yolo_infer_worker = init_yolo_inference_worker(&yolo_infer_thread, yolo_infer_config, fallback_device);
+    yolo_infer_worker->set_app_sink(app_sink);
+    // the sample ring overwrites its oldest sample when full, which is dropping too
+    if (!args.drop)
+        yolo_infer_worker->set_sample_ring_size(0);
+
+    std::mutex results_mutex;
+    unsigned long num_inferred_frames = 0, num_detections = 0;
+    std::chrono::steady_clock::time_point first_result_time, last_result_time;
+    QObject::connect(
+            yolo_infer_worker.data(),
+            &YoloInferenceWorker::new_sample_and_result,
+            yolo_infer_worker.data(),
+            [&](unsigned long, const GstInferenceSample &, const std::vector<Detection> &dets) {
+                std::lock_guard<std::mutex> lock(results_mutex);
+                last_result_time = std::chrono::steady_clock::now();
+                if (!num_inferred_frames++)
+                    first_result_time = last_result_time;
+                num_detections += dets.size();
+            }, Qt::DirectConnection);
+    // the appsink reaches eos before the worker has drained the samples it already holds
+    std::atomic_bool worker_eos{false};
+    QObject::connect(yolo_infer_worker.data(), &GstInferenceWorker::eos, yolo_infer_worker.data(),
+                     [&worker_eos]() { worker_eos.store(true); }, Qt::DirectConnection);
+
+    struct rusage start_usage{};
+    getrusage(RUSAGE_SELF, &start_usage);
+    auto start_time = std::chrono::steady_clock::now();
+    yolo_infer_thread.start(yolo_infer_config["priority"].as<QThread::Priority>(QThread::NormalPriority));
+    if (!pipeline.set_state(GST_STATE_PLAYING)) {
+        std::cerr << "failed to start the pipeline\n";
+        return 1;
+    }
+
+    /* Run until the worker has consumed the whole stream */
+    int exit_code = 0;
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline.pipeline()));
+    QTimer poll_timer;
+    QObject::connect(&poll_timer, &QTimer::timeout, [&]() {
+        while (GstMessage *message = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR)) {
+            GError *error = NULL;
+            gst_message_parse_error(message, &error, NULL);
+            std::cerr << "pipeline error: " << (error ? error->message : "unknown") << "\n";
+            g_clear_error(&error);
+            gst_message_unref(message);
+            exit_code = 1;
+            QCoreApplication::quit();
+            return;
+        }
+        bool max_frames_reached;
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            max_frames_reached = args.max_frames && num_inferred_frames >= args.max_frames;
+        }
+        if (max_frames_reached || worker_eos.load())
+            QCoreApplication::quit();
+    });
+    poll_timer.start(10);
+    QCoreApplication::exec();
+    gst_object_unref(bus);
+
+    // let the last forward() finish
+    yolo_infer_thread.stop();
+    yolo_infer_thread.quit();
+    yolo_infer_thread.wait();
+    auto end_time = std::chrono::steady_clock::now();
+    struct rusage end_usage{};
+    getrusage(RUSAGE_SELF, &end_usage);
+    pipeline.set_state(GST_STATE_NULL);
+    if (frame_writer)
+        frame_writer->close();
+
+    /* Report */
+    auto wall_seconds = std::chrono::duration<double>(end_time - start_time).count();
+    auto steady_seconds = std::chrono::duration<double>(last_result_time - first_result_time).count();
+    auto report = fmt::format(
+            R"({{"input": "{}", "replay_rate": {}, "device": "{}", "dtype": "{}", "drop": {}, )"
+            R"("frames_decoded": {}, "frames_inferred": {}, "detections": {}, )"
+            R"("wall_seconds": {:.3f}, "fps": {:.2f}, "steady_fps": {:.2f}, "decode_fps": {:.2f}, )"
+            R"("latency_ms": {}, "cpu_percent": {:.1f}, "peak_rss_mb": {:.1f}}})",
+            json_escape(pipeline.replay_source() ? replay_config["source"].as<std::string>()
+                                                 : args.input_filepath.empty() ? "(config)" : args.input_filepath),
+            pipeline.replay_source() ? fmt::format("{}", pipeline.replay_source()->options().rate()) : "null",
+            YAML::convert<at::Device>::encode(
+                    yolo_infer_config["device"].as<at::Device>(fallback_device)).Scalar(),
+            YAML::convert<at::ScalarType>::encode(
+                    yolo_infer_config["dtype"].as<at::ScalarType>(at::kFloat)).Scalar(),
+            args.drop ? "true" : "false",
+            num_decoded_frames.load(), num_inferred_frames, num_detections,
+            wall_seconds,
+            wall_seconds > 0 ? (double) num_inferred_frames / wall_seconds : 0.,
+            steady_seconds > 0 ? (double) (num_inferred_frames - 1) / steady_seconds : 0.,
+            wall_seconds > 0 ? (double) num_decoded_frames.load() / wall_seconds : 0.,
+            latency_json(*tracer),
+            wall_seconds > 0 ? 100. * (cpu_seconds(end_usage) - cpu_seconds(start_usage)) / wall_seconds : 0.,
+            (double) end_usage.ru_maxrss / 1024.);
+    if (args.output_filepath.empty()) {
+        std::cout << report << std::endl;
+    } else if (auto *f = std::fopen(args.output_filepath.c_str(), "w")) {
+        std::fputs(report.c_str(), f);
+        std::fputc('\n', f);
+        std::fclose(f);
+    } else {
+        std::cerr << "failed to write " << args.output_filepath << "\n";
+        exit_code = 1;
+    }
+    return exit_code;
+}
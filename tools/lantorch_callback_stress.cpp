@@ -0,0 +1,387 @@
+/**
+ * Stress check of the per-instance GStreamer callbacks.
+ * Builds --instances independent appsrc ! queue ! bin(identity) ! appsink pipelines at once,
+ * each with its own GstInferenceWorker pushing into an appsrc ! fakesink pipeline,
+ * buffer probes and a dynamic GstPadLinker, and feeds them concurrently from several threads.
+ * Every frame carries the index of its pipeline, and every callback checks that it only
+ * sees frames, pads and user_data of the instance it was registered for.
+ * Self destruct objects bound to shared elements are also released concurrently and
+ * must each be destroyed exactly once.
+ * Prints a summary and exits with 1 if any callback was routed to another instance.
+ *
+ *  lantorch_callback_stress [--instances N] [--frames N] [--timeout seconds]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <gst/gst.h>
+#include <gst/app/app.h>
+
+#include <QCoreApplication>
+
+#include "gst/gst_buffer_probe.h"
+#include "gst/gst_element_pad_link.h"
+#include "gst/gst_inference_qthread.h"
+#include "gst/gst_probe_utils.h"
+#include "gst/gst_self_destruct_object.h"
+
+namespace {
+    constexpr gint kFrameSize = 16;
+
+    struct StressArgs {
+        int instances = 48;
+        int frames = 64;
+        int timeout = 60;
+    };
+
+    void print_usage(const char *prog) {
+        std::cerr << "usage: " << prog << " [--instances N] [--frames N] [--timeout seconds]\n";
+    }
+
+    bool parse_args(int argc, char *argv[], StressArgs &args) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char * { return i + 1 < argc ? argv[++i] : nullptr; };
+            const char *value = nullptr;
+            if (arg == "--instances" && (value = next())) {
+                args.instances = std::stoi(value);
+            } else if (arg == "--frames" && (value = next())) {
+                args.frames = std::stoi(value);
+            } else if (arg == "--timeout" && (value = next())) {
+                args.timeout = std::stoi(value);
+            } else {
+                return false;
+            }
+        }
+        return args.instances > 0 && args.instances <= 0xffff && args.frames > 0;
+    }
+
+    /// What the callbacks of one instance observed.
+    struct InstanceStats {
+        std::atomic_int forwarded{0};
+        std::atomic_int probed{0};
+        std::atomic_int sink_probed{0};
+        std::atomic_int output_probed{0};
+        std::atomic_int linked{0};
+        std::atomic_int eos{0};
+        std::atomic_int probes_destroyed{0};
+        std::atomic_int self_destructed{0};
+        // callbacks that received a frame, pad or user_data of another instance
+        std::atomic_int misrouted{0};
+    };
+
+    /// The instance index is written in the first two bytes of every frame.
+    GstBuffer *stamped_frame(int id, int frame) {
+        auto *buffer = gst_buffer_new_allocate(NULL, kFrameSize * kFrameSize, NULL);
+        GstMapInfo map;
+        gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+        std::fill_n(map.data, map.size, 0);
+        map.data[0] = id & 0xff;
+        map.data[1] = (id >> 8) & 0xff;
+        gst_buffer_unmap(buffer, &map);
+        GST_BUFFER_PTS(buffer) = frame * GST_SECOND / 30;
+        GST_BUFFER_DURATION(buffer) = GST_SECOND / 30;
+        return buffer;
+    }
+
+    int frame_id_of(const guint8 *data, gsize size) {
+        return size >= 2 ? data[0] | (data[1] << 8) : -1;
+    }
+
+    int frame_id_of(GstPadProbeInfo *info) {
+        GstMapInfo map;
+        auto *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        if (!buffer || !gst_buffer_map(buffer, &map, GST_MAP_READ))
+            return -1;
+        auto id = frame_id_of(map.data, map.size);
+        gst_buffer_unmap(buffer, &map);
+        return id;
+    }
+}
+
+// moc does not support classes of anonymous namespaces
+class StressWorker : public GstInferenceWorker {
+Q_OBJECT
+    int id_;
+    InstanceStats &stats_;
+
+public:
+    StressWorker(GstElement *app_sink, GstElement *app_src, int id, InstanceStats &stats)
+            : GstInferenceWorker(app_sink, app_src, GST_VIDEO_FORMAT_GRAY8), id_(id), stats_(stats) {}
+
+protected:
+    std::optional<GstInferenceSample> forward(const GstInferenceSample &sample) override {
+        stats_.forwarded++;
+        if (frame_id_of(sample.data(), sample.data_size()) != id_)
+            stats_.misrouted++;
+        return sample;
+    }
+};
+
+namespace {
+    class CheckedProbe : public GstBufferProbe {
+        InstanceStats &stats_;
+
+    public:
+        CheckedProbe(int id, InstanceStats &stats) : stats_(stats) {
+            set_callback_func([this, id](GstPad *, GstPadProbeInfo *info, gpointer) {
+                stats_.probed++;
+                if (frame_id_of(info) != id)
+                    stats_.misrouted++;
+                return GST_PAD_PROBE_OK;
+            });
+        }
+
+        ~CheckedProbe() override {
+            stats_.probes_destroyed++;
+        }
+    };
+
+    class CheckedSelfDestructObject : public GstSelfDestructObject {
+        InstanceStats &stats_;
+
+    public:
+        explicit CheckedSelfDestructObject(InstanceStats &stats) : stats_(stats) {}
+
+        ~CheckedSelfDestructObject() override {
+            stats_.self_destructed++;
+        }
+    };
+
+    struct Instance {
+        GstElement *pipeline = nullptr;
+        GstElement *app_src = nullptr;
+        GstElement *queue = nullptr;
+        GstElement *stage = nullptr;
+        GstElement *identity = nullptr;
+        GstElement *app_sink = nullptr;
+        GstElement *output_pipeline = nullptr;
+        GstElement *output_src = nullptr;
+        std::unique_ptr<GstInferenceQThread> thread;
+        QSharedPointer<StressWorker> worker;
+    };
+
+    /// appsrc ! queue ! stage ! appsink, where stage is a bin whose src pad is only added later,
+    /// and appsrc ! fakesink for the worker output.
+    void build_instance(Instance &instance, int id, InstanceStats &stats) {
+        auto *caps = gst_caps_new_simple("video/x-raw",
+                                         "format", G_TYPE_STRING, "GRAY8",
+                                         "width", G_TYPE_INT, kFrameSize,
+                                         "height", G_TYPE_INT, kFrameSize,
+                                         "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+        instance.pipeline = gst_pipeline_new(fmt::format("stress_{}", id).c_str());
+        instance.app_src = gst_element_factory_make("appsrc", NULL);
+        g_object_set(instance.app_src, "caps", caps, "format", GST_FORMAT_TIME, NULL);
+        instance.queue = gst_element_factory_make("queue", NULL);
+        instance.stage = gst_bin_new(NULL);
+        instance.identity = gst_element_factory_make("identity", NULL);
+        gst_bin_add(GST_BIN(instance.stage), instance.identity);
+        auto *identity_sink = gst_element_get_static_pad(instance.identity, "sink");
+        gst_element_add_pad(instance.stage, gst_ghost_pad_new("sink", identity_sink));
+        gst_object_unref(identity_sink);
+        instance.app_sink = gst_element_factory_make("appsink", NULL);
+        g_object_set(instance.app_sink, "sync", FALSE, "drop", FALSE, "max-buffers", 4, NULL);
+        gst_bin_add_many(GST_BIN(instance.pipeline),
+                         instance.app_src, instance.queue, instance.stage, instance.app_sink, NULL);
+        gst_element_link_many(instance.app_src, instance.queue, instance.stage, NULL);
+
+        instance.output_pipeline = gst_pipeline_new(fmt::format("stress_output_{}", id).c_str());
+        instance.output_src = gst_element_factory_make("appsrc", NULL);
+        g_object_set(instance.output_src, "caps", caps, "format", GST_FORMAT_TIME, NULL);
+        auto *output_sink = gst_element_factory_make("fakesink", NULL);
+        g_object_set(output_sink, "sync", FALSE, NULL);
+        gst_bin_add_many(GST_BIN(instance.output_pipeline), instance.output_src, output_sink, NULL);
+        gst_element_link(instance.output_src, output_sink);
+        gst_caps_unref(caps);
+
+        // self destruct probe, and probes owning a copy of their callback
+        (new CheckedProbe(id, stats))->add_on(instance.queue, "src");
+        gst_element_pad_add_probe(
+                instance.app_sink, "sink", GST_PAD_PROBE_TYPE_BUFFER,
+                [id](GstPad *, GstPadProbeInfo *info, gpointer user_data) {
+                    auto &stats = *static_cast<InstanceStats *>(user_data);
+                    stats.sink_probed++;
+                    if (frame_id_of(info) != id)
+                        stats.misrouted++;
+                    return GST_PAD_PROBE_OK;
+                }, &stats);
+        gst_element_pad_add_probe(
+                output_sink, "sink", GST_PAD_PROBE_TYPE_BUFFER,
+                [id, &stats](GstPad *, GstPadProbeInfo *info, gpointer) {
+                    stats.output_probed++;
+                    if (frame_id_of(info) != id)
+                        stats.misrouted++;
+                    return GST_PAD_PROBE_OK;
+                });
+
+        // the src pad of stage does not exist yet, the linker waits for its "pad-added"
+        gst_element_pad_link(
+                instance.stage, "src", GST_PAD_TYPE_DYNAMIC,
+                [stage = instance.stage, &stats](GstPad *pad) -> gboolean {
+                    if (GST_OBJECT_PARENT(pad) != GST_OBJECT(stage))
+                        stats.misrouted++;
+                    return GST_PAD_IS_SRC(pad);
+                },
+                instance.app_sink, "sink", GST_PAD_TYPE_STATIC,
+                [](GstPad *) -> gboolean { return TRUE; });
+    }
+
+    /// Pairs of shared elements, each pair bound to one object per instance, released from several threads.
+    bool check_self_destruct(int n, std::vector<InstanceStats> &stats, unsigned int n_threads) {
+        std::vector<std::pair<GstElement *, GstElement *>> bound(n);
+        for (int i = 0; i < n; i++) {
+            bound[i] = {gst_element_factory_make("identity", NULL), gst_element_factory_make("identity", NULL)};
+            gst_object_ref_sink(bound[i].first);
+            gst_object_ref_sink(bound[i].second);
+            auto *object = new CheckedSelfDestructObject(stats[i]);
+            object->bind_lifecycle_many(bound[i].first, bound[i].second, NULL);
+        }
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < n_threads; t++) {
+            threads.emplace_back([&, t]() {
+                for (int i = (int) t; i < n; i += (int) n_threads) {
+                    gst_object_unref(bound[i].first);
+                    gst_object_unref(bound[i].second);
+                }
+            });
+        }
+        for (auto &thread: threads)
+            thread.join();
+        return std::all_of(stats.begin(), stats.end(), [](const InstanceStats &s) {
+            return s.self_destructed == 1;
+        });
+    }
+}
+
+int main(int argc, char *argv[]) {
+    StressArgs args;
+    if (!parse_args(argc, argv, args)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    gst_init(&argc, &argv);
+    QCoreApplication app(argc, argv);
+
+    auto n = args.instances;
+    auto n_threads = std::max(2u, std::thread::hardware_concurrency() / 2);
+    std::vector<InstanceStats> stats(n);
+    std::vector<Instance> instances(n);
+    for (int i = 0; i < n; i++)
+        build_instance(instances[i], i, stats[i]);
+
+    // every linker is registered before any pad appears, pads are added concurrently in random order
+    {
+        std::vector<int> order(n);
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), std::mt19937(std::random_device()()));
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < n_threads; t++) {
+            threads.emplace_back([&, t]() {
+                for (auto k = t; k < order.size(); k += n_threads) {
+                    auto &instance = instances[order[k]];
+                    auto *identity_src = gst_element_get_static_pad(instance.identity, "src");
+                    gst_element_add_pad(instance.stage, gst_ghost_pad_new("src", identity_src));
+                    gst_object_unref(identity_src);
+                }
+            });
+        }
+        for (auto &thread: threads)
+            thread.join();
+    }
+    for (int i = 0; i < n; i++) {
+        auto *sink_pad = gst_element_get_static_pad(instances[i].app_sink, "sink");
+        if (auto *peer = gst_pad_get_peer(sink_pad)) {
+            if (GST_OBJECT_PARENT(peer) == GST_OBJECT(instances[i].stage))
+                stats[i].linked++;
+            else
+                stats[i].misrouted++;
+            gst_object_unref(peer);
+        }
+        gst_object_unref(sink_pad);
+    }
+
+    for (int i = 0; i < n; i++) {
+        auto &instance = instances[i];
+        instance.thread = std::make_unique<GstInferenceQThread>();
+        instance.worker = instance.thread->init_worker<StressWorker>(
+                instance.app_sink, instance.output_src, i, stats[i]);
+        QObject::connect(instance.worker.data(), &GstInferenceWorker::eos, instance.worker.data(),
+                         [&stats, i]() { stats[i].eos++; }, Qt::DirectConnection);
+        gst_element_set_state(instance.output_pipeline, GST_STATE_PLAYING);
+        gst_element_set_state(instance.pipeline, GST_STATE_PLAYING);
+        instance.thread->start();
+    }
+
+    // frames of all instances interleaved from several threads
+    auto start_time = std::chrono::steady_clock::now();
+    {
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < n_threads; t++) {
+            threads.emplace_back([&, t]() {
+                for (int frame = 0; frame < args.frames; frame++)
+                    for (auto i = (int) t; i < n; i += (int) n_threads)
+                        gst_app_src_push_buffer(GST_APP_SRC(instances[i].app_src), stamped_frame(i, frame));
+                for (auto i = (int) t; i < n; i += (int) n_threads)
+                    gst_app_src_end_of_stream(GST_APP_SRC(instances[i].app_src));
+            });
+        }
+        for (auto &thread: threads)
+            thread.join();
+    }
+
+    auto deadline = start_time + std::chrono::seconds(args.timeout);
+    auto all_eos = [&]() {
+        return std::all_of(stats.begin(), stats.end(), [](const InstanceStats &s) { return s.eos > 0; });
+    };
+    while (!all_eos() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    for (auto &instance: instances) {
+        instance.thread->stop();
+        instance.thread->quit();
+        instance.thread->wait();
+        instance.worker.reset();
+        instance.thread.reset();
+    }
+    for (auto &instance: instances) {
+        gst_element_set_state(instance.pipeline, GST_STATE_NULL);
+        gst_element_set_state(instance.output_pipeline, GST_STATE_NULL);
+        gst_object_unref(instance.pipeline);
+        gst_object_unref(instance.output_pipeline);
+    }
+
+    bool ok = true;
+    for (int i = 0; i < n; i++) {
+        const auto &s = stats[i];
+        bool instance_ok = s.misrouted == 0 && s.linked == 1 && s.eos == 1 && s.probes_destroyed == 1 &&
+                           s.forwarded == args.frames && s.probed == args.frames &&
+                           s.sink_probed == args.frames && s.output_probed == args.frames;
+        if (!instance_ok)
+            std::cerr << fmt::format(
+                    "instance {}: misrouted={} linked={} eos={} forwarded={} probed={} sink_probed={}"
+                    " output_probed={} probes_destroyed={} (expected {} frames)\n",
+                    i, s.misrouted.load(), s.linked.load(), s.eos.load(), s.forwarded.load(), s.probed.load(),
+                    s.sink_probed.load(), s.output_probed.load(), s.probes_destroyed.load(), args.frames);
+        ok &= instance_ok;
+    }
+    if (!check_self_destruct(n, stats, n_threads)) {
+        std::cerr << "self destruct objects were not destroyed exactly once each\n";
+        ok = false;
+    }
+    std::cout << fmt::format("{} instances x {} frames on {} threads in {:.2f}s: {}\n",
+                             n, args.frames, n_threads, elapsed, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+#include "lantorch_callback_stress.moc"